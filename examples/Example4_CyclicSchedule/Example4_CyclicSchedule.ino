@@ -0,0 +1,50 @@
+/* This example shows how to drive two servos from a fixed cyclic schedule. The
+schedule is checked at compile time; if the slots didn't fit in the frame, the
+sketch would fail to compile. */
+
+#include <HitecDServo.h>
+#include <HitecDSchedule.h>
+
+HitecDServo servos[2];
+int16_t targetQuarterMicros[2] = {4*1500, 4*1500};
+int16_t currentAPV[2];
+
+/* Every 25ms: write both targets, then read back the second servo's position.
+A read takes much longer than a write, so it goes last. */
+constexpr HitecDSlot schedule[] = {
+  {0, HITECD_SLOT_WRITE_TARGET, 0},
+  {1, HITECD_SLOT_WRITE_TARGET, 2000},
+  {1, HITECD_SLOT_READ_APV, 4000},
+};
+HITECD_CYCLIC_EXECUTIVE(executive, servos, schedule, 25000,
+  targetQuarterMicros, currentAPV);
+
+void setup() {
+  int result;
+
+  Serial.begin(115200);
+
+  result = servos[0].attach(2);
+  if (result != HITECD_OK) { printError(result); }
+  result = servos[1].attach(3);
+  if (result != HITECD_OK) { printError(result); }
+
+  executive.start();
+}
+
+void loop() {
+  /* Sweep both servos back and forth, in opposite directions */
+  int16_t phase = (millis() / 10) % 400;
+  int16_t offset = (phase < 200) ? phase : (400 - phase);
+  targetQuarterMicros[0] = 4 * (1300 + 2 * offset);
+  targetQuarterMicros[1] = 4 * (1700 - 2 * offset);
+
+  int result = executive.poll();
+  if (result != HITECD_OK) { printError(result); }
+}
+
+void printError(int result) {
+  Serial.print("Error: ");
+  Serial.println(hitecdErrToString(result));
+  while (1) { }
+}
@@ -0,0 +1,235 @@
+#include "FailSafeTest.h"
+
+#include "CommandLine.h"
+#include "ModelSpecs.h"
+#include "Programmer.h"
+#include "Session.h"
+
+#define FAILSAFE_TEST_TRIALS 5
+#define FAILSAFE_TEST_CONFIGS 3
+
+/* Each trial starts at START_MICROS and is commanded to END_MICROS. In the
+move-to-position configuration, the fail-safe position is START_MICROS, so the
+servo visibly turns back when the fail-safe engages. */
+#define FAILSAFE_TEST_START_MICROS 1100
+#define FAILSAFE_TEST_END_MICROS 1900
+
+/* Slow moves give the fail-safe time to engage before the move finishes. */
+#define FAILSAFE_TEST_SPEED 10
+
+#define FAILSAFE_TEST_TIMEOUT_MILLIS 5000
+
+/* How far the servo must be from where it was commanded to go before we
+consider the fail-safe to have engaged. Larger than the servo's deadband and
+the noise in the APV readings. */
+#define FAILSAFE_TEST_APV_MARGIN 200
+
+#define FAILSAFE_NOT_ENGAGED 0xFFFF
+
+int16_t failSafeTestEndAPV;
+
+void printFailSafeTestConfig(int config) {
+  if (config == 0) {
+    Serial.print(F("Fail-safe off (hold last position)"));
+  } else if (config == 1) {
+    Serial.print(F("Fail-safe limp"));
+  } else {
+    Serial.print(F("Fail-safe move to "));
+    Serial.print(FAILSAFE_TEST_START_MICROS);
+    Serial.print(F("us"));
+  }
+}
+
+/* Keeps sending the target every 20ms, the way a PWM signal would, until the
+servo stops moving. Returns the APV where it stopped. */
+int16_t holdFailSafeTestTarget(int16_t targetMicros) {
+  int16_t prevAPV = -1;
+  uint32_t startMillis = millis();
+  uint32_t lastReadMillis = startMillis;
+  while (millis() - startMillis < 10000) {
+    servo->writeTargetMicroseconds(targetMicros);
+    delay(20);
+    if (millis() - lastReadMillis < 200) {
+      continue;
+    }
+    lastReadMillis = millis();
+    int16_t apv = servo->readCurrentAPV();
+    if (apv < 0) {
+      printErr(apv, true);
+    }
+    if (prevAPV >= 0 && abs(apv - prevAPV) < 10) {
+      return apv;
+    }
+    prevAPV = apv;
+  }
+  Serial.println(F("Warning: Servo did not finish moving within 10s."));
+  return prevAPV;
+}
+
+/* Runs one trial. Returns the time from the last command to the first sample
+that showed the fail-safe engaging, or FAILSAFE_NOT_ENGAGED. The time of the
+sample before that is stored in *earliestMillisOut. */
+uint16_t runFailSafeTrial(bool limp, uint16_t *earliestMillisOut) {
+  holdFailSafeTestTarget(FAILSAFE_TEST_START_MICROS);
+
+  servo->writeTargetMicroseconds(FAILSAFE_TEST_END_MICROS);
+  uint32_t lastCommandMillis = millis();
+
+  int16_t closestDistance = 0x7FFF;
+  bool wasPowered = false;
+  int unpoweredSamples = 0;
+  uint16_t prevSampleMillis = 0;
+  while (true) {
+    int16_t apv = servo->readCurrentAPV();
+    if (apv < 0) {
+      printErr(apv, true);
+    }
+    int16_t power;
+    int res;
+    if ((res = servo->readMotorPower(&power)) != HITECD_OK) {
+      printErr(res, true);
+    }
+    uint16_t sampleMillis = millis() - lastCommandMillis;
+
+    int16_t distance = abs(apv - failSafeTestEndAPV);
+    bool engaged;
+    if (limp) {
+      /* Stopped pushing before it got there. */
+      if (power != 0) {
+        wasPowered = true;
+        unpoweredSamples = 0;
+      } else {
+        ++unpoweredSamples;
+      }
+      engaged = wasPowered && unpoweredSamples >= 2 &&
+        distance > FAILSAFE_TEST_APV_MARGIN;
+    } else {
+      /* Turned back from where it was going. */
+      closestDistance = min(closestDistance, distance);
+      engaged = distance > closestDistance + FAILSAFE_TEST_APV_MARGIN;
+    }
+
+    if (engaged) {
+      *earliestMillisOut = prevSampleMillis;
+      return sampleMillis;
+    }
+    if (sampleMillis > FAILSAFE_TEST_TIMEOUT_MILLIS) {
+      return FAILSAFE_NOT_ENGAGED;
+    }
+    prevSampleMillis = sampleMillis;
+  }
+}
+
+void printFailSafeTestSummary(uint16_t *latencies, int numEngaged) {
+  Serial.print(F("  Engaged in "));
+  Serial.print(numEngaged);
+  Serial.print(F(" of "));
+  Serial.print(FAILSAFE_TEST_TRIALS);
+  Serial.print(F(" trials"));
+  if (numEngaged == 0) {
+    Serial.println(F("."));
+    return;
+  }
+
+  /* Insertion sort; there are only a few trials. */
+  for (int i = 1; i < numEngaged; ++i) {
+    uint16_t x = latencies[i];
+    int j = i;
+    for (; j > 0 && latencies[j - 1] > x; --j) {
+      latencies[j] = latencies[j - 1];
+    }
+    latencies[j] = x;
+  }
+  Serial.print(F("; latency min="));
+  Serial.print(latencies[0]);
+  Serial.print(F("ms, median="));
+  Serial.print(latencies[numEngaged / 2]);
+  Serial.print(F("ms, max="));
+  Serial.print(latencies[numEngaged - 1]);
+  Serial.println(F("ms."));
+}
+
+void runFailSafeTest() {
+  if (groupMode) {
+    Serial.println(F(
+      "Error: The fail-safe test runs on one servo. Use \"select\" to pick "
+      "one."));
+    goto cancel;
+  }
+
+  Serial.print(F(
+    "The fail-safe test will temporarily change the servo settings, and move\r\n"
+    "the servo back and forth between "));
+  Serial.print(FAILSAFE_TEST_START_MICROS);
+  Serial.print(F("us and "));
+  Serial.print(FAILSAFE_TEST_END_MICROS);
+  Serial.println(F(
+    "us for several minutes.\r\n"
+    "Make sure it can move freely. Continue? Enter \"y\" or \"n\":"));
+  if (!scanYesNo()) {
+    goto cancel;
+  }
+  if (!checkSupportedModel()) {
+    goto cancel;
+  }
+
+  /* Nested block prevents compiler warnings about "goto cancel" crossing
+  initialization of variables */
+  {
+    HitecDSettings savedSettings = settings;
+    bool anyEngaged = false;
+
+    for (int config = 0; config < FAILSAFE_TEST_CONFIGS; ++config) {
+      settings = savedSettings;
+      settings.speed = FAILSAFE_TEST_SPEED;
+      settings.failSafe = (config == 2) ? FAILSAFE_TEST_START_MICROS : 0;
+      settings.failSafeLimp = (config == 1);
+      saveSettings();
+
+      if (config == 0) {
+        failSafeTestEndAPV = holdFailSafeTestTarget(FAILSAFE_TEST_END_MICROS);
+      }
+
+      printFailSafeTestConfig(config);
+      Serial.println(F(":"));
+      uint16_t latencies[FAILSAFE_TEST_TRIALS];
+      int numEngaged = 0;
+      for (int trial = 0; trial < FAILSAFE_TEST_TRIALS; ++trial) {
+        uint16_t earliestMillis;
+        uint16_t latency = runFailSafeTrial(config == 1, &earliestMillis);
+        Serial.print(F("  Trial "));
+        Serial.print(trial + 1);
+        if (latency == FAILSAFE_NOT_ENGAGED) {
+          Serial.print(F(": did not engage within "));
+          Serial.print(FAILSAFE_TEST_TIMEOUT_MILLIS);
+          Serial.println(F("ms"));
+        } else {
+          Serial.print(F(": engaged "));
+          Serial.print(earliestMillis);
+          Serial.print('-');
+          Serial.print(latency);
+          Serial.println(F("ms after the last command"));
+          latencies[numEngaged++] = latency;
+        }
+      }
+      printFailSafeTestSummary(latencies, numEngaged);
+      if (config != 0 && numEngaged != 0) {
+        anyEngaged = true;
+      }
+    }
+
+    if (!anyEngaged) {
+      Serial.println(F(
+        "Note: The fail-safe never engaged. The servo may treat the test's own\r\n"
+        "register reads as a signal."));
+    }
+
+    Serial.println(F("Restoring the original settings..."));
+    settings = savedSettings;
+    saveSettings();
+  }
+  return;
+
+cancel:
+  Serial.println(F("Fail-safe test will not be run."));
+}
@@ -0,0 +1,19 @@
+#ifndef FailSafeTest_h
+#define FailSafeTest_h
+
+#include <Arduino.h>
+
+/* The "failtest" command measures how long the servo takes to engage its
+fail-safe after it stops receiving commands. For each fail-safe setting (off,
+limp, and move-to-position), it runs several trials:
+1. Keep commanding the servo to hold one position until it settles.
+2. Command it to slowly move to a second position, then send nothing more.
+3. Sample the current APV and the motor power as fast as the bus allows, until
+   the servo visibly does something it wasn't commanded to do: goes limp part
+   way through the move, or turns back towards the fail-safe position.
+The latency is the time from the last command to the first sample showing this.
+Since each sample is a register read, the result is only accurate to about
+2*HD_READ_MICROS. The servo's settings are restored afterwards. */
+void runFailSafeTest();
+
+#endif /* FailSafeTest_h */
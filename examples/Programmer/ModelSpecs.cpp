@@ -5,60 +5,52 @@
 #include "CommandLine.h"
 #include "Programmer.h"
 #include "Move.h"
-
-void setupUnsupportedModelSpecs() {
-  Serial.println(F(
-    "====================================================================\r\n"
-    "Warning: Your servo model is not fully supported. Currently, only\r\n"
-    "the D485HW model is fully supported. To improve support for your\r\n"
-    "servo model, please open a GitHub issue at\r\n"
-    "<https://github.com/timmaxw/HitecDServo/issues/new>\r\n"
-    "Include the following following diagnostic information:"
-  ));
-
-  static uint8_t registersToDebug[] = {
-    HD_REG_MODEL_NUMBER,
-
-    /* Settings registers. I want to know if the default values are different
-    for other models. */
-    HD_REG_ID,
-    HD_REG_DIRECTION,
-    HD_REG_SPEED,
-    HD_REG_DEADBAND_1,
-    HD_REG_DEADBAND_2,
-    HD_REG_DEADBAND_3,
-    HD_REG_SOFT_START,
-    HD_REG_RANGE_LEFT_APV,
-    HD_REG_RANGE_RIGHT_APV,
-    HD_REG_RANGE_CENTER_APV,
-    HD_REG_FAIL_SAFE,
-    HD_REG_POWER_LIMIT,
-    HD_REG_OVERLOAD_PROTECTION,
-    HD_REG_SMART_SENSE_1,
-    HD_REG_SMART_SENSE_2,
-    HD_REG_SENSITIVITY_RATIO,
-
-    /* Registers that always seem to be read/written with constant values on the
-    D485HW. I want to know if they return a different value on other models. */
-    HD_REG_SS_ENABLE_1,
-    HD_REG_SS_ENABLE_2,
-    HD_REG_SS_DISABLE_1,
-    HD_REG_SS_DISABLE_2,
-    HD_REG_MYSTERY_OP1,
-    HD_REG_MYSTERY_OP2,
-    HD_REG_MYSTERY_DB,
-    0x04,
-    0x06,
-    0x50,
-    0x52,
-    0xC4
-  };
-
+#include "Session.h"
+
+static const uint8_t registersToDebug[] PROGMEM = {
+  HD_REG_MODEL_NUMBER,
+
+  /* Settings registers. I want to know if the default values are different
+  for other models. */
+  HD_REG_ID,
+  HD_REG_DIRECTION,
+  HD_REG_SPEED,
+  HD_REG_DEADBAND_1,
+  HD_REG_DEADBAND_2,
+  HD_REG_DEADBAND_3,
+  HD_REG_SOFT_START,
+  HD_REG_RANGE_LEFT_APV,
+  HD_REG_RANGE_RIGHT_APV,
+  HD_REG_RANGE_CENTER_APV,
+  HD_REG_FAIL_SAFE,
+  HD_REG_POWER_LIMIT,
+  HD_REG_OVERLOAD_PROTECTION,
+  HD_REG_SMART_SENSE_1,
+  HD_REG_SMART_SENSE_2,
+  HD_REG_SENSITIVITY_RATIO,
+
+  /* Registers that always seem to be read/written with constant values on the
+  D485HW. I want to know if they return a different value on other models. */
+  HD_REG_SS_ENABLE_1,
+  HD_REG_SS_ENABLE_2,
+  HD_REG_SS_DISABLE_1,
+  HD_REG_SS_DISABLE_2,
+  HD_REG_MYSTERY_OP1,
+  HD_REG_MYSTERY_OP2,
+  HD_REG_MYSTERY_DB,
+  0x04,
+  0x06,
+  0x50,
+  0x52,
+  0xC4
+};
+
+void printDebugRegisters() {
   for (int i = 0; i < (int)sizeof(registersToDebug); ++i) {
-    uint8_t reg = registersToDebug[i];
+    uint8_t reg = pgm_read_byte(&registersToDebug[i]);
     uint16_t temp;
     int res;
-    if ((res = servo.readRawRegister(reg, &temp)) != HITECD_OK) {
+    if ((res = servo->readRawRegister(reg, &temp)) != HITECD_OK) {
       printErr(res, true);
     }
     Serial.print((reg >> 4) & 0x0F, HEX);
@@ -74,6 +66,19 @@ void setupUnsupportedModelSpecs() {
       Serial.print(' ');
     }
   }
+}
+
+void setupUnsupportedModelSpecs() {
+  Serial.println(F(
+    "====================================================================\r\n"
+    "Warning: Your servo model is not fully supported. Currently, only\r\n"
+    "the D485HW model is fully supported. To improve support for your\r\n"
+    "servo model, please open a GitHub issue at\r\n"
+    "<https://github.com/timmaxw/HitecDServo/issues/new>\r\n"
+    "Include the following following diagnostic information:"
+  ));
+
+  printDebugRegisters();
 
   Serial.println(F(
     "Is it OK to move the servo to detect the physical range of motion?\r\n"
@@ -122,7 +127,7 @@ void setupUnsupportedModelSpecs() {
 }
 
 void setupModelSpecs() {
-  if (servo.isModelSupported()) {
+  if (servo->isModelSupported()) {
     defaultRangeLeftAPV =
       HitecDSettings::defaultRangeLeftAPV(modelNumber);
     defaultRangeRightAPV =
@@ -178,10 +183,32 @@ int16_t widestRangeCenterAPV() {
   }
 }
 
+void recordDefaultRangeAPVs() {
+  if (servo->isModelSupported()) {
+    return;
+  }
+
+  /* The servo library doesn't know the default values of rangeLeftAPV/etc.,
+  but we just reset the servo, so we know the current values must be the
+  default values. Record those values. */
+  defaultRangeLeftAPV = settings.rangeLeftAPV;
+  defaultRangeRightAPV = settings.rangeRightAPV;
+  defaultRangeCenterAPV = settings.rangeCenterAPV;
+
+  for (int i = 0; i < numSessions; ++i) {
+    if (i != currentSession && isSessionActive(i)) {
+      Session &s = sessions[i];
+      s.defaultRangeLeftAPV = s.settings.rangeLeftAPV;
+      s.defaultRangeRightAPV = s.settings.rangeRightAPV;
+      s.defaultRangeCenterAPV = s.settings.rangeCenterAPV;
+    }
+  }
+}
+
 bool allowUnsupportedModel = false;
 
 bool checkSupportedModel() {
-  if (servo.isModelSupported() || allowUnsupportedModel) {
+  if (servo->isModelSupported() || allowUnsupportedModel) {
     return true;
   }
 
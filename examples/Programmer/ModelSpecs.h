@@ -5,6 +5,10 @@
 
 void setupModelSpecs();
 
+/* Prints the raw values of registers that are useful for adding support for
+new servo models. */
+void printDebugRegisters();
+
 /* For supported models, the library knows these values. But for unsupported
 models, we can only discover them experimentally. These variables will be set
 to -1 if not known, or to a specific value if known either via the library or
@@ -23,6 +27,11 @@ int16_t widestRangeLeftAPV();
 int16_t widestRangeRightAPV();
 int16_t widestRangeCenterAPV();
 
+/* Call this right after resetting the range settings to factory defaults. For
+unsupported models, it records the current range as the default range, for the
+selected servo and any other servos in its group. */
+void recordDefaultRangeAPVs();
+
 extern bool allowUnsupportedModel;
 bool checkSupportedModel();
 
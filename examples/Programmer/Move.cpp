@@ -4,6 +4,7 @@
 
 #include "CommandLine.h"
 #include "Programmer.h"
+#include "Session.h"
 
 void askAndMoveToMicros() {
   Serial.println(F(
@@ -29,12 +30,18 @@ cancel:
 }
 
 void moveToQuarterMicros(int16_t quarterMicros) {
-  int16_t startAPV = servo.readCurrentAPV();
+  int16_t startAPV = servo->readCurrentAPV();
   if (startAPV < 0) {
     printErr(startAPV, true);
   }
 
-  servo.writeTargetQuarterMicros(quarterMicros);
+  /* In group mode, move every servo in the group, but only follow the selected
+  one. */
+  for (int i = 0; i < numSessions; ++i) {
+    if (isSessionActive(i)) {
+      sessions[i].servo.writeTargetQuarterMicros(quarterMicros);
+    }
+  }
 
   long startMs = millis();
   int16_t prevAPV = startAPV;
@@ -42,7 +49,7 @@ void moveToQuarterMicros(int16_t quarterMicros) {
     long currentMs = millis() - startMs;
     delay(nextMs - currentMs);
 
-    int16_t nextAPV = servo.readCurrentAPV();
+    int16_t nextAPV = servo->readCurrentAPV();
     if (nextAPV < 0) {
       printErr(nextAPV, true);
     }
@@ -86,40 +93,40 @@ void useGentleMovementSettings() {
     "Temporarily changing servo settings to widest range & low power..."));
 
   int res;
-  if ((res = servo.readRawRegister(
+  if ((res = servo->readRawRegister(
       HD_REG_RANGE_LEFT_APV, &savedRangeLeftAPV))!= HITECD_OK) {
     printErr(res, true);
   }
-  if ((res = servo.readRawRegister(
+  if ((res = servo->readRawRegister(
       HD_REG_RANGE_RIGHT_APV, &savedRangeRightAPV)) != HITECD_OK) {
     printErr(res, true);
   }
-  if ((res = servo.readRawRegister(
+  if ((res = servo->readRawRegister(
       HD_REG_RANGE_CENTER_APV, &savedRangeCenterAPV)) != HITECD_OK) {
     printErr(res, true);
   }
-  if ((res = servo.readRawRegister(
+  if ((res = servo->readRawRegister(
       HD_REG_SPEED, &savedSpeed)) != HITECD_OK) {
     printErr(res, true);
   }
-  if ((res = servo.readRawRegister(
+  if ((res = servo->readRawRegister(
       HD_REG_POWER_LIMIT, &savedPowerLimit)) != HITECD_OK) {
     printErr(res, true);
   }
 
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_RANGE_LEFT_APV, GENTLE_MOVEMENT_RANGE_LEFT_APV);
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_RANGE_RIGHT_APV, GENTLE_MOVEMENT_RANGE_RIGHT_APV);
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_RANGE_CENTER_APV, GENTLE_MOVEMENT_RANGE_CENTER_APV);
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_SPEED, 5);
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_POWER_LIMIT, 400);
 
-  servo.writeRawRegister(HD_REG_SAVE, HD_SAVE_CONST);
-  servo.writeRawRegister(HD_REG_REBOOT, HD_REBOOT_CONST);
+  servo->writeRawRegister(HD_REG_SAVE, HD_SAVE_CONST);
+  servo->writeRawRegister(HD_REG_REBOOT, HD_REBOOT_CONST);
   delay(1000);
 
   Serial.println(F("Done."));
@@ -133,24 +140,24 @@ void undoGentleMovementSettings() {
 
   Serial.println(F("Undoing temporary changes to servo settings..."));
 
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_RANGE_LEFT_APV, savedRangeLeftAPV);
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_RANGE_RIGHT_APV, savedRangeRightAPV);
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_RANGE_CENTER_APV, savedRangeCenterAPV);
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_SPEED, savedSpeed);
-  servo.writeRawRegister(
+  servo->writeRawRegister(
     HD_REG_POWER_LIMIT, savedPowerLimit);
 
-  servo.writeRawRegister(HD_REG_SAVE, HD_SAVE_CONST);
-  servo.writeRawRegister(HD_REG_REBOOT, HD_REBOOT_CONST);
+  servo->writeRawRegister(HD_REG_SAVE, HD_SAVE_CONST);
+  servo->writeRawRegister(HD_REG_REBOOT, HD_REBOOT_CONST);
   delay(1000);
 
   /* Read back the settings to make sure we have the latest values. */
   int res;
-  if ((res = servo.readSettings(&settings)) != HITECD_OK) {
+  if ((res = servo->readSettings(&settings)) != HITECD_OK) {
     printErr(res, true);
   }
 
@@ -168,16 +175,16 @@ void moveGentlyToAPV(int16_t targetAPV, int16_t *actualAPV) {
     GENTLE_MOVEMENT_RANGE_RIGHT_APV,
     850 * 4,
     2150 * 4);
-  servo.writeTargetQuarterMicros(targetQuarterMicros);
+  servo->writeTargetQuarterMicros(targetQuarterMicros);
 
   /* Wait until it seems to have successfully moved */
-  int16_t lastActualAPV = servo.readCurrentAPV();
+  int16_t lastActualAPV = servo->readCurrentAPV();
   if (lastActualAPV < 0) {
     printErr(lastActualAPV, true);
   }
   for (int i = 0; i < 50; ++i) {
     delay(100);
-    *actualAPV = servo.readCurrentAPV();
+    *actualAPV = servo->readCurrentAPV();
     if (*actualAPV < 0) {
       printErr(*actualAPV, true);
     }
@@ -3,7 +3,8 @@
 
 #include <HitecDServo.h>
 
-extern HitecDServo servo;
+/* These always refer to the selected servo; see Session.h. */
+extern HitecDServo *servo;
 extern int modelNumber;
 extern HitecDSettings settings;
 
@@ -3,7 +3,9 @@
 This sketch turns your Arduino into an interactive servo programmer. Upload it
 to the Arduino, then use the Arduino Serial Monitor at 152000 baud to
 interactively read/write the settings of your Hitec D-series servo that's
-attached to the Arduino.
+attached to the Arduino. Several servos can be attached at once, each on its own
+pin; use the "servos" and "select" commands to switch between them, or to change
+the settings of all of them together.
 
 (Although this sketch is in the "examples" section, it's quite complex and not
 actually a good example to learn how to use the HitecDServo library.) */
@@ -11,12 +13,16 @@ actually a good example to learn how to use the HitecDServo library.) */
 #include "Programmer.h"
 
 #include "CommandLine.h"
+#include "FailSafeTest.h"
 #include "ModelSpecs.h"
 #include "Move.h"
 #include "RangeSettings.h"
+#include "RegisterExplorer.h"
+#include "Session.h"
+#include "SetpointStream.h"
 #include "Settings.h"
 
-HitecDServo servo;
+HitecDServo *servo;
 int modelNumber;
 HitecDSettings settings;
 
@@ -38,21 +44,7 @@ void printErr(int res, bool fatal) {
   }
 }
 
-void setup() {
-  int res;
-
-  Serial.begin(115200);
-  Serial.println(F(
-    "===== Welcome to HitecDServo Programmer! =====\r\n"
-    "Note: This tool is not endorsed by Hitec, not guaranteed to work, and\r\n"
-    "could potentially even damage your servo."));
-
-  int16_t pin;
-  Serial.println(F("Enter the Arduino pin that the servo is attached to:"));
-  if (!scanNumber(&pin, PRINT_IF_EMPTY)) {
-    fatalErr();
-  }
-
+bool checkPin(int16_t pin) {
 #if defined(ARDUINO_AVR_DUEMILANOVE) || \
     defined(ARDUINO_AVR_MEGA) || \
     defined(ARDUINO_AVR_MEGA2560) || \
@@ -66,25 +58,46 @@ void setup() {
     Serial.println(F(
       "Error: Can't use pin 0 or 1 because those are needed for serial\r\n"
       "communication with the computer over USB."));
-    fatalErr();
+    return false;
   }
 #endif
+  return true;
+}
 
-  Serial.println(F("Connecting to servo..."));
-  if ((res = servo.attach(pin)) != HITECD_OK) {
-    printErr(res, true);
-  }
-  if ((modelNumber = servo.readModelNumber()) < 0) {
-    printErr(modelNumber, true);
-  }
-  if ((res = servo.readSettings(&settings)) < 0) {
-    printErr(res, true);
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F(
+    "===== Welcome to HitecDServo Programmer! =====\r\n"
+    "Note: This tool is not endorsed by Hitec, not guaranteed to work, and\r\n"
+    "could potentially even damage your servo."));
+
+  int16_t pin;
+  Serial.println(F("Enter the Arduino pin that the servo is attached to:"));
+  if (!scanNumber(&pin, PRINT_IF_EMPTY) || !checkPin(pin)) {
+    fatalErr();
   }
+  Serial.println(F("Connecting to servo..."));
+  addSession(pin);
 
-  Serial.print("Servo model: D");
-  Serial.println(modelNumber, DEC);
+  while (numSessions < MAX_SESSIONS) {
+    Serial.println(F(
+      "If another servo is attached, enter its pin (or nothing to continue):"));
+    if (!scanNumber(&pin)) {
+      if (rawInputLen == 0) {
+        break;
+      }
+      continue;
+    }
+    if (!checkPin(pin)) {
+      continue;
+    }
+    Serial.println(F("Connecting to servo..."));
+    addSession(pin);
+  }
 
-  setupModelSpecs();
+  if (numSessions > 1) {
+    printSessions();
+  }
 
   printAllSettings();
 
@@ -123,11 +136,27 @@ void printHelp() {
     "  sensitivity - Change sensitivity ratio setting"));
   Serial.println(F(
     "  reset       - Reset all settings to factory defaults"));
+  Serial.println(F(
+    "  odometer    - Show lifetime usage counters for this servo"));
+  Serial.println(F(
+    "  servos      - List the connected servos"));
+  Serial.println(F(
+    "  select      - Select a servo, or all servos of the same model"));
+  Serial.println(F(
+    "  stream      - Play back setpoints streamed from the computer"));
+  Serial.println(F(
+    "  failtest    - Measure how long the fail-safe takes to engage"));
+  Serial.println(F(
+    "  explore     - Map which registers are writable and what they do"));
+  Serial.println(F(
+    "  line        - Check the pullup resistor and wiring"));
   Serial.println(F(
     "  help        - Show this list of commands again"));
 }
 
 void loop() {
+  updateSessions();
+
   Serial.println(F(
     "===================================================================="));
   Serial.println(F("Enter a command:"));
@@ -161,6 +190,26 @@ void loop() {
     changeSensitivityRatioSetting();
   } else if (parseWord(F("reset"))) {
     resetSettingsToFactoryDefaults();
+  } else if (parseWord(F("odometer"))) {
+    for (int i = 0; i < numSessions; ++i) {
+      if (isSessionActive(i)) {
+        printSessionLabel(i);
+        Serial.println();
+        sessions[i].odometer.print(Serial);
+      }
+    }
+  } else if (parseWord(F("servos"))) {
+    printSessions();
+  } else if (parseWord(F("select"))) {
+    changeSelectedSession();
+  } else if (parseWord(F("stream"))) {
+    streamSetpoints();
+  } else if (parseWord(F("failtest"))) {
+    runFailSafeTest();
+  } else if (parseWord(F("explore"))) {
+    runRegisterExplorer();
+  } else if (parseWord(F("line"))) {
+    diagnoseSessionLines();
   } else if (parseWord(F("help"))) {
     printHelp();
   } else {
@@ -4,6 +4,7 @@
 #include "ModelSpecs.h"
 #include "Move.h"
 #include "Programmer.h"
+#include "Session.h"
 #include "Settings.h"
 
 void printRangeLeftAPVSetting() {
@@ -23,6 +24,19 @@ void printRangeCenterAPVSetting() {
 
 bool changeRangeSettingsDetect(); // forward declaration
 
+/* The detect, interactive, and apv options find the endpoints of one particular
+servo. Copying those to the rest of a group would be wrong, since no two servos
+have quite the same range. */
+bool checkNotGroupRange() {
+  if (groupMode) {
+    Serial.println(F(
+      "Error: This option finds the range of one servo, so it can't be used\r\n"
+      "on a group. Use \"select\" to pick one servo."));
+    return false;
+  }
+  return true;
+}
+
 bool changeRangeSettingsDefault() {
   Serial.println(F(
     "Change range settings to factory defaults? Enter \"y\" or \"n\":"));
@@ -35,14 +49,7 @@ bool changeRangeSettingsDefault() {
   settings.rangeCenterAPV = -1;
   saveSettings();
 
-  if (!servo.isModelSupported()) {
-    /* The servo library doesn't know the default values of rangeLeftAPV/etc.,
-    but we just reset the servo, so we know the current values must be the
-    default values. Record those values. */
-    defaultRangeLeftAPV = settings.rangeLeftAPV;
-    defaultRangeRightAPV = settings.rangeRightAPV;
-    defaultRangeCenterAPV = settings.rangeCenterAPV;
-  }
+  recordDefaultRangeAPVs();
 
   return true;
 }
@@ -80,6 +87,10 @@ bool changeRangeSettingsWidest() {
 }
 
 bool changeRangeSettingsDetect() {
+  if (!checkNotGroupRange()) {
+    return false;
+  }
+
   Serial.println(F(
     "To detect the limits, the servo will move as far as possible in each \r\n"
     "direction. When ready, enter \"y\" to begin (or \"n\" to cancel):"
@@ -154,13 +165,17 @@ void printRangeSettingsInteractiveHelp() {
 }
 
 bool changeRangeSettingsInteractive() {
+  if (!checkNotGroupRange()) {
+    return false;
+  }
+
   int16_t left = settings.rangeLeftAPV;
   int16_t right = settings.rangeCenterAPV;
   int16_t center = settings.rangeRightAPV;
 
   printRangeSettingsInteractiveHelp();
 
-  int16_t actualAPV = servo.readCurrentAPV();
+  int16_t actualAPV = servo->readCurrentAPV();
 
   while (true) {
     Serial.println(F("Enter a command for setting range of motion:"));
@@ -243,6 +258,10 @@ bool changeRangeSettingsAPVHelper(int16_t *newAPVOut) {
 }
 
 bool changeRangeSettingsAPV() {
+  if (!checkNotGroupRange()) {
+    return false;
+  }
+
   Serial.println(F(
     "Enter new left endpoint APV from 0 to 16383 (or nothing to keep same):"));
   int16_t left = settings.rangeLeftAPV;
@@ -288,6 +307,10 @@ void changeRangeSettings() {
     "  interactive - Change range by moving servo until it looks right"));
   Serial.println(F(
     "  apv         - Change range to specific APV numbers you type in"));
+  if (groupMode) {
+    Serial.println(F(
+      "(For a group, only \"default\" and \"widest\" are available.)"));
+  }
 
   scanRawInput();
   if (parseWord(F("default"))) {
@@ -0,0 +1,205 @@
+#include "RegisterExplorer.h"
+
+#include <HitecDServoInternal.h>
+
+#include "CommandLine.h"
+#include "Programmer.h"
+#include "Session.h"
+
+/* How far the servo may drift, in APV, before we blame the write. */
+#define EXPLORE_APV_MARGIN 50
+
+/* How much the motor power may rise before we blame the write. */
+#define EXPLORE_POWER_MARGIN 100
+
+/* Writing these would save, reboot, reset, or move the servo. */
+uint8_t registersNotToExplore[] = {
+  HD_REG_SAVE,
+  HD_REG_REBOOT,
+  HD_REG_FACTORY_RESET,
+  HD_REG_TARGET
+};
+
+struct ExploreBaseline {
+  int16_t apv;
+  int16_t power;
+  uint16_t effectivePowerLimit;
+};
+
+bool shouldExploreRegister(uint8_t reg) {
+  for (int i = 0; i < (int)sizeof(registersNotToExplore); ++i) {
+    if (registersNotToExplore[i] == reg) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void printExploreHex(uint16_t val, int digits) {
+  for (int shift = 4 * (digits - 1); shift >= 0; shift -= 4) {
+    Serial.print((val >> shift) & 0x0F, HEX);
+  }
+}
+
+/* Reads the behavior registers. Returns HITECD_OK or an error code. */
+int readExploreBaseline(ExploreBaseline *baselineOut) {
+  int res;
+  if ((baselineOut->apv = servo->readCurrentAPV()) < 0) {
+    return baselineOut->apv;
+  }
+  if ((res = servo->readMotorPower(&baselineOut->power)) != HITECD_OK) {
+    return res;
+  }
+  return servo->readRawRegister(
+    HD_REG_EFFECTIVE_POWER_LIMIT, &baselineOut->effectivePowerLimit);
+}
+
+/* Waits for the servo to come back after it stopped responding, and takes a
+new baseline. */
+void recoverExplore(ExploreBaseline *baseline) {
+  int res;
+  if ((res = servo->waitUntilBooted()) != HITECD_OK) {
+    printErr(res, true);
+  }
+  if ((res = readExploreBaseline(baseline)) != HITECD_OK) {
+    printErr(res, true);
+  }
+}
+
+void exploreRegister(uint8_t reg, ExploreBaseline *baseline) {
+  Serial.print(modelNumber);
+  Serial.print(F(",0x"));
+  printExploreHex(reg, 2);
+  Serial.print(',');
+
+  uint16_t original, again;
+  if (servo->readRawRegister(reg, &original) != HITECD_OK ||
+      servo->readRawRegister(reg, &again) != HITECD_OK) {
+    Serial.println(F(",E,,"));
+    return;
+  }
+  Serial.print(F("0x"));
+  printExploreHex(original, 4);
+  if (!shouldExploreRegister(reg)) {
+    Serial.println(F(",S,,"));
+    return;
+  }
+  if (again != original) {
+    Serial.println(F(",V,,"));
+    return;
+  }
+
+  uint16_t probe = original ^ 0x0001;
+  servo->writeRawRegister(reg, probe);
+  uint16_t readback;
+  bool responding = (servo->readRawRegister(reg, &readback) == HITECD_OK);
+
+  ExploreBaseline after;
+  bool effectPower = false, effectLimit = false, effectAPV = false;
+  if (responding && readExploreBaseline(&after) == HITECD_OK) {
+    effectPower = abs(after.power) >
+      abs(baseline->power) + EXPLORE_POWER_MARGIN;
+    effectLimit = after.effectivePowerLimit != baseline->effectivePowerLimit;
+    effectAPV = abs(after.apv - baseline->apv) > EXPLORE_APV_MARGIN;
+  } else {
+    responding = false;
+  }
+
+  if (!responding) {
+    /* Give it back its value as soon as it's listening again. */
+    recoverExplore(baseline);
+  }
+  servo->writeRawRegister(reg, original);
+  uint16_t restored;
+  bool effectUnrestored =
+    servo->readRawRegister(reg, &restored) != HITECD_OK ||
+    restored != original;
+
+  Serial.print(',');
+  if (!responding) {
+    Serial.print('E');
+  } else if (readback == probe) {
+    Serial.print('W');
+  } else if (readback == original) {
+    Serial.print('R');
+  } else {
+    Serial.print('M');
+  }
+  Serial.print(',');
+  if (responding) {
+    Serial.print(F("0x"));
+    printExploreHex(readback, 4);
+  }
+  Serial.print(',');
+  if (effectPower) Serial.print('P');
+  if (effectLimit) Serial.print('L');
+  if (effectAPV) Serial.print('A');
+  if (!responding) Serial.print('B');
+  if (effectUnrestored) Serial.print('U');
+  Serial.println();
+
+  /* If the servo moved or strained, let it settle before the next baseline
+  comparison. */
+  if (effectPower || effectAPV) {
+    delay(500);
+  }
+  if (effectPower || effectLimit || effectAPV) {
+    if (readExploreBaseline(baseline) != HITECD_OK) {
+      recoverExplore(baseline);
+    }
+  }
+}
+
+void runRegisterExplorer() {
+  if (groupMode) {
+    Serial.println(F(
+      "Error: The explorer runs on one servo. Use \"select\" to pick one."));
+    goto cancel;
+  }
+
+  Serial.println(F(
+    "The explorer will write test values to every register except SAVE,\r\n"
+    "REBOOT, FACTORY_RESET, and TARGET. Nothing is saved, and the servo is\r\n"
+    "rebooted at the end to discard any changes. But the effects of most\r\n"
+    "registers are unknown, so the servo may move unexpectedly, and there is\r\n"
+    "a small risk that some register saves or damages it. Only use a servo\r\n"
+    "you can afford to lose, and make sure it can move freely.\r\n"
+    "Continue? Enter \"y\" or \"n\":"));
+  if (!scanYesNo()) {
+    goto cancel;
+  }
+
+  /* Nested block prevents compiler warnings about "goto cancel" crossing
+  initialization of variables */
+  {
+    int res;
+    ExploreBaseline baseline;
+    if ((res = readExploreBaseline(&baseline)) != HITECD_OK) {
+      printErr(res, true);
+    }
+
+    uint32_t startMillis = millis();
+    Serial.println(F("model,reg,value,access,readback,effects"));
+    for (int reg = 0x00; reg <= 0xFE; reg += 2) {
+      exploreRegister(reg, &baseline);
+    }
+    Serial.print(F("Explored 128 registers in "));
+    Serial.print((millis() - startMillis) / 1000);
+    Serial.println(F("s."));
+
+    Serial.println(F("Rebooting the servo to discard any changes..."));
+    servo->writeRawRegister(HD_REG_REBOOT, HD_REBOOT_CONST);
+    delay(1000);
+    if ((res = servo->waitUntilBooted()) != HITECD_OK) {
+      printErr(res, true);
+    }
+    if ((res = servo->readSettings(&settings)) != HITECD_OK) {
+      printErr(res, true);
+    }
+    Serial.println(F("Done."));
+  }
+  return;
+
+cancel:
+  Serial.println(F("Explorer will not be run."));
+}
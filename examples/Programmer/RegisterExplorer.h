@@ -0,0 +1,34 @@
+#ifndef RegisterExplorer_h
+#define RegisterExplorer_h
+
+#include <Arduino.h>
+
+/* The "explore" command walks every even register from 0x00 to 0xFE, to map
+out which ones can be written and what writing them does. For each register:
+1. Read it twice. If the two reads differ, it changes by itself, so it's marked
+   volatile and not written.
+2. Write the value with its lowest bit flipped (in RAM only; nothing is saved),
+   and read it back.
+3. Read the motor power (0x10), the effective power limit (0x22), and the
+   current APV, and compare them with their values at the start.
+4. Write the original value back, and check that it stuck.
+A few registers are never written, because writing them saves, reboots, resets,
+or moves the servo. At the end the servo is rebooted without saving, which
+discards anything that wasn't put back.
+
+The result is printed as CSV, one line per register:
+    model,reg,value,access,readback,effects
+`access` is one of:
+    W  writable: read back what was written
+    M  modified: read back something else (masked or clamped)
+    R  read-only: the write was ignored
+    V  volatile: changes by itself, so not tested
+    S  skipped: never written (see above)
+    E  the register couldn't be read
+`effects` lists what the write did: P (motor power rose), L (effective power
+limit changed), A (servo moved), B (servo stopped responding, e.g. rebooted),
+U (original value couldn't be restored). Each register takes about 7 reads, so
+the whole run takes about 15 seconds. */
+void runRegisterExplorer();
+
+#endif /* RegisterExplorer_h */
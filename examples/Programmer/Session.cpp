@@ -0,0 +1,351 @@
+#include "Session.h"
+
+#include "CommandLine.h"
+#include "ModelSpecs.h"
+#include "Move.h"
+#include "Programmer.h"
+
+Session sessions[MAX_SESSIONS];
+int numSessions = 0;
+int currentSession = -1;
+bool groupMode = false;
+
+void storeSessionGlobals() {
+  Session &s = sessions[currentSession];
+  s.settings = settings;
+  s.defaultRangeLeftAPV = defaultRangeLeftAPV;
+  s.defaultRangeRightAPV = defaultRangeRightAPV;
+  s.defaultRangeCenterAPV = defaultRangeCenterAPV;
+  s.widestRangeLeftAPVClockwise = widestRangeLeftAPVClockwise;
+  s.widestRangeRightAPVClockwise = widestRangeRightAPVClockwise;
+  s.widestRangeCenterAPVClockwise = widestRangeCenterAPVClockwise;
+  s.allowUnsupportedModel = allowUnsupportedModel;
+}
+
+void loadSessionGlobals() {
+  Session &s = sessions[currentSession];
+  servo = &s.servo;
+  modelNumber = s.modelNumber;
+  settings = s.settings;
+  defaultRangeLeftAPV = s.defaultRangeLeftAPV;
+  defaultRangeRightAPV = s.defaultRangeRightAPV;
+  defaultRangeCenterAPV = s.defaultRangeCenterAPV;
+  widestRangeLeftAPVClockwise = s.widestRangeLeftAPVClockwise;
+  widestRangeRightAPVClockwise = s.widestRangeRightAPVClockwise;
+  widestRangeCenterAPVClockwise = s.widestRangeCenterAPVClockwise;
+  allowUnsupportedModel = s.allowUnsupportedModel;
+}
+
+void addSession(int16_t pin) {
+  int res;
+
+  for (int i = 0; i < numSessions; ++i) {
+    if (sessions[i].pin == pin) {
+      Serial.println(F("Error: Already connected to a servo on that pin."));
+      return;
+    }
+  }
+
+  Session &s = sessions[numSessions];
+  s.pin = pin;
+  int diagnosis;
+  if ((res = s.servo.attach(pin, &diagnosis)) != HITECD_OK) {
+    printErr(diagnosis, true);
+  }
+  printLineDiagnostics(&s.servo, false);
+  if ((s.modelNumber = s.servo.readModelNumber()) < 0) {
+    printErr(s.modelNumber, true);
+  }
+  if ((res = s.servo.readSettings(&s.settings)) != HITECD_OK) {
+    printErr(res, true);
+  }
+  /* All the servos share one odometer area, so give it plenty of records. */
+  if ((res = s.odometer.begin(&s.servo, 0, 2 * MAX_SESSIONS)) != HITECD_OK) {
+    printErr(res, true);
+  }
+  s.defaultRangeLeftAPV = -1;
+  s.defaultRangeRightAPV = -1;
+  s.defaultRangeCenterAPV = -1;
+  s.widestRangeLeftAPVClockwise = -1;
+  s.widestRangeRightAPVClockwise = -1;
+  s.widestRangeCenterAPVClockwise = -1;
+  s.allowUnsupportedModel = false;
+  ++numSessions;
+
+  selectSession(numSessions - 1);
+
+  Serial.print(F("Servo model: D"));
+  Serial.println(modelNumber, DEC);
+
+  setupModelSpecs();
+  storeSessionGlobals();
+}
+
+void selectSession(int index) {
+  if (currentSession != -1) {
+    storeSessionGlobals();
+  }
+  currentSession = index;
+  groupMode = false;
+  loadSessionGlobals();
+}
+
+bool isSessionActive(int index) {
+  if (index == currentSession) {
+    return true;
+  }
+  return groupMode && sessions[index].modelNumber == modelNumber;
+}
+
+void printSessionLabel(int index) {
+  Serial.print(F("Servo #"));
+  Serial.print(index + 1);
+  Serial.print(F(" (pin "));
+  Serial.print(sessions[index].pin);
+  Serial.print(F("): "));
+}
+
+void printLineDiagnostics(HitecDServo *lineServo, bool verbose) {
+  HitecDLineDiagnostics diagnostics;
+  int res = lineServo->diagnoseLine(&diagnostics);
+  if (verbose) {
+    if (diagnostics.pullupOhms != -1) {
+      Serial.print(F("Estimated pullup resistor: "));
+      Serial.print(diagnostics.pullupOhms);
+      Serial.println(F(" ohms"));
+    }
+    if (diagnostics.servoLowLevel != -1) {
+      Serial.print(F("Line level when servo pulls low: "));
+      Serial.print(100L * diagnostics.servoLowLevel / 1023);
+      Serial.println(F("% of supply"));
+    }
+    if (diagnostics.riseNanos != -1) {
+      Serial.print(F("Rise time: about "));
+      Serial.print(diagnostics.riseNanos);
+      Serial.println(F("ns"));
+    }
+    if (diagnostics.releasedLevel == -1) {
+      Serial.println(F(
+        "(Attach the servo to an analog pin for more detailed diagnostics.)"));
+    }
+  }
+  if (res == HITECD_OK) {
+    if (verbose) {
+      Serial.println(F("Line looks healthy."));
+    }
+  } else {
+    Serial.print(F("Warning: "));
+    Serial.println(hitecdErrToString(res));
+  }
+}
+
+void diagnoseSessionLines() {
+  for (int i = 0; i < numSessions; ++i) {
+    if (isSessionActive(i)) {
+      printSessionLabel(i);
+      Serial.println();
+      printLineDiagnostics(&sessions[i].servo, true);
+    }
+  }
+}
+
+void updateSessions() {
+  for (int i = 0; i < numSessions; ++i) {
+    sessions[i].odometer.update();
+  }
+}
+
+/* Mirrors a range, as needed when the direction changes. */
+void mirrorRange(HitecDSettings *s) {
+  int16_t prevRangeLeftAPV = s->rangeLeftAPV;
+  int16_t prevRangeRightAPV = s->rangeRightAPV;
+  int16_t prevRangeCenterAPV = s->rangeCenterAPV;
+  s->rangeLeftAPV = HITECD_APV_MAX - prevRangeRightAPV;
+  s->rangeRightAPV = HITECD_APV_MAX - prevRangeLeftAPV;
+  s->rangeCenterAPV = HITECD_APV_MAX - prevRangeCenterAPV;
+}
+
+/* Applies whatever the user changed on the leader (from `before` to `after`) to
+another servo in the group. Settings the user didn't touch are left alone, so
+each servo keeps its own values for those. */
+void applyGroupChanges(
+  const HitecDSettings &before,
+  const HitecDSettings &after,
+  HitecDSettings *member
+) {
+  if (after.id != before.id) {
+    member->id = after.id;
+  }
+
+  if (after.counterclockwise != before.counterclockwise) {
+    /* The leader's range was mirrored by changeDirectionSetting(); mirror this
+    servo's own range in the same way, rather than copying the leader's. */
+    if (member->counterclockwise != after.counterclockwise) {
+      member->counterclockwise = after.counterclockwise;
+      mirrorRange(member);
+    }
+  } else if (after.rangeLeftAPV != before.rangeLeftAPV ||
+      after.rangeRightAPV != before.rangeRightAPV ||
+      after.rangeCenterAPV != before.rangeCenterAPV) {
+    /* In group mode, the range can only be set to the default or the widest
+    range (see RangeSettings.cpp), which are the same for every servo of a
+    model, so copying is right. */
+    member->rangeLeftAPV = after.rangeLeftAPV;
+    member->rangeRightAPV = after.rangeRightAPV;
+    member->rangeCenterAPV = after.rangeCenterAPV;
+    /* -1 means "default", which doesn't depend on direction. */
+    if (member->counterclockwise != after.counterclockwise &&
+        after.rangeLeftAPV != -1) {
+      mirrorRange(member);
+    }
+  }
+
+  if (after.speed != before.speed) {
+    member->speed = after.speed;
+  }
+  if (after.deadband != before.deadband) {
+    member->deadband = after.deadband;
+  }
+  if (after.softStart != before.softStart) {
+    member->softStart = after.softStart;
+  }
+  if (after.failSafe != before.failSafe ||
+      after.failSafeLimp != before.failSafeLimp) {
+    member->failSafe = after.failSafe;
+    member->failSafeLimp = after.failSafeLimp;
+  }
+  if (after.powerLimit != before.powerLimit) {
+    member->powerLimit = after.powerLimit;
+  }
+  if (after.overloadProtection != before.overloadProtection) {
+    member->overloadProtection = after.overloadProtection;
+  }
+  if (after.smartSense != before.smartSense) {
+    member->smartSense = after.smartSense;
+  }
+  if (after.sensitivityRatio != before.sensitivityRatio) {
+    member->sensitivityRatio = after.sensitivityRatio;
+  }
+}
+
+HitecDSettings *sessionSettings(int index) {
+  return (index == currentSession) ? &settings : &sessions[index].settings;
+}
+
+void saveGroupSettings() {
+  int res;
+  Serial.println(F("Saving new servo settings for every servo in group..."));
+
+  /* Writing the settings starts by resetting the servo to factory settings,
+  which will overwrite any gentle-movement settings. */
+  usingGentleMovementSettings = false;
+
+  /* The session still holds the leader's settings from before the change. */
+  const HitecDSettings &before = sessions[currentSession].settings;
+
+  /* Write every servo before waiting for any of them to reboot. That way they
+  all reboot at the same time, instead of one after another. */
+  for (int i = 0; i < numSessions; ++i) {
+    if (!isSessionActive(i)) {
+      continue;
+    }
+    if (i != currentSession) {
+      applyGroupChanges(before, settings, &sessions[i].settings);
+    }
+    res = sessions[i].servo.writeSettingsUnsupportedModelThisMightDamageTheServo(
+      *sessionSettings(i),
+      allowUnsupportedModel
+    );
+    if (res != HITECD_OK) {
+      printSessionLabel(i);
+      printErr(res, true);
+    }
+  }
+
+  for (int i = 0; i < numSessions; ++i) {
+    if (!isSessionActive(i)) {
+      continue;
+    }
+    if ((res = sessions[i].servo.waitUntilBooted()) != HITECD_OK) {
+      printSessionLabel(i);
+      printErr(res, true);
+    }
+  }
+
+  /* Read back the settings to make sure we have the latest values. */
+  for (int i = 0; i < numSessions; ++i) {
+    if (!isSessionActive(i)) {
+      continue;
+    }
+    if ((res = sessions[i].servo.readSettings(sessionSettings(i)))
+        != HITECD_OK) {
+      printSessionLabel(i);
+      printErr(res, true);
+    }
+  }
+
+  storeSessionGlobals();
+  Serial.println(F("Done."));
+}
+
+void printSessions() {
+  Serial.println(F("Connected servos (* = selected, + = in group):"));
+  for (int i = 0; i < numSessions; ++i) {
+    if (i == currentSession) {
+      Serial.print(F("* "));
+    } else if (isSessionActive(i)) {
+      Serial.print(F("+ "));
+    } else {
+      Serial.print(F("  "));
+    }
+    printSessionLabel(i);
+    Serial.print('D');
+    Serial.print(sessions[i].modelNumber);
+    Serial.print(F(", ID "));
+    Serial.println(sessionSettings(i)->id);
+  }
+}
+
+void changeSelectedSession() {
+  printSessions();
+
+  Serial.println(F(
+    "Enter servo number, or \"all\" for every servo of the same model as\r\n"
+    "the selected servo (or nothing to cancel):"));
+  scanRawInput();
+  int16_t number;
+  if (parseWord(F("all"))) {
+    groupMode = true;
+    int groupSize = 0;
+    for (int i = 0; i < numSessions; ++i) {
+      if (isSessionActive(i)) {
+        ++groupSize;
+      } else {
+        printSessionLabel(i);
+        Serial.println(F("Not in group, because it's a different model."));
+      }
+    }
+    Serial.print(F("Selected a group of "));
+    Serial.print(groupSize);
+    Serial.println(F(" servos. Settings changes will apply to all of them."));
+    Serial.println(F(
+      "The \"show\" command shows the selected servo's settings; the other\r\n"
+      "servos keep their own values for any setting you don't change."));
+  } else if (rawInputLen == 0) {
+    goto cancel;
+  } else if (parseNumber(&number)) {
+    if (number < 1 || number > numSessions) {
+      Serial.println(F("Error: No servo with that number."));
+      goto cancel;
+    }
+    selectSession(number - 1);
+    printSessionLabel(currentSession);
+    Serial.println(F("Selected."));
+  } else {
+    goto cancel;
+  }
+  return;
+
+cancel:
+  Serial.println(F("Current selection will be kept."));
+}
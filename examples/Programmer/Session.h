@@ -0,0 +1,81 @@
+#ifndef Session_h
+#define Session_h
+
+#include <HitecDOdometer.h>
+#include <HitecDServo.h>
+
+/* The Programmer can be connected to several servos at once, one per pin. Each
+one has a Session that holds its state. The globals in Programmer.h and
+ModelSpecs.h always refer to the selected servo; selectSession() swaps them in
+and out of the Session objects.
+
+In group mode, the selected servo acts as the "leader" of a group containing
+every servo of the same model. Settings commands edit the leader's settings as
+usual, and then saveSettings() applies the same changes to every servo in the
+group. */
+
+/* Each Session takes roughly 110 bytes of SRAM, so boards with only 2KB of SRAM
+can't fit as many. */
+#if defined(RAMEND) && RAMEND < 0x900
+#define MAX_SESSIONS 6
+#else
+#define MAX_SESSIONS 12
+#endif
+
+struct Session {
+  int16_t pin;
+  HitecDServo servo;
+  HitecDOdometer odometer;
+  int modelNumber;
+  HitecDSettings settings;
+
+  /* Copies of the ModelSpecs.h globals for this servo */
+  int16_t defaultRangeLeftAPV;
+  int16_t defaultRangeRightAPV;
+  int16_t defaultRangeCenterAPV;
+  int16_t widestRangeLeftAPVClockwise;
+  int16_t widestRangeRightAPVClockwise;
+  int16_t widestRangeCenterAPVClockwise;
+  bool allowUnsupportedModel;
+};
+
+extern Session sessions[MAX_SESSIONS];
+extern int numSessions;
+extern int currentSession;
+extern bool groupMode;
+
+/* Attaches to a servo on the given pin and selects it. Errors are fatal. */
+void addSession(int16_t pin);
+
+/* Copies the globals back into the current session. Call this whenever the
+selected servo's settings have been re-read. */
+void storeSessionGlobals();
+
+/* Makes the given session the current one, and leaves group mode. */
+void selectSession(int index);
+
+/* Returns true if the given session is affected by commands, i.e. it's the
+current session, or it's in the current group. */
+bool isSessionActive(int index);
+
+/* Prints "Servo #n (pin p): " to label per-servo output. */
+void printSessionLabel(int index);
+
+/* Runs HitecDServo::diagnoseLine() and prints any problems. If `verbose`,
+also prints the measurements. */
+void printLineDiagnostics(HitecDServo *lineServo, bool verbose);
+
+/* Handler for the "line" command. */
+void diagnoseSessionLines();
+
+/* Calls update() on every session's odometer. */
+void updateSessions();
+
+/* Group-mode version of saveSettings(). */
+void saveGroupSettings();
+
+/* Handlers for the "servos" and "select" commands. */
+void printSessions();
+void changeSelectedSession();
+
+#endif /* Session_h */
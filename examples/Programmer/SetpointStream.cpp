@@ -0,0 +1,252 @@
+#include "SetpointStream.h"
+
+#include "CommandLine.h"
+#include "Programmer.h"
+#include "Session.h"
+
+/* Time for one byte to arrive at 115200 baud, rounded up */
+#define STREAM_BYTE_MICROS 87
+
+struct Setpoint {
+  uint8_t sessionIndex;
+  uint16_t tick;
+  int16_t quarterMicros;
+};
+
+/* The jitter buffer is a FIFO, because setpoints arrive in order of tick. */
+Setpoint streamBuffer[STREAM_BUFFER_SIZE];
+uint8_t streamBufferHead, streamBufferCount;
+
+uint8_t streamExpectedSeq;
+uint16_t streamNextTick;
+uint16_t streamUnderruns, streamOverruns, streamCorrupt;
+
+/* How many packets the host may send per status; see SetpointStream.h */
+uint8_t streamWindow;
+
+uint8_t streamPacket[8];
+uint8_t streamPacketLen;
+
+void sendStreamHello(int16_t tickMillis) {
+  uint8_t hello[9];
+  hello[0] = STREAM_HELLO_MAGIC_0;
+  hello[1] = STREAM_HELLO_MAGIC_1;
+  hello[2] = STREAM_HELLO_MAGIC_2;
+  hello[3] = STREAM_HELLO_MAGIC_3;
+  hello[4] = STREAM_PROTOCOL_VERSION;
+  hello[5] = tickMillis & 0xFF;
+  hello[6] = tickMillis >> 8;
+  hello[7] = numSessions;
+  hello[8] = hello[4] + hello[5] + hello[6] + hello[7];
+  Serial.write(hello, sizeof(hello));
+}
+
+void sendStreamStatus() {
+  uint8_t status[12];
+  status[0] = STREAM_STATUS_SYNC;
+  status[1] = streamExpectedSeq;
+  status[2] = streamNextTick & 0xFF;
+  status[3] = streamNextTick >> 8;
+  status[4] = min(STREAM_BUFFER_SIZE - streamBufferCount, (int)streamWindow);
+  status[5] = streamUnderruns & 0xFF;
+  status[6] = streamUnderruns >> 8;
+  status[7] = streamOverruns & 0xFF;
+  status[8] = streamOverruns >> 8;
+  status[9] = streamCorrupt & 0xFF;
+  status[10] = streamCorrupt >> 8;
+  uint8_t checksum = 0;
+  for (int i = 1; i < 11; ++i) {
+    checksum += status[i];
+  }
+  status[11] = checksum;
+  Serial.write(status, sizeof(status));
+}
+
+/* Returns true if a complete, valid packet was handled. Sets *stop if it was a
+stop packet. */
+bool handleStreamPacket(bool *stop) {
+  uint8_t checksum = 0;
+  for (int i = 1; i < 7; ++i) {
+    checksum += streamPacket[i];
+  }
+  uint8_t servoNumber = streamPacket[1];
+  if (checksum != streamPacket[7] ||
+      (servoNumber != STREAM_STOP_SERVO &&
+        (servoNumber < 1 || servoNumber > numSessions))) {
+    ++streamCorrupt;
+    return false;
+  }
+
+  /* Go-back-N: anything other than the next packet in sequence must be a
+  retransmission, or follows a packet we lost. Either way, ignore it. */
+  if (streamPacket[2] != streamExpectedSeq) {
+    return false;
+  }
+
+  if (servoNumber == STREAM_STOP_SERVO) {
+    ++streamExpectedSeq;
+    *stop = true;
+    return true;
+  }
+
+  Setpoint setpoint;
+  setpoint.sessionIndex = servoNumber - 1;
+  setpoint.tick = streamPacket[3] | (streamPacket[4] << 8);
+  setpoint.quarterMicros = streamPacket[5] | (streamPacket[6] << 8);
+
+  if ((int16_t)(setpoint.tick - streamNextTick) < 0) {
+    /* Too late; playing it now would distort the motion. */
+    ++streamUnderruns;
+  } else if (streamBufferCount == STREAM_BUFFER_SIZE) {
+    /* Don't advance the sequence number, so the host will resend it. */
+    ++streamOverruns;
+    return true;
+  } else {
+    uint8_t index = (streamBufferHead + streamBufferCount) % STREAM_BUFFER_SIZE;
+    streamBuffer[index] = setpoint;
+    ++streamBufferCount;
+  }
+  ++streamExpectedSeq;
+  return true;
+}
+
+/* Feeds any received bytes through the packet parser. Returns true if a valid
+packet was received. */
+bool receiveStreamPackets(bool *stop) {
+  bool received = false;
+  while (Serial.available() && !*stop) {
+    uint8_t next = Serial.read();
+    if (streamPacketLen == 0 && next != STREAM_SETPOINT_SYNC) {
+      /* Resynchronize after a corrupt or partial packet */
+      continue;
+    }
+    streamPacket[streamPacketLen++] = next;
+    if (streamPacketLen == sizeof(streamPacket)) {
+      streamPacketLen = 0;
+      if (handleStreamPacket(stop)) {
+        received = true;
+      }
+    }
+  }
+  return received;
+}
+
+/* If the host is in the middle of sending, keeps receiving until it has been
+quiet for a few byte times, or for as long as a full window of packets takes.
+This keeps writes to the servos, which disable interrupts, from landing in the
+middle of a burst. Returns true if a valid packet was received. */
+bool waitForStreamQuiet(bool *stop) {
+  bool received = false;
+  if (streamPacketLen == 0 && !Serial.available()) {
+    return received;
+  }
+  uint32_t startMicros = micros();
+  uint32_t lastByteMicros = startMicros;
+  uint32_t maxMicros = (uint32_t)streamWindow * 8 * STREAM_BYTE_MICROS;
+  while (!*stop && micros() - startMicros < maxMicros) {
+    if (Serial.available()) {
+      if (receiveStreamPackets(stop)) {
+        received = true;
+      }
+      lastByteMicros = micros();
+    } else if (micros() - lastByteMicros >= 3 * STREAM_BYTE_MICROS) {
+      break;
+    }
+  }
+  return received;
+}
+
+/* Writes every setpoint that's due at the current tick. Returns true if a valid
+packet was received in between writes. */
+bool playStreamTick(bool *stop) {
+  bool received = false;
+  while (streamBufferCount > 0) {
+    const Setpoint &setpoint = streamBuffer[streamBufferHead];
+    if ((int16_t)(setpoint.tick - streamNextTick) > 0) {
+      break;
+    }
+    if (waitForStreamQuiet(stop)) {
+      received = true;
+    }
+    sessions[setpoint.sessionIndex].servo.writeTargetQuarterMicros(
+      setpoint.quarterMicros);
+    streamBufferHead = (streamBufferHead + 1) % STREAM_BUFFER_SIZE;
+    --streamBufferCount;
+  }
+  ++streamNextTick;
+  return received;
+}
+
+void streamSetpoints() {
+  Serial.println(F(
+    "Enter tick length in milliseconds (or nothing to cancel):"));
+  int16_t tickMillis;
+  if (!scanNumber(&tickMillis)) {
+    goto cancel;
+  }
+  if (tickMillis < 5 || tickMillis > 1000) {
+    Serial.println(F("Error: Must be between 5 and 1000ms."));
+    goto cancel;
+  }
+
+  Serial.println(F(
+    "Streaming. The serial port now uses the binary protocol described in\r\n"
+    "SetpointStream.h, until the host sends a stop packet."));
+  sendStreamHello(tickMillis);
+  Serial.flush();
+
+  streamBufferHead = streamBufferCount = 0;
+  streamExpectedSeq = 0;
+  streamNextTick = 0;
+  streamUnderruns = streamOverruns = streamCorrupt = 0;
+  streamPacketLen = 0;
+  streamWindow = constrain(
+    1000 * (uint32_t)tickMillis / 4 / (8 * STREAM_BYTE_MICROS),
+    1, STREAM_BUFFER_SIZE);
+
+  /* Nested block prevents compiler warnings about "goto cancel" crossing
+  initialization of variables */
+  {
+    uint32_t tickMicros = 1000 * (uint32_t)tickMillis;
+    uint32_t nextTickStartMicros = micros();
+    uint32_t lastPacketMillis = millis();
+    bool stop = false;
+    sendStreamStatus();
+
+    while (!stop) {
+      if (receiveStreamPackets(&stop)) {
+        lastPacketMillis = millis();
+      }
+
+      if ((int32_t)(micros() - nextTickStartMicros) >= 0) {
+        if (playStreamTick(&stop)) {
+          lastPacketMillis = millis();
+        }
+        /* Advance from the scheduled start, not from now, so that time spent
+        writing to the servos doesn't accumulate as drift. */
+        nextTickStartMicros += tickMicros;
+        sendStreamStatus();
+      }
+
+      if (streamBufferCount == 0 &&
+          millis() - lastPacketMillis > STREAM_IDLE_TIMEOUT_MILLIS) {
+        break;
+      }
+    }
+  }
+
+  /* Let the host see the final counts. */
+  sendStreamStatus();
+  Serial.println();
+  Serial.println(F("Streaming stopped."));
+  Serial.print(F("Underruns: "));
+  Serial.println(streamUnderruns);
+  Serial.print(F("Overruns: "));
+  Serial.println(streamOverruns);
+  Serial.print(F("Corrupt packets: "));
+  Serial.println(streamCorrupt);
+  return;
+
+cancel:
+  Serial.println(F("Streaming will not be started."));
+}
@@ -0,0 +1,84 @@
+#ifndef SetpointStream_h
+#define SetpointStream_h
+
+#include <Arduino.h>
+
+/* The "stream" command switches the serial port to a binary protocol, so that a
+program on the computer can stream target positions to the servos at a steady
+rate. (See extras/StreamSetpoints.py for an example host program.)
+
+Streaming starts with a hello packet from the Arduino. Its magic bytes can't
+appear in the text that the command line prints, so the host can wait for them
+instead of matching prompts, and then know that everything after them is
+binary. Time is divided into ticks of a fixed length, chosen when streaming
+starts. Tick 0 starts when the first status packet is sent, right after the
+hello. The host sends setpoint packets
+that say "at tick T, move servo S to position P". They're held in a jitter
+buffer, and played out at the start of tick T, so delays in the USB connection
+don't affect the timing of the motion as long as the host sends each setpoint a
+little ahead of time.
+
+Hello packet, Arduino to host (9 bytes), sent once:
+  0-3: STREAM_HELLO_MAGIC_0 ... STREAM_HELLO_MAGIC_3
+  4: STREAM_PROTOCOL_VERSION
+  5-6: Tick length in milliseconds (uint16_t, little-endian)
+  7: Number of servos
+  8: Checksum: sum of bytes 4-7, modulo 256
+
+Setpoint packet, host to Arduino (8 bytes):
+  0: STREAM_SETPOINT_SYNC
+  1: Servo number, as shown by the "servos" command; or STREAM_STOP_SERVO to
+     stop streaming and go back to the command line.
+  2: Sequence number
+  3-4: Tick (uint16_t, little-endian; wraps around)
+  5-6: Target, in quarter-microseconds (int16_t, little-endian)
+  7: Checksum: sum of bytes 1-6, modulo 256
+
+Status packet, Arduino to host (12 bytes), sent at the end of every tick:
+  0: STREAM_STATUS_SYNC
+  1: Next expected sequence number
+  2-3: Next tick to be played out
+  4: Credit: how many setpoint packets the host may send now
+  5-6: Underruns: setpoints that arrived after their tick, and were discarded
+  7-8: Overruns: setpoints that arrived when the buffer was full
+  9-10: Corrupt packets
+  11: Checksum: sum of bytes 1-10, modulo 256
+
+Setpoints must be sent in order of tick. The Arduino only accepts the packet
+with the expected sequence number, and ignores any others. So if a packet is
+lost or rejected (e.g. because the buffer was full), the host must go back and
+resend everything from the expected sequence number onwards.
+
+Bytes are easily lost, because interrupts are disabled for about 0.6ms while
+each target is written to a servo, and the UART only holds two bytes. So the
+host must pace itself: send packets only right after receiving a status packet
+(which is sent once the tick's writes are done), and no more than the credit it
+gives. The credit is at most the number of free slots in the jitter buffer, and
+at most as many packets as take a quarter of a tick to arrive, leaving the rest
+of the tick for USB latency. As a second line of defense, if a packet is still
+arriving when a write is due, the write waits until the host stops sending. Any
+packets that are garbled anyway are counted as corrupt, and a rising count means
+the host isn't pacing itself.
+
+If no valid packet arrives for STREAM_IDLE_TIMEOUT_MILLIS and the buffer is
+empty, streaming stops automatically. */
+
+#define STREAM_HELLO_MAGIC_0 0xC3
+#define STREAM_HELLO_MAGIC_1 0x3C
+#define STREAM_HELLO_MAGIC_2 0xA5
+#define STREAM_HELLO_MAGIC_3 0x5A
+#define STREAM_PROTOCOL_VERSION 1
+#define STREAM_SETPOINT_SYNC 0xA5
+#define STREAM_STATUS_SYNC 0x5A
+#define STREAM_STOP_SERVO 0xFF
+#define STREAM_IDLE_TIMEOUT_MILLIS 5000
+
+#if defined(RAMEND) && RAMEND < 0x900
+#define STREAM_BUFFER_SIZE 32
+#else
+#define STREAM_BUFFER_SIZE 128
+#endif
+
+void streamSetpoints();
+
+#endif /* SetpointStream_h */
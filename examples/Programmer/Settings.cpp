@@ -5,6 +5,7 @@
 #include "Move.h"
 #include "Programmer.h"
 #include "RangeSettings.h"
+#include "Session.h"
 
 void printValueWithDefault(int16_t value, int16_t defaultValue) {
   Serial.print(value, DEC);
@@ -36,6 +37,11 @@ void printAllSettings() {
 }
 
 void saveSettings() {
+  if (groupMode) {
+    saveGroupSettings();
+    return;
+  }
+
   int res;
   Serial.println(F("Saving new servo settings..."));
 
@@ -43,7 +49,7 @@ void saveSettings() {
   which will overwrite any gentle-movement settings. */
   usingGentleMovementSettings = false;
 
-  res = servo.writeSettingsUnsupportedModelThisMightDamageTheServo(
+  res = servo->writeSettingsUnsupportedModelThisMightDamageTheServo(
     settings,
     allowUnsupportedModel
   );
@@ -55,9 +61,10 @@ void saveSettings() {
   delay(1000);
 
   /* Read back the settings to make sure we have the latest values. */
-  if ((res = servo.readSettings(&settings)) != HITECD_OK) {
+  if ((res = servo->readSettings(&settings)) != HITECD_OK) {
     printErr(res, true);
   }
+  storeSessionGlobals();
 
   Serial.println(F("Done."));
 }
@@ -465,16 +472,18 @@ void resetSettingsToFactoryDefaults() {
   }
 
   settings = HitecDSettings();
+  if (groupMode) {
+    /* Reset every setting on every servo in the group, not just the settings
+    that differed on the selected servo. */
+    for (int i = 0; i < numSessions; ++i) {
+      if (isSessionActive(i)) {
+        sessions[i].settings = HitecDSettings();
+      }
+    }
+  }
   saveSettings();
 
-  if (!servo.isModelSupported()) {
-    /* The servo library doesn't know the default values of rangeLeftAPV/etc.,
-    but we just reset the servo, so we know the current values must be the
-    default values. Record those values. */
-    defaultRangeLeftAPV = settings.rangeLeftAPV;
-    defaultRangeRightAPV = settings.rangeRightAPV;
-    defaultRangeCenterAPV = settings.rangeCenterAPV;
-  }
+  recordDefaultRangeAPVs();
 
   Serial.println(F("New servo settings:"));
   printAllSettings();
@@ -0,0 +1,304 @@
+#!/usr/bin/env python3
+"""Compiles a fleet description into PROGMEM settings programs.
+
+Usage:
+    FleetCompiler.py FLEET.json OUTPUT_DIR
+
+FLEET.json describes the servo settings for one or more robot variants. (See
+FleetExample.json.) Each servo's settings are built up in this order:
+  1. The HitecDSettings defaults.
+  2. The variant's "profile", if any.
+  3. The servo's "profile", if any. (Either may also be a list of profiles,
+     applied in order.)
+  4. The servo's "calibration" (normally rangeLeftAPV/etc.).
+  5. Any settings given directly on the servo.
+Field names are the same as the HitecDSettings fields. The servo's "id" is
+written to the servo, and is also used by the sketch to look up its program.
+
+Everything is checked against the legal ranges documented in HitecDServo.h. For
+each variant, the output is:
+  OUTPUT_DIR/<variant>/servo_<id>.h  One HITECD_SETTINGS_PROGRAM() per servo.
+  OUTPUT_DIR/<variant>.h             Includes all of the above, and declares a
+                                     PROGMEM lookup table from id to program.
+The sketch includes <variant>.h, and provisions a servo like this:
+
+    const HitecDSettingsProgramTable *program = hitecdFleetLookup(
+      fleet_robot_a, FLEET_ROBOT_A_LENGTH, id);
+    if (program != NULL) {
+      servo.writeSettingsProgram(*program);
+    }
+
+Files are only rewritten if their contents change, so after editing one servo,
+only that servo's header gets a new timestamp.
+"""
+
+import json
+import os
+import re
+import sys
+
+APV_MAX = (1 << 14) - 1
+SENSITIVITY_RATIO_MIN = 0x0333
+SENSITIVITY_RATIO_MAX = 0x0FFF
+
+# The HitecDSettings defaults; see HitecDServo.h.
+DEFAULTS = {
+    "id": 0,
+    "counterclockwise": False,
+    "speed": 100,
+    "deadband": 1,
+    "softStart": 20,
+    "rangeLeftAPV": -1,
+    "rangeRightAPV": -1,
+    "rangeCenterAPV": -1,
+    "failSafe": 0,
+    "failSafeLimp": False,
+    "powerLimit": 100,
+    "overloadProtection": 100,
+    "smartSense": True,
+    "sensitivityRatio": SENSITIVITY_RATIO_MAX,
+}
+
+BOOL_FIELDS = ("counterclockwise", "failSafeLimp", "smartSense")
+
+
+class FleetError(Exception):
+    pass
+
+
+def check_settings(where, s):
+    """Mirrors the hitecdIsLegal*() checks in HitecDSettingsCodec.h."""
+    def fail(msg):
+        raise FleetError("%s: %s" % (where, msg))
+
+    for field, value in s.items():
+        if field in BOOL_FIELDS:
+            if not isinstance(value, bool):
+                fail("%s must be true or false" % field)
+        elif not isinstance(value, int) or isinstance(value, bool):
+            fail("%s must be an integer" % field)
+
+    if not 0 <= s["id"] <= 254:
+        fail("id must be from 0 to 254")
+    if not (10 <= s["speed"] <= 100 and s["speed"] % 10 == 0):
+        fail("speed must be 10, 20, ... 100")
+    if not 1 <= s["deadband"] <= 10:
+        fail("deadband must be from 1 to 10")
+    if not (20 <= s["softStart"] <= 100 and s["softStart"] % 20 == 0):
+        fail("softStart must be 20, 40, ... 100")
+    range_apvs = (s["rangeLeftAPV"], s["rangeRightAPV"], s["rangeCenterAPV"])
+    for apv in range_apvs:
+        if apv != -1 and not 0 <= apv <= APV_MAX:
+            fail("range APVs must be -1 or from 0 to %d" % APV_MAX)
+    left, right, center = range_apvs
+    if -1 not in range_apvs and not left < center < right:
+        fail("rangeCenterAPV must be between rangeLeftAPV and rangeRightAPV")
+    if s["failSafe"] != 0 and (
+            s["failSafeLimp"] or not 850 <= s["failSafe"] <= 2150):
+        fail("failSafe must be 0 or from 850 to 2150, and 0 if failSafeLimp")
+    if not 0 <= s["powerLimit"] <= 100:
+        fail("powerLimit must be from 0 to 100")
+    op = s["overloadProtection"]
+    if not (op == 100 or (10 <= op <= 50 and op % 10 == 0)):
+        fail("overloadProtection must be 10, 20, ... 50, or 100")
+    if not SENSITIVITY_RATIO_MIN <= s["sensitivityRatio"] <= \
+            SENSITIVITY_RATIO_MAX:
+        fail("sensitivityRatio must be from %d to %d" % (
+            SENSITIVITY_RATIO_MIN, SENSITIVITY_RATIO_MAX))
+
+
+def apply_fields(where, settings, fields):
+    for field, value in fields.items():
+        if field not in DEFAULTS:
+            raise FleetError("%s: unknown setting %r" % (where, field))
+        settings[field] = value
+
+
+def apply_profiles(where, settings, names, profiles):
+    if names is None:
+        return
+    if isinstance(names, str):
+        names = [names]
+    for name in names:
+        if name not in profiles:
+            raise FleetError("%s: unknown profile %r" % (where, name))
+        apply_fields("profile %r" % name, settings, profiles[name])
+
+
+def resolve(fleet):
+    """Returns {variant: [settings, ...]}."""
+    profiles = fleet.get("profiles", {})
+    result = {}
+    for variant, desc in fleet.get("variants", {}).items():
+        if not re.match(r"^[A-Za-z_][A-Za-z0-9_]*$", variant):
+            raise FleetError(
+                "variant %r: name must be a valid C identifier" % variant)
+        servos = []
+        ids = set()
+        for index, servo in enumerate(desc.get("servos", [])):
+            where = "variant %r, servo #%d" % (variant, index + 1)
+            if "id" not in servo:
+                raise FleetError("%s: missing id" % where)
+            where = "variant %r, servo id %r" % (variant, servo["id"])
+            settings = dict(DEFAULTS)
+            apply_profiles(where, settings, desc.get("profile"), profiles)
+            apply_profiles(where, settings, servo.get("profile"), profiles)
+            apply_fields(where, settings, servo.get("calibration", {}))
+            apply_fields(where, settings, {
+                k: v for k, v in servo.items()
+                if k not in ("profile", "calibration")})
+            check_settings(where, settings)
+            if settings["id"] in ids:
+                raise FleetError("%s: duplicate id" % where)
+            ids.add(settings["id"])
+            servos.append(settings)
+        result[variant] = servos
+    return result
+
+
+def cpp_bool(value):
+    return "true" if value else "false"
+
+
+def settings_expr(s):
+    """Returns a constexpr HitecDSettings expression, only mentioning the
+    settings that differ from the defaults."""
+    parts = ["HitecDSettings()"]
+    simple = ("id", "counterclockwise", "speed", "deadband", "softStart",
+              "powerLimit", "overloadProtection", "smartSense",
+              "sensitivityRatio")
+    for field in simple:
+        if s[field] != DEFAULTS[field]:
+            value = s[field]
+            value = cpp_bool(value) if field in BOOL_FIELDS else str(value)
+            parts.append("with%s%s(%s)" % (field[0].upper(), field[1:], value))
+    if (s["rangeLeftAPV"], s["rangeRightAPV"], s["rangeCenterAPV"]) != \
+            (-1, -1, -1):
+        parts.append("withRangeAPV(%d, %d, %d)" % (
+            s["rangeLeftAPV"], s["rangeRightAPV"], s["rangeCenterAPV"]))
+    if s["failSafe"] != 0 or s["failSafeLimp"]:
+        parts.append("withFailSafe(%d, %s)" % (
+            s["failSafe"], cpp_bool(s["failSafeLimp"])))
+    return "\n    .".join(parts)
+
+
+HEADER_COMMENT = "/* Generated by extras/FleetCompiler.py. Do not edit. */\n"
+
+
+def servo_header(variant, s):
+    name = "fleet_%s_servo_%d" % (variant, s["id"])
+    guard = "Fleet_%s_servo_%d_h" % (variant, s["id"])
+    return (
+        HEADER_COMMENT +
+        "\n"
+        "#ifndef %s\n"
+        "#define %s\n"
+        "\n"
+        "#include <HitecDSettingsProgram.h>\n"
+        "\n"
+        "constexpr HitecDSettings %s_settings =\n"
+        "  %s;\n"
+        "HITECD_SETTINGS_PROGRAM(%s, %s_settings);\n"
+        "\n"
+        "#endif /* %s */\n"
+    ) % (guard, guard, name, settings_expr(s), name, name, guard)
+
+
+def variant_header(variant, servos):
+    guard = "Fleet_%s_h" % variant
+    lines = [
+        HEADER_COMMENT,
+        "#ifndef %s" % guard,
+        "#define %s" % guard,
+        "",
+        "#include <HitecDSettingsProgram.h>",
+        "",
+        "#ifndef HITECD_FLEET_ENTRY_DEFINED",
+        "#define HITECD_FLEET_ENTRY_DEFINED",
+        "struct HitecDFleetEntry {",
+        "  uint8_t id;",
+        "  const HitecDSettingsProgramTable *program;",
+        "};",
+        "",
+        "/* Returns the program for the given servo ID, or NULL if there is"
+        " none. */",
+        "inline const HitecDSettingsProgramTable *hitecdFleetLookup(",
+        "  const HitecDFleetEntry *entriesPGM, int length, uint8_t id",
+        ") {",
+        "  for (int i = 0; i < length; ++i) {",
+        "    if (pgm_read_byte(&entriesPGM[i].id) == id) {",
+        "      return (const HitecDSettingsProgramTable *)"
+        "pgm_read_ptr(&entriesPGM[i].program);",
+        "    }",
+        "  }",
+        "  return NULL;",
+        "}",
+        "#endif",
+        "",
+    ]
+    for s in servos:
+        lines.append('#include "%s/servo_%d.h"' % (variant, s["id"]))
+    lines += [
+        "",
+        "#define FLEET_%s_LENGTH %d" % (variant.upper(), len(servos)),
+        "const HitecDFleetEntry fleet_%s[] PROGMEM = {" % variant,
+    ]
+    for s in servos:
+        lines.append(
+            "  {%d, &fleet_%s_servo_%d}," % (s["id"], variant, s["id"]))
+    lines += ["};", "", "#endif /* %s */" % guard, ""]
+    return "\n".join(lines)
+
+
+def write_if_changed(path, contents):
+    """Returns True if the file was (re)written."""
+    try:
+        with open(path) as f:
+            if f.read() == contents:
+                return False
+    except FileNotFoundError:
+        pass
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "w") as f:
+        f.write(contents)
+    return True
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    fleet_path, out_dir = sys.argv[1:]
+
+    with open(fleet_path) as f:
+        fleet = json.load(f)
+    try:
+        variants = resolve(fleet)
+    except FleetError as e:
+        sys.exit("%s: error: %s" % (fleet_path, e))
+
+    changed = 0
+    for variant, servos in variants.items():
+        wanted = set()
+        for s in servos:
+            path = os.path.join(out_dir, variant, "servo_%d.h" % s["id"])
+            wanted.add(os.path.basename(path))
+            if write_if_changed(path, servo_header(variant, s)):
+                print("wrote %s" % path)
+                changed += 1
+        # Remove headers for servos that were deleted from the fleet.
+        variant_dir = os.path.join(out_dir, variant)
+        if os.path.isdir(variant_dir):
+            for name in os.listdir(variant_dir):
+                if re.match(r"^servo_\d+\.h$", name) and name not in wanted:
+                    os.remove(os.path.join(variant_dir, name))
+                    print("removed %s" % os.path.join(variant_dir, name))
+                    changed += 1
+        path = os.path.join(out_dir, variant + ".h")
+        if write_if_changed(path, variant_header(variant, servos)):
+            print("wrote %s" % path)
+            changed += 1
+    print("%d file(s) changed" % changed)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Streams setpoints to the Programmer sketch's "stream" command.
+
+Usage:
+    StreamSetpoints.py PORT TRAJECTORY.csv --pins 5,6 [--tick-ms 20]
+
+TRAJECTORY.csv has one setpoint per line: tick,servo,quarterMicros. Ticks must
+be in non-decreasing order. Servo numbers are as shown by the Programmer's
+"servos" command, i.e. in the order the pins were given.
+
+Opening the serial port resets most Arduinos, so this script answers the
+Programmer's startup prompts with the given pins, then starts streaming. It
+doesn't read the prompts: it sends each line once the sketch has gone quiet
+(i.e. is waiting for input), and then waits for the hello packet that starts
+the stream, which also confirms the tick length and the number of servos. See
+examples/Programmer/SetpointStream.h for the protocol. Requires pyserial.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+HELLO_MAGIC = bytes([0xC3, 0x3C, 0xA5, 0x5A])
+PROTOCOL_VERSION = 1
+SETPOINT_SYNC = 0xA5
+STATUS_SYNC = 0x5A
+STOP_SERVO = 0xFF
+
+# Stay this many ticks ahead of playback, to absorb USB latency.
+LEAD_TICKS = 10
+
+# The sketch is taken to be waiting for input once it has printed something and
+# then sent nothing for this long.
+QUIET_SECONDS = 0.5
+
+# How long to wait for the sketch to print anything, including the time it
+# takes an Arduino to reset when the port is opened.
+STARTUP_SECONDS = 10
+
+
+def send_line_when_quiet(port, line):
+    deadline = time.monotonic() + STARTUP_SECONDS
+    port.timeout = QUIET_SECONDS
+    heard = False
+    while True:
+        if port.read(256):
+            heard = True
+        elif heard:
+            break
+        elif time.monotonic() > deadline:
+            sys.exit("Timed out waiting for the sketch")
+    port.timeout = STARTUP_SECONDS
+    port.write(line.encode() + b"\n")
+
+
+def wait_for_hello(port):
+    """Returns (tick_ms, num_servos) from the hello packet."""
+    buf = b""
+    while not buf.endswith(HELLO_MAGIC):
+        c = port.read(1)
+        if not c:
+            sys.exit("Timed out waiting for the stream to start")
+        buf = buf[-len(HELLO_MAGIC):] + c
+    body = port.read(5)
+    if len(body) != 5 or sum(body[:4]) & 0xFF != body[4]:
+        sys.exit("Corrupt hello packet")
+    version, tick_ms, num_servos = struct.unpack("<BHB", body[:4])
+    if version != PROTOCOL_VERSION:
+        sys.exit("The sketch speaks stream protocol version %d, not %d" % (
+            version, PROTOCOL_VERSION))
+    return tick_ms, num_servos
+
+
+def setpoint_packet(seq, servo, tick, quarter_micros):
+    body = struct.pack("<BBHh", servo, seq & 0xFF, tick & 0xFFFF,
+                       quarter_micros)
+    return bytes([SETPOINT_SYNC]) + body + bytes([sum(body) & 0xFF])
+
+
+def read_status(port):
+    """Returns (expected_seq, next_tick, credit, underruns, overruns, corrupt).
+    """
+    while True:
+        c = port.read(1)
+        if not c:
+            sys.exit("Timed out waiting for status")
+        if c[0] != STATUS_SYNC:
+            continue
+        body = port.read(11)
+        if len(body) == 11 and sum(body[:10]) & 0xFF == body[10]:
+            return struct.unpack("<BHBHHH", body[:10])
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("port")
+    parser.add_argument("trajectory")
+    parser.add_argument("--pins", required=True)
+    parser.add_argument("--tick-ms", type=int, default=20)
+    args = parser.parse_args()
+
+    setpoints = []
+    with open(args.trajectory) as f:
+        for line in f:
+            if line.strip() and not line.startswith("#"):
+                tick, servo, qus = (int(x) for x in line.split(","))
+                setpoints.append((tick, servo, qus))
+
+    pins = args.pins.split(",")
+    port = serial.Serial(args.port, 115200, timeout=STARTUP_SECONDS)
+    # The pins, an empty line to end the list, the command, and its answer.
+    for line in pins + ["", "stream", str(args.tick_ms)]:
+        send_line_when_quiet(port, line)
+    tick_ms, num_servos = wait_for_hello(port)
+    if tick_ms != args.tick_ms or num_servos != len(pins):
+        sys.exit("The sketch is streaming %d servos at %dms ticks, "
+                 "not %d at %dms" % (num_servos, tick_ms, len(pins),
+                                     args.tick_ms))
+
+    # Go-back-N: `base` is the index of the oldest unacknowledged setpoint,
+    # i.e. the one the Arduino expects next. `sent` is one past the newest
+    # setpoint sent, so anything below it that gets sent again is a resend.
+    base = 0
+    sent = 0
+    resent = 0
+    while True:
+        seq, next_tick, credit, underruns, overruns, corrupt = read_status(port)
+        base += (seq - base) & 0xFF
+        if base > len(setpoints):
+            break
+        if base == len(setpoints):
+            port.write(setpoint_packet(base, STOP_SERVO, 0, 0))
+            continue
+        # Send no more than the credit, in one burst right after the status,
+        # so that it arrives while the Arduino isn't talking to the servos.
+        # Also don't get too far ahead of playback.
+        packets = b""
+        for i in range(base, min(base + credit, len(setpoints))):
+            tick, servo, qus = setpoints[i]
+            if tick - next_tick > LEAD_TICKS:
+                break
+            packets += setpoint_packet(i, servo, tick, qus)
+            if i < sent:
+                resent += 1
+            sent = max(sent, i + 1)
+        port.write(packets)
+        print("tick %d: underruns=%d overruns=%d corrupt=%d resent=%d" % (
+            next_tick, underruns, overruns, corrupt, resent), end="\r")
+    print()
+
+    # Corrupt packets mean bytes were lost on the way in, which the pacing
+    # above should prevent; so report them as a problem, not just a count.
+    print("Setpoints: %d, resent: %d" % (len(setpoints), resent))
+    print("Underruns: %d, overruns: %d, corrupt packets: %d" % (
+        underruns, overruns, corrupt))
+    if corrupt or underruns:
+        print("Warning: the stream was not healthy. Corrupt packets mean bytes "
+              "were lost; try a longer tick. Underruns mean setpoints arrived "
+              "too late; try a larger LEAD_TICKS.", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,575 @@
+#include "HitecDHost.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+/* Extra time to wait for a response, beyond HD_READ_MICROS, to allow for USB
+latency. */
+#define HOST_RESPONSE_SLACK_MICROS 20000
+
+/* Most events handled per epoll_wait() call. */
+#define HOST_MAX_EVENTS 64
+
+HitecDHostLoop::HitecDHostLoop() {
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+}
+
+HitecDHostLoop::~HitecDHostLoop() {
+  if (epollFd >= 0) {
+    ::close(epollFd);
+  }
+}
+
+int HitecDHostLoop::add(int fd, HitecDHostHandler *handler) {
+  if (epollFd < 0) {
+    return HITECD_HOST_ERR_IO;
+  }
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = handler;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+    return HITECD_HOST_ERR_IO;
+  }
+  handlers.push_back(handler);
+  return HITECD_OK;
+}
+
+void HitecDHostLoop::remove(int fd, HitecDHostHandler *handler) {
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+  /* poll() may be walking the list right now, so just blank the entry out; it
+  gets cleaned up at the end of poll(). */
+  std::replace(handlers.begin(), handlers.end(),
+    handler, (HitecDHostHandler *)NULL);
+}
+
+void HitecDHostLoop::poll(int timeoutMillis) {
+  HitecDHostClock::time_point now = HitecDHostClock::now();
+  HitecDHostClock::time_point next = HitecDHostClock::time_point::max();
+  for (HitecDHostHandler *h : handlers) {
+    if (h != NULL) {
+      next = std::min(next, h->deadline());
+    }
+  }
+  if (next != HitecDHostClock::time_point::max()) {
+    /* Round up, so we don't wake up just before the deadline. */
+    int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+      next - now).count();
+    int deadlineMillis = (micros <= 0) ? 0 : (int)((micros + 999) / 1000);
+    if (timeoutMillis < 0 || deadlineMillis < timeoutMillis) {
+      timeoutMillis = deadlineMillis;
+    }
+  }
+
+  struct epoll_event events[HOST_MAX_EVENTS];
+  int n = epoll_wait(epollFd, events, HOST_MAX_EVENTS, timeoutMillis);
+  for (int i = 0; i < n; ++i) {
+    HitecDHostHandler *h = (HitecDHostHandler *)events[i].data.ptr;
+    /* Skip handlers removed by an earlier callback in this batch. */
+    if (std::find(handlers.begin(), handlers.end(), h) != handlers.end()) {
+      h->onReadable();
+    }
+  }
+
+  /* Handlers added by a callback are picked up on the next call. */
+  now = HitecDHostClock::now();
+  size_t count = handlers.size();
+  for (size_t i = 0; i < count; ++i) {
+    if (handlers[i] != NULL && handlers[i]->deadline() <= now) {
+      handlers[i]->onDeadline();
+    }
+  }
+
+  handlers.erase(
+    std::remove(handlers.begin(), handlers.end(), (HitecDHostHandler *)NULL),
+    handlers.end());
+}
+
+HitecDHostLine::HitecDHostLine() :
+  responseTimeoutMicros(HD_READ_MICROS + HOST_RESPONSE_SLACK_MICROS),
+  reads(0),
+  writes(0),
+  errors(0),
+  loop(NULL),
+  fd(-1),
+  state(LINE_IDLE),
+  responseLength(0)
+{ }
+
+HitecDHostLine::~HitecDHostLine() {
+  close();
+}
+
+int HitecDHostLine::open(HitecDHostLoop *_loop, const char *path) {
+  close();
+
+  fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    return HITECD_HOST_ERR_IO;
+  }
+
+  /* 115200 baud, 8 data bits, no parity, 1 stop bit, and no processing of the
+  bytes in either direction. */
+  struct termios tio;
+  if (tcgetattr(fd, &tio) < 0) {
+    goto fail;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, B115200);
+  cfsetospeed(&tio, B115200);
+  if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+    goto fail;
+  }
+  tcflush(fd, TCIOFLUSH);
+
+#ifdef __linux__
+  /* Best effort; not every driver supports this. */
+  struct serial_struct serial;
+  if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+    serial.flags |= ASYNC_LOW_LATENCY;
+    ioctl(fd, TIOCSSERIAL, &serial);
+  }
+#endif
+
+  if (_loop->add(fd, this) != HITECD_OK) {
+    goto fail;
+  }
+  loop = _loop;
+  state = LINE_IDLE;
+  responseLength = 0;
+  return HITECD_OK;
+
+fail:
+  int savedErrno = errno;
+  ::close(fd);
+  fd = -1;
+  errno = savedErrno;
+  return HITECD_HOST_ERR_IO;
+}
+
+void HitecDHostLine::close() {
+  if (fd < 0) {
+    return;
+  }
+  loop->remove(fd, this);
+  ::close(fd);
+  fd = -1;
+  loop = NULL;
+  state = LINE_IDLE;
+  queue.clear();
+}
+
+void HitecDHostLine::readRawRegister(uint8_t reg, Callback callback) {
+  Transaction t;
+  t.isWrite = false;
+  t.reg = reg;
+  t.val = 0;
+  t.callback = std::move(callback);
+  enqueue(std::move(t));
+}
+
+void HitecDHostLine::writeRawRegister(
+  uint8_t reg,
+  uint16_t val,
+  Callback callback
+) {
+  Transaction t;
+  t.isWrite = true;
+  t.reg = reg;
+  t.val = val;
+  t.callback = std::move(callback);
+  enqueue(std::move(t));
+}
+
+/* The registers that readSettings() reads, in order. */
+enum {
+  SETTINGS_ID,
+  SETTINGS_DIRECTION,
+  SETTINGS_SPEED,
+  SETTINGS_DEADBAND_1,
+  SETTINGS_DEADBAND_2,
+  SETTINGS_DEADBAND_3,
+  SETTINGS_SOFT_START,
+  SETTINGS_RANGE_LEFT_APV,
+  SETTINGS_RANGE_RIGHT_APV,
+  SETTINGS_RANGE_CENTER_APV,
+  SETTINGS_FAIL_SAFE,
+  SETTINGS_POWER_LIMIT,
+  SETTINGS_OVERLOAD_PROTECTION,
+  SETTINGS_SMART_SENSE_1,
+  SETTINGS_SMART_SENSE_2,
+  SETTINGS_SS_ENABLE_1,
+  SETTINGS_SS_ENABLE_2,
+  SETTINGS_SS_DISABLE_1,
+  SETTINGS_SS_DISABLE_2,
+  SETTINGS_SENSITIVITY_RATIO,
+  SETTINGS_REG_COUNT
+};
+
+static const uint8_t settingsRegs[SETTINGS_REG_COUNT] = {
+  HD_REG_ID,
+  HD_REG_DIRECTION,
+  HD_REG_SPEED,
+  HD_REG_DEADBAND_1,
+  HD_REG_DEADBAND_2,
+  HD_REG_DEADBAND_3,
+  HD_REG_SOFT_START,
+  HD_REG_RANGE_LEFT_APV,
+  HD_REG_RANGE_RIGHT_APV,
+  HD_REG_RANGE_CENTER_APV,
+  HD_REG_FAIL_SAFE,
+  HD_REG_POWER_LIMIT,
+  HD_REG_OVERLOAD_PROTECTION,
+  HD_REG_SMART_SENSE_1,
+  HD_REG_SMART_SENSE_2,
+  HD_REG_SS_ENABLE_1,
+  HD_REG_SS_ENABLE_2,
+  HD_REG_SS_DISABLE_1,
+  HD_REG_SS_DISABLE_2,
+  HD_REG_SENSITIVITY_RATIO,
+};
+
+static int decodeSettings(const uint16_t *vals, HitecDSettings *settingsOut) {
+  int res;
+  if ((res = hitecdDecodeId(vals[SETTINGS_ID], &settingsOut->id)) !=
+      HITECD_OK ||
+    (res = hitecdDecodeDirection(vals[SETTINGS_DIRECTION],
+      &settingsOut->counterclockwise)) != HITECD_OK ||
+    (res = hitecdDecodeSpeed(vals[SETTINGS_SPEED], &settingsOut->speed)) !=
+      HITECD_OK ||
+    (res = hitecdDecodeDeadband(vals[SETTINGS_DEADBAND_1],
+      vals[SETTINGS_DEADBAND_2], vals[SETTINGS_DEADBAND_3],
+      &settingsOut->deadband)) != HITECD_OK ||
+    (res = hitecdDecodeSoftStart(vals[SETTINGS_SOFT_START],
+      &settingsOut->softStart)) != HITECD_OK ||
+    (res = hitecdDecodeFailSafe(vals[SETTINGS_FAIL_SAFE],
+      &settingsOut->failSafe, &settingsOut->failSafeLimp)) != HITECD_OK ||
+    (res = hitecdDecodePowerLimit(vals[SETTINGS_POWER_LIMIT],
+      &settingsOut->powerLimit)) != HITECD_OK ||
+    (res = hitecdDecodeSmartSense(vals[SETTINGS_SMART_SENSE_1],
+      vals[SETTINGS_SMART_SENSE_2], vals[SETTINGS_SS_ENABLE_1],
+      vals[SETTINGS_SS_ENABLE_2], vals[SETTINGS_SS_DISABLE_1],
+      vals[SETTINGS_SS_DISABLE_2], &settingsOut->smartSense)) != HITECD_OK ||
+    (res = hitecdDecodeSensitivityRatio(vals[SETTINGS_SENSITIVITY_RATIO],
+      &settingsOut->sensitivityRatio)) != HITECD_OK) {
+    return res;
+  }
+  settingsOut->rangeLeftAPV = vals[SETTINGS_RANGE_LEFT_APV];
+  settingsOut->rangeRightAPV = vals[SETTINGS_RANGE_RIGHT_APV];
+  settingsOut->rangeCenterAPV = vals[SETTINGS_RANGE_CENTER_APV];
+  settingsOut->overloadProtection = vals[SETTINGS_OVERLOAD_PROTECTION];
+  return HITECD_OK;
+}
+
+struct HitecDHostLine::SettingsRead {
+  uint16_t vals[SETTINGS_REG_COUNT];
+  SettingsCallback callback;
+};
+
+void HitecDHostLine::readSettings(SettingsCallback callback) {
+  std::shared_ptr<SettingsRead> read = std::make_shared<SettingsRead>();
+  read->callback = std::move(callback);
+  readSettingsFrom(read, 0);
+}
+
+/* Each read is queued by the previous one's callback, so a servo that isn't
+there costs one timeout rather than one per register. */
+void HitecDHostLine::readSettingsFrom(
+  std::shared_ptr<SettingsRead> read,
+  int index
+) {
+  readRawRegister(settingsRegs[index],
+    [this, read, index](int res, uint16_t val) {
+      HitecDSettings settings;
+      if (res != HITECD_OK) {
+        read->callback(res, settings);
+        return;
+      }
+      read->vals[index] = val;
+      if (index + 1 < SETTINGS_REG_COUNT) {
+        readSettingsFrom(read, index + 1);
+        return;
+      }
+      res = decodeSettings(read->vals, &settings);
+      read->callback(res, settings);
+    });
+}
+
+void HitecDHostLine::writeSettings(
+  const HitecDSettings &settings,
+  Callback callback
+) {
+  if (settings.smartSense) {
+    writeSettingsWith(settings, 0, 0, std::move(callback));
+    return;
+  }
+
+  /* To disable smartSense, the SMART_SENSE registers are set to magic numbers
+  read from the SS_DISABLE registers, so read those first. */
+  std::shared_ptr<Callback> shared =
+    std::make_shared<Callback>(std::move(callback));
+  readRawRegister(HD_REG_SS_DISABLE_1,
+    [this, settings, shared](int res, uint16_t ssDisable1) {
+      if (res != HITECD_OK) {
+        if (*shared) (*shared)(res, 0);
+        return;
+      }
+      readRawRegister(HD_REG_SS_DISABLE_2,
+        [this, settings, shared, ssDisable1](int res, uint16_t ssDisable2) {
+          if (res != HITECD_OK) {
+            if (*shared) (*shared)(res, 0);
+            return;
+          }
+          writeSettingsWith(settings, ssDisable1, ssDisable2,
+            std::move(*shared));
+        });
+    });
+}
+
+/* The same sequence of writes as HitecDServo::writeSettings(), which explains
+the magic constants. */
+void HitecDHostLine::writeSettingsWith(
+  const HitecDSettings &settings,
+  uint16_t ssDisable1,
+  uint16_t ssDisable2,
+  Callback callback
+) {
+  std::vector<std::pair<uint8_t, uint16_t> > writes;
+  writes.emplace_back(HD_REG_FACTORY_RESET, HD_FACTORY_RESET_CONST);
+  writes.emplace_back(HD_REG_MYSTERY_OP1, HD_MYSTERY_OP1_CONST);
+  writes.emplace_back(HD_REG_MYSTERY_OP2, HD_MYSTERY_OP2_CONST);
+  if (settings.id != HitecDSettings::defaultId) {
+    writes.emplace_back(HD_REG_ID, settings.id);
+  }
+  if (settings.counterclockwise != HitecDSettings::defaultCounterclockwise) {
+    writes.emplace_back(HD_REG_DIRECTION,
+      hitecdEncodeDirection(settings.counterclockwise));
+  }
+  if (settings.speed != HitecDSettings::defaultSpeed) {
+    writes.emplace_back(HD_REG_SPEED, hitecdEncodeSpeed(settings.speed));
+  }
+  if (settings.deadband != HitecDSettings::defaultDeadband) {
+    writes.emplace_back(HD_REG_MYSTERY_DB, HD_MYSTERY_DB_CONST);
+    writes.emplace_back(HD_REG_DEADBAND_1,
+      hitecdEncodeDeadband1(settings.deadband));
+    writes.emplace_back(HD_REG_DEADBAND_2,
+      hitecdEncodeDeadband2(settings.deadband));
+    writes.emplace_back(HD_REG_DEADBAND_3,
+      hitecdEncodeDeadband3(settings.deadband));
+  }
+  if (settings.softStart != HitecDSettings::defaultSoftStart) {
+    writes.emplace_back(HD_REG_SOFT_START,
+      hitecdEncodeSoftStart(settings.softStart));
+  }
+  if (settings.rangeLeftAPV != -1) {
+    writes.emplace_back(HD_REG_RANGE_LEFT_APV, settings.rangeLeftAPV);
+  }
+  if (settings.rangeRightAPV != -1) {
+    writes.emplace_back(HD_REG_RANGE_RIGHT_APV, settings.rangeRightAPV);
+  }
+  if (settings.rangeCenterAPV != -1) {
+    writes.emplace_back(HD_REG_RANGE_CENTER_APV, settings.rangeCenterAPV);
+  }
+  if (settings.failSafe != 0 || settings.failSafeLimp) {
+    writes.emplace_back(HD_REG_FAIL_SAFE,
+      hitecdEncodeFailSafe(settings.failSafe, settings.failSafeLimp));
+  }
+  if (settings.powerLimit != HitecDSettings::defaultPowerLimit) {
+    writes.emplace_back(HD_REG_POWER_LIMIT,
+      hitecdEncodePowerLimit(settings.powerLimit));
+  }
+  if (settings.overloadProtection !=
+      HitecDSettings::defaultOverloadProtection) {
+    writes.emplace_back(HD_REG_OVERLOAD_PROTECTION,
+      settings.overloadProtection);
+  }
+  if (!settings.smartSense) {
+    writes.emplace_back(HD_REG_MYSTERY_DB, HD_MYSTERY_DB_CONST);
+    writes.emplace_back(HD_REG_SMART_SENSE_1, ssDisable1);
+    writes.emplace_back(HD_REG_SMART_SENSE_2, ssDisable2);
+  }
+  if (settings.sensitivityRatio != HitecDSettings::defaultSensitivityRatio) {
+    writes.emplace_back(HD_REG_SENSITIVITY_RATIO, settings.sensitivityRatio);
+  }
+  writes.emplace_back(HD_REG_SAVE, HD_SAVE_CONST);
+  writes.emplace_back(HD_REG_REBOOT, HD_REBOOT_CONST);
+
+  /* Writes only fail if the adapter does, in which case everything after the
+  failure fails the same way; so the first error is the one to report. */
+  std::shared_ptr<int> firstError = std::make_shared<int>(HITECD_OK);
+  for (size_t i = 0; i < writes.size(); ++i) {
+    bool last = (i + 1 == writes.size());
+    writeRawRegister(writes[i].first, writes[i].second,
+      [firstError, last, callback](int res, uint16_t) {
+        if (res != HITECD_OK && *firstError == HITECD_OK) {
+          *firstError = res;
+        }
+        if (last && callback) {
+          callback(*firstError, 0);
+        }
+      });
+  }
+}
+
+bool HitecDHostLine::idle() {
+  return state == LINE_IDLE && queue.empty();
+}
+
+void HitecDHostLine::enqueue(Transaction &&t) {
+  queue.push_back(std::move(t));
+  startNext();
+}
+
+void HitecDHostLine::startNext() {
+  if (state != LINE_IDLE || queue.empty()) {
+    return;
+  }
+  current = std::move(queue.front());
+  queue.pop_front();
+
+  if (fd < 0) {
+    finish(HITECD_HOST_ERR_IO, 0, HitecDHostClock::now());
+    return;
+  }
+
+  uint8_t command[HD_WRITE_COMMAND_LENGTH];
+  int length;
+  if (current.isWrite) {
+    hitecdEncodeWriteCommand(current.reg, current.val, command);
+    length = HD_WRITE_COMMAND_LENGTH;
+  } else {
+    hitecdEncodeReadCommand(current.reg, command);
+    length = HD_READ_COMMAND_LENGTH;
+    /* Drop anything left over from an earlier transaction. */
+    tcflush(fd, TCIFLUSH);
+    responseLength = 0;
+  }
+
+  startTime = HitecDHostClock::now();
+  /* The line is idle, so the output buffer is empty, and the whole command
+  will fit. */
+  if (::write(fd, command, length) != length) {
+    finish(HITECD_HOST_ERR_IO, 0, startTime);
+    return;
+  }
+
+  if (current.isWrite) {
+    state = LINE_WRITING;
+    stateDeadline = startTime + std::chrono::microseconds(HD_WRITE_MICROS);
+  } else {
+    state = LINE_READING;
+    stateDeadline = startTime +
+      std::chrono::microseconds(responseTimeoutMicros);
+  }
+}
+
+void HitecDHostLine::finish(
+  int res,
+  uint16_t val,
+  HitecDHostClock::time_point readyTime
+) {
+  if (res == HITECD_OK) {
+    ++(current.isWrite ? writes : reads);
+  } else {
+    ++errors;
+  }
+
+  if (readyTime > HitecDHostClock::now()) {
+    state = LINE_SETTLING;
+    stateDeadline = readyTime;
+  } else {
+    state = LINE_IDLE;
+  }
+
+  /* The callback may queue another transaction, which would overwrite
+  `current`. */
+  Callback callback = std::move(current.callback);
+  if (callback) {
+    callback(res, val);
+  }
+  startNext();
+}
+
+void HitecDHostLine::onReadable() {
+  uint8_t buf[64];
+  ssize_t n;
+  while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+    for (ssize_t i = 0; i < n; ++i) {
+      if (state == LINE_READING) {
+        receiveByte(buf[i]);
+      }
+    }
+  }
+}
+
+void HitecDHostLine::receiveByte(uint8_t byte) {
+  if (responseLength == 0 && byte != HD_RESPONSE_SYNC) {
+    /* Our own command echoed back, or noise */
+    return;
+  }
+  response[responseLength++] = byte;
+  if (responseLength < HD_RESPONSE_LENGTH) {
+    return;
+  }
+
+  uint16_t val;
+  if (hitecdDecodeResponse(current.reg, response, &val) == HITECD_OK) {
+    responseLength = 0;
+    /* Like the Arduino library, leave the servo the rest of HD_READ_MICROS
+    before the next command. */
+    finish(HITECD_OK, val,
+      startTime + std::chrono::microseconds(HD_READ_MICROS));
+    return;
+  }
+
+  /* That wasn't a response after all. Look for another sync byte in what we
+  have so far, and carry on from there. */
+  int from = 1;
+  while (from < HD_RESPONSE_LENGTH && response[from] != HD_RESPONSE_SYNC) {
+    ++from;
+  }
+  responseLength = HD_RESPONSE_LENGTH - from;
+  for (int i = 0; i < responseLength; ++i) {
+    response[i] = response[from + i];
+  }
+}
+
+HitecDHostClock::time_point HitecDHostLine::deadline() {
+  if (state == LINE_IDLE) {
+    return HitecDHostClock::time_point::max();
+  }
+  return stateDeadline;
+}
+
+void HitecDHostLine::onDeadline() {
+  switch (state) {
+  case LINE_READING:
+    /* If a partial response arrived, the servo is there but garbled it. */
+    finish(
+      (responseLength > 0) ? HITECD_ERR_CORRUPT : HITECD_ERR_NO_SERVO,
+      0, HitecDHostClock::now());
+    break;
+  case LINE_WRITING:
+    finish(HITECD_OK, 0, HitecDHostClock::now());
+    break;
+  case LINE_SETTLING:
+    state = LINE_IDLE;
+    startNext();
+    break;
+  case LINE_IDLE:
+    break;
+  }
+}
@@ -0,0 +1,279 @@
+#ifndef HitecDHost_h
+#define HitecDHost_h
+
+#include <stdint.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "HitecDProtocol.h"
+#include "HitecDServoInternal.h"
+#include "HitecDSettingsCodec.h"
+
+/* Host-side (Linux) library for talking to many servos at once, each through
+its own USB-serial adapter. For example:
+
+    HitecDHostLoop loop;
+    HitecDHostLine lines[2];
+    lines[0].open(&loop, "/dev/ttyUSB0");
+    lines[1].open(&loop, "/dev/ttyUSB1");
+
+    for (int i = 0; i < 2; ++i) {
+      lines[i].readRawRegister(HD_REG_CURRENT_APV,
+        [i](int res, uint16_t apv) {
+          if (res == HITECD_OK) printf("servo %d is at %d\n", i, apv);
+        });
+    }
+    while (!lines[0].idle() || !lines[1].idle()) {
+      loop.poll();
+    }
+
+A read ties up the line for about 18ms (HD_READ_MICROS), most of it waiting for
+the servo's 15.2ms turnaround (see HitecDProtocol.h). The Arduino library waits
+out each read before starting the next one. Here, every file descriptor is
+non-blocking and a single epoll loop waits on all of them, so every line has a
+transaction in flight at the same time. With N adapters, N reads complete every
+18ms, rather than one.
+
+Each line runs one transaction at a time, in the order they were queued. A
+line is only one servo: the protocol has no addressing, so two servos can't
+share a line. Frames are built and checked with the same code as the Arduino
+library (HitecDProtocol.h), and the register map is HitecDServoInternal.h.
+Settings are read and written as a HitecDSettings, encoded the same way as the
+Arduino library encodes them (HitecDSettingsCodec.h), so there's no need to
+deal with the settings registers directly.
+
+The adapter must use inverted polarity (the idle line is low), with TX and RX
+both connected to the servo's signal line, and a pull-up as for the Arduino
+(see README.md). The adapter then receives its own commands as well as the
+servo's responses. The echo is harmless: responses are found by their sync byte
+and checksum, and anything else is dropped. On Linux, the adapter's low-latency
+mode is switched on if the driver supports it; otherwise an FTDI adapter can add
+up to 16ms of latency to each response.
+
+With C++20, HitecDHostLine also has awaitable versions of its methods, for
+use in coroutines:
+
+    HitecDHostTask poll(HitecDHostLine *line) {
+      for (;;) {
+        HitecDHostResult r = co_await line->read(HD_REG_CURRENT_APV);
+        ...
+      }
+    }
+
+To build a program with this library:
+
+    g++ -std=c++17 -O2 -I../../src HitecDHost.cpp main.cpp
+
+See HitecDHostBench.cpp for a complete program, which emulates servos on ptys
+and measures how the throughput scales with the number of lines. */
+
+/* An I/O error on the adapter. */
+#define HITECD_HOST_ERR_IO (-201)
+
+typedef std::chrono::steady_clock HitecDHostClock;
+
+/* Anything that HitecDHostLoop waits on. */
+class HitecDHostHandler {
+public:
+  virtual ~HitecDHostHandler() { }
+
+  /* Called when the handler's file descriptor is readable. */
+  virtual void onReadable() = 0;
+
+  /* The next time the handler needs onDeadline() called, or
+  HitecDHostClock::time_point::max() if there is none. */
+  virtual HitecDHostClock::time_point deadline() = 0;
+  virtual void onDeadline() = 0;
+};
+
+class HitecDHostLoop {
+public:
+  HitecDHostLoop();
+  ~HitecDHostLoop();
+
+  /* Watches `fd` for input, and `handler` for deadlines. Returns HITECD_OK, or
+  HITECD_HOST_ERR_IO with errno set. */
+  int add(int fd, HitecDHostHandler *handler);
+  void remove(int fd, HitecDHostHandler *handler);
+
+  /* Waits until a file descriptor is readable or a deadline passes (but at
+  most `timeoutMillis`, or forever if -1), and calls the handlers. */
+  void poll(int timeoutMillis = -1);
+
+private:
+  int epollFd;
+  std::vector<HitecDHostHandler *> handlers;
+};
+
+/* Result of a transaction, as passed to callbacks and returned by co_await. */
+struct HitecDHostResult {
+  int res;
+  uint16_t val;
+};
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <coroutine>
+#define HITECD_HOST_COROUTINES
+class HitecDHostAwaiter;
+#endif
+
+class HitecDHostLine : public HitecDHostHandler {
+public:
+  /* `res` is HITECD_OK or an error code. `val` is only meaningful for a
+  successful read. */
+  typedef std::function<void(int res, uint16_t val)> Callback;
+
+  /* `settings` is only meaningful if `res` is HITECD_OK. */
+  typedef std::function<void(int res, const HitecDSettings &settings)>
+    SettingsCallback;
+
+  HitecDHostLine();
+  ~HitecDHostLine();
+
+  /* Opens and configures the adapter at `path`, and adds it to `loop`.
+  Returns HITECD_OK, or HITECD_HOST_ERR_IO with errno set. */
+  int open(HitecDHostLoop *loop, const char *path);
+  void close();
+
+  /* Queue a transaction. `callback` is called from HitecDHostLoop::poll() when
+  it completes: for a read, when the response arrives; for a write, once the
+  line is free again. A callback may queue further transactions. If the servo
+  doesn't respond to a read, the result is HITECD_ERR_NO_SERVO. */
+  void readRawRegister(uint8_t reg, Callback callback);
+  void writeRawRegister(uint8_t reg, uint16_t val,
+    Callback callback = Callback());
+
+  /* Read or write all of the servo's settings, like HitecDServo::readSettings()
+  and writeSettings(). Each queues a series of transactions, and calls
+  `callback` when the last one completes, or as soon as one fails.
+
+  writeSettings() resets the servo to factory defaults, writes the settings
+  that differ from them, saves, and reboots the servo. After the callback, the
+  servo takes 1000ms to boot and won't respond until then. Unlike the Arduino
+  library, it doesn't check the servo model (the D485HW is the only one that's
+  known to work); read HD_REG_MODEL_NUMBER first to check. Range settings of -1
+  keep the factory defaults. */
+  void readSettings(SettingsCallback callback);
+  void writeSettings(const HitecDSettings &settings,
+    Callback callback = Callback());
+
+#ifdef HITECD_HOST_COROUTINES
+  HitecDHostAwaiter read(uint8_t reg);
+  HitecDHostAwaiter write(uint8_t reg, uint16_t val);
+#endif
+
+  /* True if nothing is queued or in flight. */
+  bool idle();
+
+  /* How long to wait for a response, measured from when the command was sent.
+  The default allows for some USB latency on top of HD_READ_MICROS. */
+  uint32_t responseTimeoutMicros;
+
+  /* Statistics */
+  uint32_t reads, writes, errors;
+
+  void onReadable() override;
+  HitecDHostClock::time_point deadline() override;
+  void onDeadline() override;
+
+private:
+  struct Transaction {
+    bool isWrite;
+    uint8_t reg;
+    uint16_t val;
+    Callback callback;
+  };
+
+  enum State {
+    /* Nothing in flight */
+    LINE_IDLE,
+    /* A read command was sent; waiting for the response or the timeout */
+    LINE_READING,
+    /* A write command was sent; waiting for the servo to process it */
+    LINE_WRITING,
+    /* A read completed early; waiting for the servo to release the line */
+    LINE_SETTLING
+  };
+
+  struct SettingsRead;
+
+  void enqueue(Transaction &&t);
+  void readSettingsFrom(std::shared_ptr<SettingsRead> read, int index);
+  void writeSettingsWith(const HitecDSettings &settings,
+    uint16_t ssDisable1, uint16_t ssDisable2, Callback callback);
+  void startNext();
+  void finish(int res, uint16_t val, HitecDHostClock::time_point readyTime);
+  void receiveByte(uint8_t byte);
+
+  HitecDHostLoop *loop;
+  int fd;
+  State state;
+  std::deque<Transaction> queue;
+  Transaction current;
+  HitecDHostClock::time_point startTime, stateDeadline;
+
+  /* Partial response */
+  int response[HD_RESPONSE_LENGTH];
+  int responseLength;
+};
+
+#ifdef HITECD_HOST_COROUTINES
+
+class HitecDHostAwaiter {
+public:
+  HitecDHostAwaiter(HitecDHostLine *_line, bool _isWrite, uint8_t _reg,
+      uint16_t _val) :
+    line(_line), isWrite(_isWrite), reg(_reg), val(_val) { }
+
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> handle) {
+    auto callback = [this, handle](int res, uint16_t val) {
+      result.res = res;
+      result.val = val;
+      handle.resume();
+    };
+    if (isWrite) {
+      line->writeRawRegister(reg, val, callback);
+    } else {
+      line->readRawRegister(reg, callback);
+    }
+  }
+  HitecDHostResult await_resume() { return result; }
+
+private:
+  HitecDHostLine *line;
+  bool isWrite;
+  uint8_t reg;
+  uint16_t val;
+  HitecDHostResult result;
+};
+
+inline HitecDHostAwaiter HitecDHostLine::read(uint8_t reg) {
+  return HitecDHostAwaiter(this, false, reg, 0);
+}
+
+inline HitecDHostAwaiter HitecDHostLine::write(uint8_t reg, uint16_t val) {
+  return HitecDHostAwaiter(this, true, reg, val);
+}
+
+/* Return type for a coroutine that runs on its own, driven by
+HitecDHostLoop::poll(). It starts immediately and frees itself when done. */
+struct HitecDHostTask {
+  struct promise_type {
+    HitecDHostTask get_return_object() { return HitecDHostTask(); }
+    std::suspend_never initial_suspend() { return std::suspend_never(); }
+    std::suspend_never final_suspend() noexcept {
+      return std::suspend_never();
+    }
+    void return_void() { }
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+#endif /* HITECD_HOST_COROUTINES */
+
+#endif /* HitecDHost_h */
@@ -0,0 +1,239 @@
+/* Measures how HitecDHost's throughput scales with the number of lines, using
+emulated servos on ptys instead of real adapters.
+
+Usage:
+    HitecDHostBench [NUM_SERVOS] [READS_PER_SERVO]
+
+Build:
+    g++ -std=c++17 -O2 -I../../src HitecDHost.cpp HitecDHostBench.cpp \
+      -o HitecDHostBench
+
+Each emulated servo sits on the master side of a pty. Like the real wire, it
+echoes every byte of each command back to the line, and then answers reads
+15.2ms after the command arrives. Its CURRENT_APV is its own index plus a count
+of writes to TARGET, so every response can be checked. Each line alternates
+between reading and writing TARGET. The reads alternate between CURRENT_APV and
+TARGET. Every other write puts 0x69, the response sync byte, in both bytes of
+its payload, so the echo looks as much like a response as it can. The emulators
+run on the same HitecDHostLoop as the lines. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "HitecDHost.h"
+
+class EmulatedServo : public HitecDHostHandler {
+public:
+  EmulatedServo(int _index) :
+    masterFd(-1),
+    index(_index),
+    commandLength(0),
+    responsePending(false)
+  {
+    for (int i = 0; i < 256; ++i) {
+      regs[i] = 0;
+    }
+    regs[HD_REG_CURRENT_APV] = index;
+  }
+
+  ~EmulatedServo() {
+    if (masterFd >= 0) {
+      close(masterFd);
+    }
+  }
+
+  /* Creates the pty. Returns the path for HitecDHostLine to open, or NULL. */
+  const char *open(HitecDHostLoop *loop) {
+    masterFd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (masterFd < 0 || grantpt(masterFd) < 0 || unlockpt(masterFd) < 0) {
+      return NULL;
+    }
+    if (loop->add(masterFd, this) != HITECD_OK) {
+      return NULL;
+    }
+    return ptsname(masterFd);
+  }
+
+  void onReadable() override {
+    uint8_t buf[64];
+    ssize_t n;
+    while ((n = read(masterFd, buf, sizeof(buf))) > 0) {
+      /* The adapter's TX and RX share the wire, so it hears its own command
+      before any response. */
+      if (write(masterFd, buf, n) != n) {
+        fprintf(stderr, "servo %d: echo failed\n", index);
+      }
+      for (ssize_t i = 0; i < n; ++i) {
+        receiveByte(buf[i]);
+      }
+    }
+  }
+
+  HitecDHostClock::time_point deadline() override {
+    return responsePending ? responseTime : HitecDHostClock::time_point::max();
+  }
+
+  void onDeadline() override {
+    uint16_t val = regs[responseReg];
+    uint8_t response[HD_RESPONSE_LENGTH] = {
+      HD_RESPONSE_SYNC, 0x00, responseReg, 0x02,
+      (uint8_t)(val & 0xFF), (uint8_t)(val >> 8), 0
+    };
+    response[6] = (response[1] + response[2] + response[3] + response[4] +
+      response[5]) & 0xFF;
+    if (write(masterFd, response, HD_RESPONSE_LENGTH) != HD_RESPONSE_LENGTH) {
+      fprintf(stderr, "servo %d: write failed\n", index);
+    }
+    responsePending = false;
+  }
+
+private:
+  void receiveByte(uint8_t byte) {
+    if (commandLength == 0 && byte != HD_COMMAND_SYNC) {
+      return;
+    }
+    command[commandLength++] = byte;
+    if (commandLength == HD_READ_COMMAND_LENGTH && command[3] == 0x00) {
+      uint8_t expected[HD_READ_COMMAND_LENGTH];
+      hitecdEncodeReadCommand(command[2], expected);
+      if (command[4] == expected[4]) {
+        responsePending = true;
+        responseReg = command[2];
+        responseTime = HitecDHostClock::now() +
+          std::chrono::microseconds(HD_TURNAROUND_MICROS);
+      }
+      commandLength = 0;
+    } else if (commandLength == HD_WRITE_COMMAND_LENGTH) {
+      uint16_t val = command[4] + (command[5] << 8);
+      uint8_t expected[HD_WRITE_COMMAND_LENGTH];
+      hitecdEncodeWriteCommand(command[2], val, expected);
+      if (command[6] == expected[6]) {
+        regs[command[2]] = val;
+        if (command[2] == HD_REG_TARGET) {
+          ++regs[HD_REG_CURRENT_APV];
+        }
+      }
+      commandLength = 0;
+    }
+  }
+
+  int masterFd;
+  int index;
+  uint16_t regs[256];
+  uint8_t command[HD_WRITE_COMMAND_LENGTH];
+  int commandLength;
+  bool responsePending;
+  uint8_t responseReg;
+  HitecDHostClock::time_point responseTime;
+};
+
+/* Drives one line: read, write, read, write, ... */
+class Client {
+public:
+  Client(HitecDHostLine *_line, int _index, int _reads) :
+    line(_line),
+    index(_index),
+    readsLeft(_reads),
+    mismatches(0),
+    lastWritten(0)
+  { }
+
+  void start() {
+    read();
+  }
+
+  bool done() {
+    return readsLeft == 0 && line->idle();
+  }
+
+  HitecDHostLine *line;
+  int index;
+  int readsLeft;
+  int mismatches;
+
+private:
+  void read() {
+    bool checkTarget = (line->writes % 2 == 1);
+    uint8_t reg = checkTarget ? HD_REG_TARGET : HD_REG_CURRENT_APV;
+    line->readRawRegister(reg, [this, checkTarget](int res, uint16_t val) {
+      /* Each completed write bumps the emulated APV by one. */
+      uint16_t expected = checkTarget ? lastWritten : index + line->writes;
+      if (res != HITECD_OK || val != expected) {
+        ++mismatches;
+      }
+      if (--readsLeft > 0) {
+        lastWritten = (line->writes % 2 == 0) ? 0x6969 : 3000;
+        line->writeRawRegister(HD_REG_TARGET, lastWritten,
+          [this](int, uint16_t) {
+            read();
+          });
+      }
+    });
+  }
+
+  uint16_t lastWritten;
+};
+
+int main(int argc, char **argv) {
+  int numServos = (argc > 1) ? atoi(argv[1]) : 32;
+  int readsPerServo = (argc > 2) ? atoi(argv[2]) : 50;
+
+  HitecDHostLoop loop;
+  std::vector<std::unique_ptr<EmulatedServo>> servos;
+  std::vector<std::unique_ptr<HitecDHostLine>> lines;
+  std::vector<std::unique_ptr<Client>> clients;
+
+  for (int i = 0; i < numServos; ++i) {
+    servos.emplace_back(new EmulatedServo(i));
+    const char *path = servos.back()->open(&loop);
+    if (path == NULL) {
+      perror("posix_openpt");
+      return 1;
+    }
+    lines.emplace_back(new HitecDHostLine());
+    if (lines.back()->open(&loop, path) != HITECD_OK) {
+      perror(path);
+      return 1;
+    }
+    clients.emplace_back(new Client(lines.back().get(), i, readsPerServo));
+  }
+
+  HitecDHostClock::time_point start = HitecDHostClock::now();
+  for (auto &client : clients) {
+    client->start();
+  }
+  for (;;) {
+    bool allDone = true;
+    for (auto &client : clients) {
+      allDone = allDone && client->done();
+    }
+    if (allDone) {
+      break;
+    }
+    loop.poll();
+  }
+  double seconds = std::chrono::duration<double>(
+    HitecDHostClock::now() - start).count();
+
+  uint32_t reads = 0, writes = 0, errors = 0;
+  int mismatches = 0;
+  for (int i = 0; i < numServos; ++i) {
+    reads += lines[i]->reads;
+    writes += lines[i]->writes;
+    errors += lines[i]->errors;
+    mismatches += clients[i]->mismatches;
+  }
+  /* What the same transactions would take one at a time, as on the Arduino */
+  double serialSeconds =
+    (reads * (double)HD_READ_MICROS + writes * (double)HD_WRITE_MICROS) / 1e6;
+
+  printf("%d servos: %u reads, %u writes, %u errors, %d bad values\n",
+    numServos, reads, writes, errors, mismatches);
+  printf("%.2fs (%.0f reads/s); one at a time would take %.2fs (%.1fx)\n",
+    seconds, reads / seconds, serialSeconds, serialSeconds / seconds);
+  return (errors == 0 && mismatches == 0) ? 0 : 1;
+}
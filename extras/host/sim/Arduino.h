@@ -0,0 +1,133 @@
+#ifndef HitecDSimArduino_h
+#define HitecDSimArduino_h
+
+/* A stand-in for <Arduino.h>, so that the library and sketches can run on a PC
+against simulated servos and a simulated clock. Only the parts of the Arduino
+API that this repository uses are here. See HitecDSim.h for how the simulation
+behaves. */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Tells HitecDServo.cpp to hand each byte to the simulated servo on the pin,
+instead of bit-banging it. */
+#define HITECD_HOST_SIM
+
+#define F_CPU 16000000UL
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define DEC 10
+#define HEX 16
+
+#define NUM_DIGITAL_PINS 20
+#define PIN_A0 14
+#define NUM_ANALOG_INPUTS 6
+
+#define PROGMEM
+typedef const char *PGM_P;
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define memcpy_P memcpy
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+/* Interrupts don't exist in the simulation. */
+extern uint8_t SREG;
+inline void cli() { }
+inline void sei() { }
+
+template<class T, class L, class H>
+inline T constrain(T x, L lo, H hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+template<class A, class B>
+inline A min(A a, B b) { return a < b ? a : (A)b; }
+template<class A, class B>
+inline A max(A a, B b) { return a > b ? a : (A)b; }
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+/* The simulated clock. Time only passes when the program waits, when bytes go
+over a simulated line, and by 1us on every call to millis() or micros(), so
+that polling loops terminate. */
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/* Simulated pins. Each port register covers a single pin, so the bit mask is
+always 1. */
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+extern volatile uint8_t hitecdSimPinInput[NUM_DIGITAL_PINS];
+extern volatile uint8_t hitecdSimPinOutput[NUM_DIGITAL_PINS];
+extern volatile uint8_t hitecdSimPinMode[NUM_DIGITAL_PINS];
+#define digitalPinToBitMask(pin) ((uint8_t)1)
+#define digitalPinToPort(pin) (pin)
+#define portInputRegister(port) (&hitecdSimPinInput[port])
+#define portOutputRegister(port) (&hitecdSimPinOutput[port])
+#define portModeRegister(port) (&hitecdSimPinMode[port])
+
+/* What HitecDServo.cpp calls in place of its bit-banged UART. */
+int hitecdSimReadByte(int pin);
+void hitecdSimWriteByte(int pin, uint8_t val);
+
+class Print {
+public:
+  virtual ~Print() { }
+  virtual size_t write(uint8_t c) = 0;
+  size_t write(const uint8_t *buf, size_t n);
+  size_t write(const char *buf, size_t n) {
+    return write((const uint8_t *)buf, n);
+  }
+
+  size_t print(const __FlashStringHelper *s);
+  size_t print(const char *s);
+  size_t print(char c);
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = DEC) {
+    return print((unsigned long)n, base);
+  }
+  size_t print(unsigned char n, int base = DEC) {
+    return print((unsigned long)n, base);
+  }
+  size_t print(double n, int digits = 2);
+
+  size_t println();
+  template<class T> size_t println(T x) { return print(x) + println(); }
+  template<class T> size_t println(T x, int base) {
+    return print(x, base) + println();
+  }
+};
+
+/* The sketch's serial port. Input comes from a script (see HitecDSim.h), and
+output goes to a callback. */
+class HitecDSimSerial : public Print {
+public:
+  void begin(unsigned long) { }
+  int available();
+  int peek();
+  int read();
+  void flush() { }
+  size_t write(uint8_t c) override;
+  using Print::write;
+  operator bool() { return true; }
+};
+extern HitecDSimSerial Serial;
+
+#endif /* HitecDSimArduino_h */
@@ -0,0 +1,239 @@
+/* Times the Programmer sketch's commands against a simulated servo, and shows
+where the time goes in each one. This runs the sketch's own code (setup(),
+loop(), and the command handlers), so it measures what a user at the Serial
+Monitor waits for, without putting a real servo through factory resets and
+range detection.
+
+Build and run:
+
+    g++ -std=c++11 -I. -I../../../src -I../../../examples/Programmer \
+      HitecDSim.cpp ../../../src/HitecDServo.cpp ../../../src/HitecDRTOS.cpp \
+      ../../../src/HitecDOdometer.cpp ../../../examples/Programmer/[A-Z]*.cpp \
+      HitecDProgrammerBench.cpp -o HitecDProgrammerBench
+    ./HitecDProgrammerBench [-v]
+
+With -v, the sketch's output is shown as well.
+
+Each step is a command typed at the prompt, along with the answers to its
+questions. A step starts when its first line is typed, and ends when the sketch
+asks for the next command. For each step, the table shows:
+- Total: all simulated time that passed.
+- Bus: time spent inside register reads and writes, apart from verification
+  reads. This is the part that a faster bus protocol could shrink.
+- Verify: time spent on verification reads, i.e. reads of settings registers
+  after the servo has rebooted in the same step, to check what it saved.
+- Delay: time spent in delay() outside of register reads and writes, mostly
+  waiting for the servo to boot or to finish moving.
+- Reboots, and the number of reads (verification reads separately) and writes.
+Whatever is left of the total is the sketch's own polling. Times are
+repeatable, because they come from the simulated clock (see HitecDSim.h).
+
+Exits with status 1 if the sketch printed an error during any step. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "HitecDServoInternal.h"
+#include "HitecDSim.h"
+
+/* Arduino generates prototypes for a sketch's functions; here we need the one
+function that Programmer.ino uses before defining it. */
+void printHelp();
+#include "Programmer.ino"
+
+#define SERVO_PIN 2
+
+struct BenchStep {
+  const char *name;
+  std::vector<std::string> lines;
+};
+
+/* The commands to time. "connect" is the startup prompts: the pin, and then
+nothing to say there are no more servos. */
+static const BenchStep benchSteps[] = {
+  {"connect", {"2", ""}},
+  {"show", {"show"}},
+  {"change speed", {"speed", "50"}},
+  {"reset", {"reset", "y"}},
+  {"detect range", {"range", "detect", "y", "y"}},
+  {"default range", {"range", "default", "y"}},
+};
+#define NUM_BENCH_STEPS (int)(sizeof(benchSteps) / sizeof(benchSteps[0]))
+
+static bool isSettingsRegister(uint8_t reg) {
+  switch (reg) {
+    case HD_REG_ID:
+    case HD_REG_DIRECTION:
+    case HD_REG_SPEED:
+    case HD_REG_DEADBAND_1:
+    case HD_REG_DEADBAND_2:
+    case HD_REG_DEADBAND_3:
+    case HD_REG_SOFT_START:
+    case HD_REG_RANGE_LEFT_APV:
+    case HD_REG_RANGE_RIGHT_APV:
+    case HD_REG_RANGE_CENTER_APV:
+    case HD_REG_FAIL_SAFE:
+    case HD_REG_POWER_LIMIT:
+    case HD_REG_OVERLOAD_PROTECTION:
+    case HD_REG_SMART_SENSE_1:
+    case HD_REG_SMART_SENSE_2:
+    case HD_REG_SS_ENABLE_1:
+    case HD_REG_SS_ENABLE_2:
+    case HD_REG_SS_DISABLE_1:
+    case HD_REG_SS_DISABLE_2:
+    case HD_REG_SENSITIVITY_RATIO:
+      return true;
+    default:
+      return false;
+  }
+}
+
+struct StepResult {
+  uint64_t totalMicros, busMicros, verifyMicros, delayMicros;
+  unsigned long reboots, reads, verifyReads, writes;
+  bool printedError;
+};
+
+/* Sorts the time spent in each register operation into bus time and
+verification time, and keeps delays inside register operations (e.g. the 1ms
+after each write) out of the step's forced delays. */
+class StepTimer : public HitecDListener {
+public:
+  StepResult *step;
+  bool rebooted;
+
+  /* Time spent in delays inside register operations, which doesn't count
+  toward the step's forced delays. */
+  uint64_t opDelayedMicros;
+
+  void onBeforeRegister(HitecDServo *, uint8_t) override {
+    startMicros = hitecdSimNowMicros();
+    startDelayedMicros = hitecdSimDelayedMicros();
+  }
+
+  void onReadRegister(HitecDServo *, uint8_t reg, int, uint16_t) override {
+    if (rebooted && isSettingsRegister(reg)) {
+      step->verifyMicros += finishOp();
+      ++step->verifyReads;
+    } else {
+      step->busMicros += finishOp();
+    }
+    ++step->reads;
+  }
+
+  void onWriteRegister(HitecDServo *, uint8_t reg, uint16_t) override {
+    step->busMicros += finishOp();
+    ++step->writes;
+    if (reg == HD_REG_REBOOT) {
+      rebooted = true;
+    }
+  }
+
+private:
+  uint64_t finishOp() {
+    opDelayedMicros += hitecdSimDelayedMicros() - startDelayedMicros;
+    return hitecdSimNowMicros() - startMicros;
+  }
+
+  uint64_t startMicros, startDelayedMicros;
+};
+
+static HitecDSimServo simServo;
+static StepTimer stepTimer;
+static StepResult results[NUM_BENCH_STEPS];
+static int currentStep = -1;
+static std::vector<size_t> stepFirstLines;
+static uint64_t stepStartMicros, stepStartDelayedMicros;
+static unsigned long stepStartReboots;
+static std::string stepOutput;
+static bool verbose = false;
+
+static void endStep() {
+  if (currentStep < 0) {
+    return;
+  }
+  StepResult &r = results[currentStep];
+  r.totalMicros = hitecdSimNowMicros() - stepStartMicros;
+  r.delayMicros = hitecdSimDelayedMicros() - stepStartDelayedMicros -
+    stepTimer.opDelayedMicros;
+  r.reboots = simServo.stats.reboots - stepStartReboots;
+  r.printedError = (stepOutput.find("Error: ") != std::string::npos);
+}
+
+static void beginStep(int index) {
+  currentStep = index;
+  StepResult &r = results[index];
+  memset(&r, 0, sizeof(r));
+  stepTimer.step = &r;
+  stepTimer.rebooted = false;
+  stepTimer.opDelayedMicros = 0;
+  stepStartMicros = hitecdSimNowMicros();
+  stepStartDelayedMicros = hitecdSimDelayedMicros();
+  stepStartReboots = simServo.stats.reboots;
+  stepOutput.clear();
+}
+
+static void onInputLine(size_t index) {
+  for (int i = 0; i < NUM_BENCH_STEPS; ++i) {
+    if (stepFirstLines[i] == index) {
+      endStep();
+      beginStep(i);
+    }
+  }
+}
+
+static void onOutput(uint8_t c) {
+  stepOutput += (char)c;
+  if (verbose) {
+    putchar(c);
+  }
+}
+
+static double millisOf(uint64_t micros) {
+  return micros / 1000.0;
+}
+
+static void onEndOfInput() {
+  endStep();
+  printf("%-14s %9s %8s %8s %9s %8s %6s %7s %7s\n",
+    "Step", "Total ms", "Bus ms", "Verify", "Delay ms", "Reboots",
+    "Reads", "Verify", "Writes");
+  bool ok = true;
+  for (int i = 0; i < NUM_BENCH_STEPS; ++i) {
+    const StepResult &r = results[i];
+    printf("%-14s %9.1f %8.1f %8.1f %9.1f %8lu %6lu %7lu %7lu%s\n",
+      benchSteps[i].name, millisOf(r.totalMicros), millisOf(r.busMicros),
+      millisOf(r.verifyMicros), millisOf(r.delayMicros), r.reboots,
+      r.reads - r.verifyReads, r.verifyReads, r.writes,
+      r.printedError ? "  (printed an error)" : "");
+    ok = ok && !r.printedError;
+  }
+  fflush(stdout);
+  exit(ok ? 0 : 1);
+}
+
+int main(int argc, char **argv) {
+  verbose = (argc > 1 && strcmp(argv[1], "-v") == 0);
+
+  std::vector<std::string> lines;
+  for (int i = 0; i < NUM_BENCH_STEPS; ++i) {
+    stepFirstLines.push_back(lines.size());
+    lines.insert(lines.end(),
+      benchSteps[i].lines.begin(), benchSteps[i].lines.end());
+  }
+  hitecdSimSetInput(lines);
+  hitecdSimOnInputLine = onInputLine;
+  hitecdSimOnOutput = onOutput;
+  hitecdSimOnEndOfInput = onEndOfInput;
+
+  simServo.plugInto(SERVO_PIN);
+  sessions[0].servo.addListener(&stepTimer);
+
+  setup();
+  while (true) {
+    loop();
+  }
+}
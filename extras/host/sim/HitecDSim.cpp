@@ -0,0 +1,485 @@
+#include "HitecDSim.h"
+
+#include <avr/eeprom.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "HitecDServoInternal.h"
+
+/* How long a booting servo holds the line low. */
+#define BOOT_MICROS 1000000UL
+
+/* How long readByte() waits for a start bit before giving up. */
+#define READ_BYTE_TIMEOUT_MICROS 10000UL
+
+/* A response that nobody reads is over once it has gone by on the wire. */
+#define RESPONSE_WINDOW_MICROS \
+  (HD_TURNAROUND_MICROS + HD_RESPONSE_LENGTH * HD_BYTE_MICROS + 1000)
+
+uint8_t SREG;
+
+volatile uint8_t hitecdSimPinInput[NUM_DIGITAL_PINS];
+volatile uint8_t hitecdSimPinOutput[NUM_DIGITAL_PINS];
+volatile uint8_t hitecdSimPinMode[NUM_DIGITAL_PINS];
+
+HitecDSimSerial Serial;
+
+static std::atomic<uint64_t> nowMicros(0);
+static std::atomic<uint64_t> delayedMicros(0);
+
+/* Serializes access to the servo models and pins, in case the program runs
+several threads (see rtos/). This is what the simulation needs to stay
+consistent; it doesn't stand in for the library's own locking, which is what
+keeps one task's frames from landing in the middle of another's. */
+static std::recursive_mutex simMutex;
+
+static HitecDSimServo *servoOnPin[NUM_DIGITAL_PINS];
+
+static void advanceMicros(uint64_t us) {
+  nowMicros += us;
+}
+
+uint64_t hitecdSimNowMicros() {
+  return nowMicros;
+}
+
+unsigned long millis() {
+  return (unsigned long)((nowMicros += 1) / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)(nowMicros += 1);
+}
+
+uint64_t hitecdSimDelayedMicros() {
+  return delayedMicros;
+}
+
+void delay(unsigned long ms) {
+  delayedMicros += 1000 * (uint64_t)ms;
+  advanceMicros(1000 * (uint64_t)ms);
+}
+
+void delayMicroseconds(unsigned int us) {
+  delayedMicros += us;
+  advanceMicros(us);
+}
+
+/* Works out what the pin reads. The board is assumed to have a proper pullup,
+so the released line is high unless the servo is driving it low. */
+static uint8_t lineLevel(uint8_t pin) {
+  if (hitecdSimPinMode[pin] == OUTPUT) {
+    return hitecdSimPinOutput[pin];
+  }
+  HitecDSimServo *servo = servoOnPin[pin];
+  if (servo != NULL && servo->drivingLineLow()) {
+    return LOW;
+  }
+  return HIGH;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  std::lock_guard<std::recursive_mutex> lock(simMutex);
+  hitecdSimPinMode[pin] = (mode == OUTPUT) ? OUTPUT : INPUT;
+  hitecdSimPinInput[pin] = lineLevel(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  std::lock_guard<std::recursive_mutex> lock(simMutex);
+  hitecdSimPinOutput[pin] = val ? HIGH : LOW;
+  hitecdSimPinInput[pin] = lineLevel(pin);
+}
+
+int digitalRead(uint8_t pin) {
+  std::lock_guard<std::recursive_mutex> lock(simMutex);
+  hitecdSimPinInput[pin] = lineLevel(pin);
+  return hitecdSimPinInput[pin];
+}
+
+/* A 1k pullup against the servo's 3k pulldown; or, while the servo drives the
+line, nearly 0V. */
+int analogRead(uint8_t pin) {
+  std::lock_guard<std::recursive_mutex> lock(simMutex);
+  HitecDSimServo *servo = servoOnPin[pin];
+  if (servo == NULL) {
+    return 1023;
+  }
+  return servo->drivingLineLow() ? 5 : 1023 * 3 / 4;
+}
+
+int hitecdSimReadByte(int pin) {
+  std::lock_guard<std::recursive_mutex> lock(simMutex);
+  HitecDSimServo *servo = servoOnPin[pin];
+  int val = (servo != NULL) ? servo->sendByte() : -1;
+  if (val < 0) {
+    advanceMicros(READ_BYTE_TIMEOUT_MICROS);
+    return HITECD_ERR_NO_SERVO;
+  }
+  advanceMicros(HD_BYTE_MICROS);
+  return val;
+}
+
+void hitecdSimWriteByte(int pin, uint8_t val) {
+  std::lock_guard<std::recursive_mutex> lock(simMutex);
+  advanceMicros(HD_BYTE_MICROS);
+  HitecDSimServo *servo = servoOnPin[pin];
+  if (servo != NULL) {
+    servo->receiveByte(val);
+  }
+}
+
+HitecDSimServo::HitecDSimServo(int modelNumber) :
+  commandLength(0),
+  responseIndex(HD_RESPONSE_LENGTH),
+  responseDeadline(0),
+  bootedAt(0),
+  positionAPV(8192),
+  targetAPV(8192),
+  positionUpdatedAt(0)
+{
+  memset(&stats, 0, sizeof(stats));
+  memset(factory, 0, sizeof(factory));
+
+  factory[HD_REG_MODEL_NUMBER] = modelNumber;
+  factory[0x04] = 36;
+  factory[HD_REG_DATE_CODE] = 19135;
+  factory[0xC4] = 1300;
+
+  factory[HD_REG_ID] = 0;
+  factory[HD_REG_DIRECTION] = HD_DIRECTION_CLOCKWISE;
+  factory[HD_REG_SPEED] = 0x0FFF;
+  factory[HD_REG_DEADBAND_1] = 1;
+  factory[HD_REG_DEADBAND_2] = 5;
+  factory[HD_REG_DEADBAND_3] = 11;
+  factory[HD_REG_SOFT_START] = HD_SOFT_START_20;
+  factory[HD_REG_RANGE_LEFT_APV] = 3381;
+  factory[HD_REG_RANGE_RIGHT_APV] = 13002;
+  factory[HD_REG_RANGE_CENTER_APV] = 8192;
+  factory[HD_REG_FAIL_SAFE] = HD_FAIL_SAFE_OFF;
+  factory[HD_REG_POWER_LIMIT] = 0x0FFF;
+  factory[HD_REG_OVERLOAD_PROTECTION] = 100;
+  factory[HD_REG_SMART_SENSE_1] = HD_SS_ENABLE_1_CONST;
+  factory[HD_REG_SMART_SENSE_2] = HD_SS_ENABLE_2_CONST;
+  factory[HD_REG_SS_ENABLE_1] = HD_SS_ENABLE_1_CONST;
+  factory[HD_REG_SS_ENABLE_2] = HD_SS_ENABLE_2_CONST;
+  factory[HD_REG_SS_DISABLE_1] = HD_SS_DISABLE_1_CONST;
+  factory[HD_REG_SS_DISABLE_2] = HD_SS_DISABLE_2_CONST;
+  factory[HD_REG_SENSITIVITY_RATIO] = HD_SENSITIVITY_RATIO_MAX;
+
+  memcpy(live, factory, sizeof(live));
+  memcpy(saved, factory, sizeof(saved));
+}
+
+void HitecDSimServo::plugInto(int pin) {
+  std::lock_guard<std::recursive_mutex> lock(simMutex);
+  servoOnPin[pin] = this;
+}
+
+void HitecDSimServo::poke(uint8_t reg, uint16_t val) {
+  std::lock_guard<std::recursive_mutex> lock(simMutex);
+  live[reg] = val;
+}
+
+uint16_t HitecDSimServo::peek(uint8_t reg) {
+  std::lock_guard<std::recursive_mutex> lock(simMutex);
+  if (reg == HD_REG_CURRENT_APV) {
+    updatePosition();
+    return positionAPV;
+  }
+  if (reg == HD_REG_TARGET) {
+    return targetAPV;
+  }
+  if (reg == HD_REG_EFFECTIVE_POWER_LIMIT) {
+    return min(live[HD_REG_POWER_LIMIT], (uint16_t)HD_POWER_LIMIT_MAX);
+  }
+  return live[reg];
+}
+
+bool HitecDSimServo::drivingLineLow() {
+  uint64_t now = hitecdSimNowMicros();
+  if (now < bootedAt) {
+    return true;
+  }
+  return responseIndex < HD_RESPONSE_LENGTH && now < responseDeadline;
+}
+
+void HitecDSimServo::receiveByte(uint8_t val) {
+  uint64_t now = hitecdSimNowMicros();
+  if (now < bootedAt) {
+    /* The servo isn't listening, so just count the frames. */
+    if (val == HD_COMMAND_SYNC) {
+      ++stats.commandsWhileBooting;
+    }
+    commandLength = 0;
+    return;
+  }
+  if (responseIndex < HD_RESPONSE_LENGTH && now < responseDeadline) {
+    ++stats.collisions;
+    responseIndex = HD_RESPONSE_LENGTH;
+  }
+
+  command[commandLength++] = val;
+  if (command[0] != HD_COMMAND_SYNC) {
+    ++stats.corruptCommands;
+    commandLength = 0;
+    return;
+  }
+  if (commandLength < 4) {
+    return;
+  }
+  int expectedLength;
+  if (command[3] == 0x00) {
+    expectedLength = HD_READ_COMMAND_LENGTH;
+  } else if (command[3] == 0x02) {
+    expectedLength = HD_WRITE_COMMAND_LENGTH;
+  } else {
+    ++stats.corruptCommands;
+    commandLength = 0;
+    return;
+  }
+  if (commandLength == expectedLength) {
+    runCommand();
+    commandLength = 0;
+  }
+}
+
+int HitecDSimServo::sendByte() {
+  if (!drivingLineLow() || hitecdSimNowMicros() < bootedAt) {
+    return -1;
+  }
+  return response[responseIndex++];
+}
+
+void HitecDSimServo::runCommand() {
+  uint8_t reg = command[2];
+  if (command[3] == 0x00) {
+    if (command[4] != ((command[1] + command[2] + command[3]) & 0xFF)) {
+      ++stats.corruptCommands;
+      return;
+    }
+    ++stats.reads;
+    uint16_t val = peek(reg);
+    response[0] = HD_RESPONSE_SYNC;
+    response[1] = 0x00;
+    response[2] = reg;
+    response[3] = 0x02;
+    response[4] = val & 0xFF;
+    response[5] = val >> 8;
+    response[6] = (response[1] + response[2] + response[3] + response[4]
+      + response[5]) & 0xFF;
+    responseIndex = 0;
+    responseDeadline = hitecdSimNowMicros() + RESPONSE_WINDOW_MICROS;
+    return;
+  }
+
+  if (command[6] != ((command[1] + command[2] + command[3] + command[4]
+      + command[5]) & 0xFF)) {
+    ++stats.corruptCommands;
+    return;
+  }
+  ++stats.writes;
+  uint16_t val = command[4] + (command[5] << 8);
+  switch (reg) {
+    case HD_REG_REBOOT:
+      if (val == HD_REBOOT_CONST) {
+        ++stats.reboots;
+        memcpy(live, saved, sizeof(live));
+        updatePosition();
+        targetAPV = positionAPV;
+        bootedAt = hitecdSimNowMicros() + BOOT_MICROS;
+      }
+      break;
+    case HD_REG_SAVE:
+      if (val == HD_SAVE_CONST) {
+        ++stats.saves;
+        memcpy(saved, live, sizeof(saved));
+      }
+      break;
+    case HD_REG_FACTORY_RESET:
+      if (val == HD_FACTORY_RESET_CONST) {
+        ++stats.factoryResets;
+        memcpy(live, factory, sizeof(live));
+      }
+      break;
+    case HD_REG_TARGET: {
+      updatePosition();
+      int32_t quarterMicros = (int16_t)val + 3000;
+      int32_t apv;
+      if (quarterMicros < 4 * 1500) {
+        apv = map(quarterMicros, 4 * 850, 4 * 1500,
+          live[HD_REG_RANGE_LEFT_APV], live[HD_REG_RANGE_CENTER_APV]);
+      } else {
+        apv = map(quarterMicros, 4 * 1500, 4 * 2150,
+          live[HD_REG_RANGE_CENTER_APV], live[HD_REG_RANGE_RIGHT_APV]);
+      }
+      targetAPV = constrain(apv,
+        HITECD_SIM_END_STOP_LEFT_APV, HITECD_SIM_END_STOP_RIGHT_APV);
+      break;
+    }
+    case HD_REG_MODEL_NUMBER:
+    case HD_REG_CURRENT_APV:
+    case HD_REG_SS_ENABLE_1:
+    case HD_REG_SS_ENABLE_2:
+    case HD_REG_SS_DISABLE_1:
+    case HD_REG_SS_DISABLE_2:
+    case HD_REG_EFFECTIVE_POWER_LIMIT:
+      /* Read-only */
+      break;
+    default:
+      live[reg] = val;
+      break;
+  }
+}
+
+void HitecDSimServo::updatePosition() {
+  uint64_t now = hitecdSimNowMicros();
+  int32_t rate = HITECD_SIM_APV_PER_MILLI;
+  if (live[HD_REG_SPEED] != 0x0FFF) {
+    rate = max(rate * live[HD_REG_SPEED] * 5 / 100, (int32_t)1);
+  }
+  int64_t step = (int64_t)(now - positionUpdatedAt) * rate / 1000;
+  positionUpdatedAt = now;
+  if (targetAPV > positionAPV) {
+    positionAPV = (int32_t)min((int64_t)targetAPV, positionAPV + step);
+  } else {
+    positionAPV = (int32_t)max((int64_t)targetAPV, positionAPV - step);
+  }
+}
+
+/* The simulated EEPROM. Addresses are offsets into it, passed as pointers. */
+
+static uint8_t eeprom[E2END + 1];
+static bool eepromErased = false;
+
+static void eraseEEPROMOnce() {
+  if (!eepromErased) {
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    eepromErased = true;
+  }
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+  eraseEEPROMOnce();
+  memcpy(dst, eeprom + (uintptr_t)src, n);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+  eraseEEPROMOnce();
+  memcpy(eeprom + (uintptr_t)dst, src, n);
+}
+
+/* The simulated serial port */
+
+static std::vector<std::string> inputLines;
+static size_t nextInputLine = 0;
+static std::string inputBuffer;
+static bool inputPolledEmpty = false;
+
+static void exitAtEndOfInput() {
+  fflush(stdout);
+  exit(0);
+}
+
+static void writeToStdout(uint8_t c) {
+  putchar(c);
+}
+
+static void ignoreInputLine(size_t) { }
+
+void (*hitecdSimOnEndOfInput)() = exitAtEndOfInput;
+void (*hitecdSimOnOutput)(uint8_t c) = writeToStdout;
+void (*hitecdSimOnInputLine)(size_t index) = ignoreInputLine;
+
+void hitecdSimSetInput(const std::vector<std::string> &lines) {
+  inputLines = lines;
+  nextInputLine = 0;
+  inputBuffer.clear();
+  inputPolledEmpty = false;
+}
+
+int HitecDSimSerial::available() {
+  if (inputBuffer.empty()) {
+    if (!inputPolledEmpty) {
+      inputPolledEmpty = true;
+      return 0;
+    }
+    if (nextInputLine == inputLines.size()) {
+      hitecdSimOnEndOfInput();
+      return 0;
+    }
+    hitecdSimOnInputLine(nextInputLine);
+    inputBuffer = inputLines[nextInputLine++] + "\n";
+    inputPolledEmpty = false;
+  }
+  return inputBuffer.size();
+}
+
+int HitecDSimSerial::peek() {
+  return inputBuffer.empty() ? -1 : (uint8_t)inputBuffer[0];
+}
+
+int HitecDSimSerial::read() {
+  if (inputBuffer.empty()) {
+    return -1;
+  }
+  uint8_t c = inputBuffer[0];
+  inputBuffer.erase(0, 1);
+  return c;
+}
+
+size_t HitecDSimSerial::write(uint8_t c) {
+  hitecdSimOnOutput(c);
+  return 1;
+}
+
+/* Print */
+
+size_t Print::write(const uint8_t *buf, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    write(buf[i]);
+  }
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *s) {
+  return print(reinterpret_cast<const char *>(s));
+}
+
+size_t Print::print(const char *s) {
+  return write(s, strlen(s));
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(long n, int base) {
+  if (n < 0 && base == DEC) {
+    return print('-') + print((unsigned long)-n, base);
+  }
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+  *p = '\0';
+  do {
+    int digit = n % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    n /= base;
+  } while (n != 0);
+  return print(p);
+}
+
+size_t Print::print(double n, int digits) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return print(buf);
+}
+
+size_t Print::println() {
+  return print("\r\n");
+}
@@ -0,0 +1,130 @@
+#ifndef HitecDSim_h
+#define HitecDSim_h
+
+#include <Arduino.h>
+
+#include <string>
+#include <vector>
+
+#include "HitecDProtocol.h"
+
+/* Runs the Arduino library on a PC, against simulated servos and a simulated
+clock. Compile the library's sources and the program with this directory first
+on the include path, so that <Arduino.h> resolves to the stand-in here:
+
+    g++ -std=c++11 -I. -I../../../src HitecDSim.cpp \
+      ../../../src/HitecDServo.cpp ../../../src/HitecDRTOS.cpp main.cpp
+
+(The stand-in <avr/eeprom.h> here gives HitecDOdometer.cpp a simulated EEPROM,
+so the Programmer sketch runs too; see HitecDProgrammerBench.cpp.)
+
+HitecDServo.cpp hands each byte to the HitecDSimServo plugged into the pin,
+rather than bit-banging it. The servo model speaks the protocol at the frame
+level: it checks every command's sync byte and checksum; answers reads; and
+keeps the settings in "live" registers, a saved copy (its EEPROM), and a factory
+copy, the same way a D485HW does. A REBOOT copies the saved registers back to
+the live ones, and the servo holds the line low for 1000ms while it boots.
+TARGET moves CURRENT_APV toward the target at a fixed rate, stopping at the
+physical end-stops.
+
+Time only passes when the program waits (delay(), the byte times on the line,
+and the 1us that each call to millis() or micros() costs), so results are
+repeatable and don't depend on how fast the PC is. */
+
+/* The physical end-stops of the simulated servo, in APV. (The D485HW's widest
+range is 50 APV inside these; see HitecDSettings::widestRangeLeftAPV().) */
+#define HITECD_SIM_END_STOP_LEFT_APV 731
+#define HITECD_SIM_END_STOP_RIGHT_APV (0x3FFF - 731)
+
+/* How fast the simulated servo moves at full speed, in APV per millisecond. */
+#define HITECD_SIM_APV_PER_MILLI 40
+
+/* What a simulated servo has seen. */
+struct HitecDSimServoStats {
+  /* Commands that had the right sync byte and checksum. */
+  unsigned long reads;
+  unsigned long writes;
+
+  /* Writes to REBOOT, SAVE, and FACTORY_RESET. */
+  unsigned long reboots;
+  unsigned long saves;
+  unsigned long factoryResets;
+
+  /* Commands with a bad sync byte or checksum, commands sent while the servo
+  was booting, and command bytes that arrived while a response was due. With
+  one task talking to the servo at a time, all of these stay 0. */
+  unsigned long corruptCommands;
+  unsigned long commandsWhileBooting;
+  unsigned long collisions;
+};
+
+class HitecDSimServo {
+public:
+  HitecDSimServo(int modelNumber = 485);
+
+  /* Connects the servo to a pin. */
+  void plugInto(int pin);
+
+  /* Sets a register's live value directly, e.g. to set up a test. */
+  void poke(uint8_t reg, uint16_t val);
+
+  /* Returns a register's value, as a read would. */
+  uint16_t peek(uint8_t reg);
+
+  HitecDSimServoStats stats;
+
+  /* Used by the simulated pin. */
+  void receiveByte(uint8_t val);
+  int sendByte();
+  bool drivingLineLow();
+
+private:
+  void runCommand();
+  void resetToFactory();
+  void updatePosition();
+
+  uint16_t live[256];
+  uint16_t saved[256];
+  uint16_t factory[256];
+
+  uint8_t command[HD_WRITE_COMMAND_LENGTH];
+  int commandLength;
+
+  uint8_t response[HD_RESPONSE_LENGTH];
+  int responseIndex;
+  uint64_t responseDeadline;
+
+  uint64_t bootedAt;
+
+  /* Where the servo is, and where it's going, in APV. */
+  int32_t positionAPV;
+  int32_t targetAPV;
+  uint64_t positionUpdatedAt;
+};
+
+/* The simulated time, in microseconds since the program started. */
+uint64_t hitecdSimNowMicros();
+
+/* How much of that time was spent in delay() and delayMicroseconds(). */
+uint64_t hitecdSimDelayedMicros();
+
+/* Gives the simulated serial port its input. Each line becomes available only
+once the sketch has drained the previous one and polled Serial.available() with
+nothing left, which is how a person at the Serial Monitor would type it; so a
+prompt that discards leftover input doesn't eat the next line. Lines shouldn't
+include the "\n". */
+void hitecdSimSetInput(const std::vector<std::string> &lines);
+
+/* Called when the sketch waits for input and there isn't any more. By default,
+this exits the program. */
+extern void (*hitecdSimOnEndOfInput)();
+
+/* Called with each byte the sketch writes to Serial. By default, this writes
+to stdout. */
+extern void (*hitecdSimOnOutput)(uint8_t c);
+
+/* Called just before input line `index` (counting from 0) becomes available.
+By default, this does nothing. */
+extern void (*hitecdSimOnInputLine)(size_t index);
+
+#endif /* HitecDSim_h */
@@ -0,0 +1,16 @@
+#ifndef HitecDSimEEPROM_h
+#define HitecDSimEEPROM_h
+
+/* A stand-in for <avr/eeprom.h>, for HitecDOdometer. The simulated EEPROM
+starts out erased (all 0xFF), the same as a new AVR's, and lasts until the
+program exits. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define E2END 0x3FF
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#endif /* HitecDSimEEPROM_h */
@@ -0,0 +1,72 @@
+#ifndef HitecDSimFreeRTOS_h
+#define HitecDSimFreeRTOS_h
+
+/* A stand-in for Arduino_FreeRTOS, built on threads, so that the library's
+FreeRTOS support can be tested on a PC. Put this directory on the include path
+(after the one with the stand-in <Arduino.h>), and HitecDRTOS.h finds it just as
+it would find the real thing. Only the calls that the library uses are here.
+
+Each task is a thread. The threads start when vTaskStartScheduler() is called,
+and vTaskStartScheduler() returns once some task calls vTaskEndScheduler().
+Priorities are ignored: every task runs whenever it isn't blocked, so tasks
+interleave far more than they would on an AVR, which is what a test of the
+locking wants. vTaskDelay() really sleeps, but doesn't advance the simulated
+clock; the simulated time a task waits is all in its busy-waits.
+
+The tick defaults to Arduino_FreeRTOS's 15ms watchdog tick. Build with
+-DportTICK_PERIOD_MS=N to try another. */
+
+#include <stdint.h>
+
+#ifndef portTICK_PERIOD_MS
+#define portTICK_PERIOD_MS 15
+#endif
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+#define tskIDLE_PRIORITY ((UBaseType_t)0)
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+
+#define taskSCHEDULER_NOT_STARTED ((BaseType_t)1)
+#define taskSCHEDULER_RUNNING ((BaseType_t)2)
+
+struct HitecDSimTask;
+struct HitecDSimQueue;
+struct HitecDSimMutex;
+typedef HitecDSimTask *TaskHandle_t;
+typedef HitecDSimQueue *QueueHandle_t;
+typedef HitecDSimMutex *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(
+  TaskFunction_t code,
+  const char *name,
+  uint16_t stackDepth,
+  void *param,
+  UBaseType_t priority,
+  TaskHandle_t *handleOut);
+void vTaskStartScheduler();
+void vTaskEndScheduler();
+BaseType_t xTaskGetSchedulerState();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+void vTaskDelay(TickType_t ticks);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t timeout);
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(
+  QueueHandle_t queue, const void *item, TickType_t timeout);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *itemOut, TickType_t timeout);
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t timeout);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+
+#endif /* HitecDSimFreeRTOS_h */
@@ -0,0 +1,142 @@
+/* Tests the library's FreeRTOS support against a simulated servo: two tasks
+share one servo through its bus lock, while a third sends it jobs through a
+HitecDJobQueue and waits for each to complete. Every value read back is
+checked, and the simulated servo checks that no task's frames ever land in the
+middle of another's.
+
+Build and run (add -DportTICK_PERIOD_MS=4 to try a tick short enough to sleep
+during reads):
+
+    g++ -std=c++11 -pthread -I.. -I. -I../../../../src ../HitecDSim.cpp \
+      HitecDSimRTOS.cpp ../../../../src/HitecDServo.cpp \
+      ../../../../src/HitecDRTOS.cpp HitecDRTOSTest.cpp -o HitecDRTOSTest
+    ./HitecDRTOSTest
+
+Prints a summary, and exits with status 1 if anything went wrong. */
+
+#include <stdio.h>
+
+#include <atomic>
+
+#include "HitecDServo.h"
+#include "HitecDServoInternal.h"
+#include "HitecDSim.h"
+
+#ifndef HITECD_RTOS
+#error "HitecDRTOS.h didn't find the stand-in <Arduino_FreeRTOS.h>."
+#endif
+
+#define SERVO_PIN 2
+#define ROUNDS 40
+
+HitecDSimServo simServo;
+HitecDServo servo;
+HitecDJobQueue jobs;
+
+std::atomic<int> errors(0);
+std::atomic<int> tasksRunning(0);
+
+static void fail(const char *what, int round, int res, uint16_t val) {
+  printf("FAIL: %s, round %d: result %d, value %u\n", what, round, res, val);
+  ++errors;
+}
+
+static void finishTask() {
+  if (--tasksRunning == 0) {
+    vTaskEndScheduler();
+  }
+  while (true) {
+    vTaskDelay(portMAX_DELAY);
+  }
+}
+
+/* Writes a register and reads it back, as one locked operation, so a task that
+shares the servo can't get in between. */
+static void sharingTask(void *param) {
+  uint8_t reg = (uint8_t)(uintptr_t)param;
+  for (int round = 0; round < ROUNDS; ++round) {
+    uint16_t val = (reg + round) % 100;
+    servo.lockBus();
+    servo.writeRawRegister(reg, val);
+    uint16_t readBack = 0;
+    int res = servo.readRawRegister(reg, &readBack);
+    servo.unlockBus();
+    if (res != HITECD_OK || readBack != val) {
+      fail("shared read-back", round, res, readBack);
+    }
+    hitecdYield();
+  }
+  finishTask();
+}
+
+/* Queues a write and a read behind it, and waits for both, in order. */
+static void jobTask(void *) {
+  for (int round = 0; round < ROUNDS; ++round) {
+    uint16_t val = 850 + round;
+    HitecDJob write, read;
+    write.servo = read.servo = &servo;
+    write.op = HITECD_JOB_WRITE;
+    read.op = HITECD_JOB_READ;
+    write.reg = read.reg = HD_REG_FAIL_SAFE;
+    write.val = val;
+    read.val = 0;
+    if (!jobs.submit(&write) || !jobs.submit(&read)) {
+      fail("submit", round, 0, 0);
+      continue;
+    }
+    int res = HitecDJobQueue::waitForCompletion(&write);
+    if (res != HITECD_OK) {
+      fail("write job", round, res, 0);
+    }
+    res = HitecDJobQueue::waitForCompletion(&read);
+    if (res != HITECD_OK || read.val != val) {
+      fail("read job", round, res, read.val);
+    }
+  }
+  finishTask();
+}
+
+int main() {
+  simServo.plugInto(SERVO_PIN);
+
+  int res = servo.attach(SERVO_PIN);
+  if (res != HITECD_OK) {
+    printf("FAIL: attach() returned %d\n", res);
+    return 1;
+  }
+  if (!jobs.begin()) {
+    printf("FAIL: HitecDJobQueue::begin() failed\n");
+    return 1;
+  }
+
+  tasksRunning = 3;
+  xTaskCreate(sharingTask, "A", 192, (void *)(uintptr_t)HD_REG_ID,
+    tskIDLE_PRIORITY + 2, NULL);
+  xTaskCreate(sharingTask, "B", 192,
+    (void *)(uintptr_t)HD_REG_OVERLOAD_PROTECTION, tskIDLE_PRIORITY + 2, NULL);
+  xTaskCreate(jobTask, "C", 192, NULL, tskIDLE_PRIORITY + 2, NULL);
+  vTaskStartScheduler();
+
+  /* attach() reads 4 registers; then each task does a write and a read per
+  round. */
+  unsigned long expected = 3 * ROUNDS;
+  const HitecDSimServoStats &stats = simServo.stats;
+  printf("tick %dms: %lu reads, %lu writes, %lu collisions, "
+    "%lu corrupt commands, %d errors\n",
+    portTICK_PERIOD_MS, stats.reads, stats.writes, stats.collisions,
+    stats.corruptCommands, (int)errors);
+  if (stats.reads != expected + 4 || stats.writes != expected) {
+    printf("FAIL: expected %lu reads and %lu writes\n", expected + 4, expected);
+    ++errors;
+  }
+  if (stats.collisions != 0 || stats.corruptCommands != 0 ||
+      stats.commandsWhileBooting != 0) {
+    printf("FAIL: frames overlapped on the line\n");
+    ++errors;
+  }
+  if (errors != 0) {
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,198 @@
+#include "Arduino_FreeRTOS.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Real time per tick, for vTaskDelay() and timeouts. It's much shorter than
+portTICK_PERIOD_MS so the tests run quickly. */
+#define REAL_TICK std::chrono::microseconds(100)
+
+struct HitecDSimTask {
+  TaskFunction_t code;
+  void *param;
+  std::mutex mutex;
+  std::condition_variable notified;
+  uint32_t notifyCount;
+};
+
+struct HitecDSimQueue {
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::vector<uint8_t> > items;
+};
+
+struct HitecDSimMutex {
+  std::recursive_timed_mutex mutex;
+};
+
+static std::mutex schedulerMutex;
+static std::condition_variable schedulerChanged;
+static BaseType_t schedulerState = taskSCHEDULER_NOT_STARTED;
+static bool schedulerEnded = false;
+static std::vector<HitecDSimTask *> tasks;
+static thread_local HitecDSimTask *currentTask = NULL;
+
+/* Waits on `cv` for up to `timeout` ticks, until `ready()`. */
+template<class Lock, class Ready>
+static bool waitTicks(
+  std::condition_variable &cv,
+  Lock &lock,
+  TickType_t timeout,
+  Ready ready
+) {
+  if (timeout == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, timeout * REAL_TICK, ready);
+}
+
+static void runTask(HitecDSimTask *task) {
+  {
+    std::unique_lock<std::mutex> lock(schedulerMutex);
+    schedulerChanged.wait(lock,
+      [] { return schedulerState == taskSCHEDULER_RUNNING; });
+  }
+  currentTask = task;
+  task->code(task->param);
+}
+
+BaseType_t xTaskCreate(
+  TaskFunction_t code,
+  const char *,
+  uint16_t,
+  void *param,
+  UBaseType_t,
+  TaskHandle_t *handleOut
+) {
+  HitecDSimTask *task = new HitecDSimTask();
+  task->code = code;
+  task->param = param;
+  task->notifyCount = 0;
+  {
+    std::lock_guard<std::mutex> lock(schedulerMutex);
+    tasks.push_back(task);
+  }
+  std::thread(runTask, task).detach();
+  if (handleOut != NULL) {
+    *handleOut = task;
+  }
+  return pdPASS;
+}
+
+void vTaskStartScheduler() {
+  std::unique_lock<std::mutex> lock(schedulerMutex);
+  schedulerState = taskSCHEDULER_RUNNING;
+  schedulerChanged.notify_all();
+  schedulerChanged.wait(lock, [] { return schedulerEnded; });
+}
+
+void vTaskEndScheduler() {
+  std::lock_guard<std::mutex> lock(schedulerMutex);
+  schedulerEnded = true;
+  schedulerChanged.notify_all();
+}
+
+BaseType_t xTaskGetSchedulerState() {
+  std::lock_guard<std::mutex> lock(schedulerMutex);
+  return schedulerState;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return currentTask;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(ticks * REAL_TICK);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->mutex);
+  ++task->notifyCount;
+  task->notified.notify_all();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t timeout) {
+  HitecDSimTask *task = currentTask;
+  std::unique_lock<std::mutex> lock(task->mutex);
+  if (!waitTicks(task->notified, lock, timeout,
+      [task] { return task->notifyCount != 0; })) {
+    return 0;
+  }
+  uint32_t count = task->notifyCount;
+  task->notifyCount = clearOnExit ? 0 : count - 1;
+  return count;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HitecDSimQueue *queue = new HitecDSimQueue();
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete queue;
+}
+
+BaseType_t xQueueSend(
+  QueueHandle_t queue,
+  const void *item,
+  TickType_t timeout
+) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitTicks(queue->changed, lock, timeout,
+      [queue] { return queue->items.size() < queue->length; })) {
+    return pdFALSE;
+  }
+  const uint8_t *bytes = (const uint8_t *)item;
+  queue->items.push_back(
+    std::vector<uint8_t>(bytes, bytes + queue->itemSize));
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(
+  QueueHandle_t queue,
+  void *itemOut,
+  TickType_t timeout
+) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitTicks(queue->changed, lock, timeout,
+      [queue] { return !queue->items.empty(); })) {
+    return pdFALSE;
+  }
+  memcpy(itemOut, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+  return new HitecDSimMutex();
+}
+
+BaseType_t xSemaphoreTakeRecursive(
+  SemaphoreHandle_t mutex,
+  TickType_t timeout
+) {
+  if (timeout == portMAX_DELAY) {
+    mutex->mutex.lock();
+    return pdTRUE;
+  }
+  return mutex->mutex.try_lock_for(timeout * REAL_TICK) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) {
+  mutex->mutex.unlock();
+  return pdTRUE;
+}
@@ -0,0 +1,7 @@
+#ifndef HitecDSimQueue_h
+#define HitecDSimQueue_h
+
+/* See Arduino_FreeRTOS.h. */
+#include "Arduino_FreeRTOS.h"
+
+#endif
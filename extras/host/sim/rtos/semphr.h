@@ -0,0 +1,7 @@
+#ifndef HitecDSimSemphr_h
+#define HitecDSimSemphr_h
+
+/* See Arduino_FreeRTOS.h. */
+#include "Arduino_FreeRTOS.h"
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HitecDSimTask_h
+#define HitecDSimTask_h
+
+/* See Arduino_FreeRTOS.h. */
+#include "Arduino_FreeRTOS.h"
+
+#endif
@@ -0,0 +1,157 @@
+#include "HitecDGangedPair.h"
+
+/* Returns +1 if increasing the target increases the servo's APV, or -1 if it
+decreases it. */
+static int8_t targetDirection(HitecDServo *servo) {
+  return (servo->quarterMicrosToAPV(4*1600) >=
+    servo->quarterMicrosToAPV(4*1400)) ? 1 : -1;
+}
+
+HitecDGangedPair::HitecDGangedPair() :
+  powerA(0),
+  powerB(0),
+  positionA(0),
+  positionB(0),
+  powerSign(0),
+  servoA(NULL),
+  servoB(NULL),
+  signA(1),
+  signB(1),
+  powerGain(8),
+  maxTrim256(80L * 256),
+  haveTarget(false),
+  targetQuarterMicros(0),
+  offsetTrim256(0),
+  powerTrim256(0),
+  haveOffset(false),
+  sentTrim(0),
+  detectVotes(0)
+{ }
+
+void HitecDGangedPair::begin(
+  HitecDServo *_servoA,
+  HitecDServo *_servoB,
+  int16_t _powerGain,
+  int16_t maxTrimQuarterMicros,
+  int8_t _powerSign
+) {
+  servoA = _servoA;
+  servoB = _servoB;
+  signA = targetDirection(servoA);
+  signB = targetDirection(servoB);
+  powerGain = _powerGain;
+  maxTrim256 = (int32_t)maxTrimQuarterMicros * 256;
+  haveTarget = false;
+  offsetTrim256 = 0;
+  powerTrim256 = 0;
+  haveOffset = false;
+  sentTrim = 0;
+  powerSign = _powerSign;
+  detectVotes = 0;
+}
+
+void HitecDGangedPair::writeTargetMicroseconds(int16_t microseconds) {
+  writeTargetQuarterMicros(microseconds * 4);
+}
+
+void HitecDGangedPair::writeTargetQuarterMicros(int16_t quarterMicros) {
+  haveTarget = true;
+  targetQuarterMicros = quarterMicros;
+  sendTargets();
+}
+
+int HitecDGangedPair::poll() {
+  int res;
+  int16_t apvA, apvB, rawPowerA, rawPowerB;
+  if ((apvA = servoA->readCurrentAPV()) < 0) {
+    return apvA;
+  }
+  if ((apvB = servoB->readCurrentAPV()) < 0) {
+    return apvB;
+  }
+  if ((res = servoA->readMotorPower(&rawPowerA)) != HITECD_OK) {
+    return res;
+  }
+  if ((res = servoB->readMotorPower(&rawPowerB)) != HITECD_OK) {
+    return res;
+  }
+  positionA = servoA->apvToQuarterMicros(apvA);
+  positionB = servoB->apvToQuarterMicros(apvB);
+  if (powerSign == 0 && haveTarget) {
+    detectPowerSign(servoA, apvA, sentTrim, rawPowerA);
+    detectPowerSign(servoB, apvB, -sentTrim, rawPowerB);
+  }
+  powerA = powerSign * signA * rawPowerA;
+  powerB = powerSign * signB * rawPowerB;
+
+  /* Both servos are at the same physical position, so aiming each one half the
+  disagreement away from the target gives them both the same error. */
+  int32_t offset256 = (int32_t)(positionA - positionB) * 128;
+  if (!haveOffset) {
+    offsetTrim256 = offset256;
+    haveOffset = true;
+  } else {
+    offsetTrim256 +=
+      (offset256 - offsetTrim256) >> HITECD_GANG_OFFSET_SMOOTHING;
+  }
+
+  /* If A is pushing harder towards higher targets than B, its target is too
+  high relative to B's. (Until the power sign is known, both powers are 0.) */
+  int16_t powerDiff = powerA - powerB;
+  if (powerDiff > HITECD_GANG_POWER_DEADBAND) {
+    powerTrim256 -=
+      (int32_t)(powerDiff - HITECD_GANG_POWER_DEADBAND) * powerGain;
+  } else if (powerDiff < -HITECD_GANG_POWER_DEADBAND) {
+    powerTrim256 -=
+      (int32_t)(powerDiff + HITECD_GANG_POWER_DEADBAND) * powerGain;
+  }
+  /* Don't let the integrator wind up past the limit. */
+  powerTrim256 = constrain(powerTrim256,
+    -maxTrim256 - offsetTrim256, maxTrim256 - offsetTrim256);
+
+  if (trimQuarterMicros() != sentTrim) {
+    sendTargets();
+  }
+  return HITECD_OK;
+}
+
+/* A servo that's well away from its target pushes towards it, so the sign of
+its motor power then tells us the convention. Both the error and the power are
+in APV terms, so a mirrored servo gives the same answer. Since the servo may be
+braking or bouncing, several samples in a row must agree. */
+void HitecDGangedPair::detectPowerSign(
+  HitecDServo *servo,
+  int16_t apv,
+  int16_t trim,
+  int16_t rawPower
+) {
+  int16_t error = servo->quarterMicrosToAPV(targetQuarterMicros + trim) - apv;
+  if (abs(error) < HITECD_GANG_DETECT_APV ||
+      abs(rawPower) < HITECD_GANG_DETECT_POWER) {
+    return;
+  }
+  int8_t vote = ((error > 0) == (rawPower > 0)) ? 1 : -1;
+  if ((vote > 0) != (detectVotes > 0)) {
+    detectVotes = 0;
+  }
+  detectVotes += vote;
+  if (abs(detectVotes) >= HITECD_GANG_DETECT_POLLS) {
+    powerSign = vote;
+  }
+}
+
+int16_t HitecDGangedPair::trimQuarterMicros() {
+  int32_t trim256 = constrain(offsetTrim256 + powerTrim256,
+    -maxTrim256, maxTrim256);
+  /* Round to nearest */
+  return (int16_t)((trim256 + (trim256 >= 0 ? 128 : -128)) / 256);
+}
+
+void HitecDGangedPair::sendTargets() {
+  if (!haveTarget) {
+    return;
+  }
+  sentTrim = trimQuarterMicros();
+  servoA->writeTargetQuarterMicros(targetQuarterMicros + sentTrim);
+  servoB->writeTargetQuarterMicros(targetQuarterMicros - sentTrim);
+}
@@ -0,0 +1,118 @@
+#ifndef HitecDGangedPair_h
+#define HitecDGangedPair_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDGangedPair drives two servos that are mechanically connected to the
+same joint, and trims their targets so they share the load instead of fighting.
+For example:
+
+    HitecDGangedPair joint;
+    joint.begin(&servoA, &servoB);
+    joint.writeTargetMicroseconds(1600);
+    while (...) {
+      joint.poll();
+    }
+
+No two servos agree exactly on where a position is. If both are sent the same
+target, each pushes towards its own idea of it, and they can end up both at
+high power while the joint stays still. Each poll() reads both servos' positions
+and motor powers, then adjusts a trim that is added to A's target and subtracted
+from B's:
+1. Both servos read the same physical position, so the difference between their
+   readings is their disagreement. Half of it (smoothed) goes into the trim,
+   which makes both servos see the same error.
+2. What's left over (e.g. one servo being stronger) shows up as a difference in
+   motor power. Any difference larger than HITECD_GANG_POWER_DEADBAND is
+   integrated into the trim, scaled by `powerGain`, until the powers match.
+The trim is kept in 1/256 quarter-microsecond units so small corrections
+accumulate, and is limited to `maxTrimQuarterMicros` either way.
+
+If one servo is mounted mirrored, set its `counterclockwise` setting so that
+the same target moves both servos the same way. Motor powers are converted to
+the direction of increasing target for each servo separately.
+
+Which way the sign of readMotorPower() points isn't documented. Pass it to
+begin() as `powerSign` if you know it; otherwise it's detected while polling,
+from which way the motors push when a servo is well away from its target. Until
+then, only step 1 is done. Once detected, it can be read from `powerSign` and
+passed to begin() next time.
+
+A poll is four reads, so it takes about 73ms. */
+
+/* Differences in motor power smaller than this are treated as noise. In the
+units of readMotorPower() (0 to 2000). */
+#define HITECD_GANG_POWER_DEADBAND 40
+
+/* How much of each new position difference goes into the smoothed estimate,
+as a power of 2. (3 means 1/8.) */
+#define HITECD_GANG_OFFSET_SMOOTHING 3
+
+/* To detect the sign of the motor power, a servo must be at least this many
+APV from its target, and pushing with at least this much power. That many
+samples (from either servo) must agree in a row. */
+#define HITECD_GANG_DETECT_APV 100
+#define HITECD_GANG_DETECT_POWER 200
+#define HITECD_GANG_DETECT_POLLS 4
+
+class HitecDGangedPair {
+public:
+  HitecDGangedPair();
+
+  /* `powerGain` is how much the trim moves per poll for each unit of power
+  difference, in 1/256 quarter-microseconds. `powerSign` is as described below;
+  pass 0 to detect it. */
+  void begin(
+    HitecDServo *servoA,
+    HitecDServo *servoB,
+    int16_t powerGain = 8,
+    int16_t maxTrimQuarterMicros = 80,
+    int8_t powerSign = 0);
+
+  void writeTargetMicroseconds(int16_t microseconds);
+  void writeTargetQuarterMicros(int16_t quarterMicros);
+
+  /* Samples both servos, updates the trim, and re-sends the targets if the trim
+  changed. Returns HITECD_OK or an error code; on error the trim is unchanged.
+  */
+  int poll();
+
+  /* The current trim, in quarter-microseconds. Servo A's target is the target
+  plus this; servo B's is the target minus this. */
+  int16_t trimQuarterMicros();
+
+  /* Latest samples, for monitoring. Powers are signed towards increasing
+  target, and are 0 until `powerSign` is known. */
+  int16_t powerA, powerB;
+  int16_t positionA, positionB;
+
+  /* +1 if readMotorPower() is positive when the motor pushes towards higher
+  APVs, -1 if it's negative, or 0 if not known yet. */
+  int8_t powerSign;
+
+private:
+  void detectPowerSign(
+    HitecDServo *servo, int16_t apv, int16_t trim, int16_t rawPower);
+  void sendTargets();
+
+  HitecDServo *servoA, *servoB;
+  /* +1 if increasing the target increases the servo's APV, else -1 */
+  int8_t signA, signB;
+  int16_t powerGain;
+  int32_t maxTrim256;
+
+  bool haveTarget;
+  int16_t targetQuarterMicros;
+
+  /* In 1/256 quarter-microseconds */
+  int32_t offsetTrim256, powerTrim256;
+  bool haveOffset;
+  int16_t sentTrim;
+
+  /* Samples in a row that suggested the same power sign; negative for -1 */
+  int8_t detectVotes;
+};
+
+#endif /* HitecDGangedPair_h */
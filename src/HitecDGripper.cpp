@@ -0,0 +1,102 @@
+#include "HitecDGripper.h"
+
+#include "HitecDServoInternal.h"
+
+HitecDGripper::HitecDGripper() :
+  servo(NULL),
+  contactPower(400),
+  holdPowerLimit(20),
+  stepQuarterMicros(16),
+  squeezeQuarterMicros(40),
+  holding(false),
+  savedPowerLimit(0)
+{ }
+
+void HitecDGripper::begin(
+  HitecDServo *_servo,
+  int16_t _contactPower,
+  int16_t _holdPowerLimit,
+  int16_t _stepQuarterMicros,
+  int16_t _squeezeQuarterMicros
+) {
+  servo = _servo;
+  contactPower = _contactPower;
+  holdPowerLimit = _holdPowerLimit;
+  stepQuarterMicros = max(_stepQuarterMicros, 1);
+  squeezeQuarterMicros = _squeezeQuarterMicros;
+  holding = false;
+}
+
+int HitecDGripper::close(
+  int16_t closedQuarterMicros,
+  HitecDGripResult *resultOut
+) {
+  int res;
+  resultOut->contact = false;
+
+  /* Remember the power limit, so release() can put it back. If we're already
+  holding something, the current limit is our own hold limit. */
+  if (!holding) {
+    if ((res = servo->readRawRegister(HD_REG_POWER_LIMIT, &savedPowerLimit))
+        != HITECD_OK) {
+      return res;
+    }
+  }
+
+  int16_t apv = servo->readCurrentAPV();
+  if (apv < 0) {
+    return apv;
+  }
+  int16_t target = servo->apvToQuarterMicros(apv);
+  int16_t direction = (closedQuarterMicros > target) ? 1 : -1;
+
+  int samplesOverContact = 0;
+  int samplesAfterClosed = 0;
+  while (samplesAfterClosed < HITECD_GRIP_SETTLE_SAMPLES) {
+    if (abs(closedQuarterMicros - target) <= stepQuarterMicros) {
+      target = closedQuarterMicros;
+      ++samplesAfterClosed;
+    } else {
+      target += direction * stepQuarterMicros;
+    }
+    servo->writeTargetQuarterMicros(target);
+
+    int16_t power;
+    if ((res = servo->readMotorPower(&power)) != HITECD_OK) {
+      return res;
+    }
+    if (abs(power) < contactPower) {
+      samplesOverContact = 0;
+      continue;
+    }
+    if (++samplesOverContact < HITECD_GRIP_CONTACT_SAMPLES) {
+      continue;
+    }
+
+    /* Contact. Limit the force first, then find out where we are. */
+    servo->writeLivePowerLimit(holdPowerLimit);
+    holding = true;
+    resultOut->contactMillis = millis();
+
+    apv = servo->readCurrentAPV();
+    if (apv < 0) {
+      return apv;
+    }
+    resultOut->contact = true;
+    resultOut->contactAPV = apv;
+    resultOut->contactQuarterMicros = servo->apvToQuarterMicros(apv);
+    servo->writeTargetQuarterMicros(
+      resultOut->contactQuarterMicros + direction * squeezeQuarterMicros);
+    return HITECD_OK;
+  }
+
+  return HITECD_OK;
+}
+
+void HitecDGripper::release(int16_t openQuarterMicros) {
+  if (holding) {
+    servo->writeRawRegister(HD_REG_POWER_LIMIT, savedPowerLimit);
+    holding = false;
+  }
+  servo->writeTargetQuarterMicros(openQuarterMicros);
+}
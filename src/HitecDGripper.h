@@ -0,0 +1,90 @@
+#ifndef HitecDGripper_h
+#define HitecDGripper_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDGripper closes a gripper until it touches something, then holds on
+with a limited force. For example:
+
+    HitecDGripper gripper;
+    HitecDGripResult grip;
+
+    gripper.begin(&servo);
+    gripper.close(4 * 1900, &grip);
+    if (grip.contact) {
+      ... the object is held at grip.contactQuarterMicros ...
+    }
+    ...
+    gripper.release(4 * 1100);
+
+close() starts from wherever the servo is now and steps the target towards
+the closed position, `stepQuarterMicros` at a time. After each step it reads
+the motor power (see HitecDServo::readMotorPower()). Once the power has been at
+least `contactPower` for HITECD_GRIP_CONTACT_SAMPLES samples in a row, it:
+1. drops the power limit to `holdPowerLimit` with writeLivePowerLimit(), so the
+   servo can't squeeze any harder than that;
+2. reads the position where the contact happened;
+3. sets the target `squeezeQuarterMicros` past that position, so the servo
+   keeps pressing gently rather than relaxing into its deadband.
+Each step is one write plus one read (about 18ms), so contact is acted on
+within HITECD_GRIP_CONTACT_SAMPLES steps of the power rising.
+
+Moving fast takes power too, so `stepQuarterMicros` must be small enough that
+the servo can keep up at a low power. The default moves 4us per 18ms step, or
+about 220us per second. */
+
+/* How many samples in a row must show contact. More than one, so that a single
+noisy reading doesn't count. */
+#define HITECD_GRIP_CONTACT_SAMPLES 2
+
+/* If the target reaches the closed position without contact, keep watching
+for this many more samples while the servo catches up. */
+#define HITECD_GRIP_SETTLE_SAMPLES 10
+
+struct HitecDGripResult {
+  /* True if contact was detected; otherwise the gripper closed all the way
+  without touching anything, and the other fields are not valid. */
+  bool contact;
+
+  /* Where the contact was detected. */
+  int16_t contactAPV;
+  int16_t contactQuarterMicros;
+
+  /* Value of millis() when the power limit was dropped. */
+  uint32_t contactMillis;
+};
+
+class HitecDGripper {
+public:
+  HitecDGripper();
+
+  /* `contactPower` is in the units of readMotorPower() (0 to 2000).
+  `holdPowerLimit` is a percentage, as in HitecDSettings::powerLimit. */
+  void begin(
+    HitecDServo *servo,
+    int16_t contactPower = 400,
+    int16_t holdPowerLimit = 20,
+    int16_t stepQuarterMicros = 16,
+    int16_t squeezeQuarterMicros = 40);
+
+  /* Closes towards `closedQuarterMicros` until contact, as described above.
+  Returns HITECD_OK (whether or not there was contact) or an error code if
+  communication with the servo failed. Blocks until done. */
+  int close(int16_t closedQuarterMicros, HitecDGripResult *resultOut);
+
+  /* Restores the power limit that was in effect before close(), and moves to
+  `openQuarterMicros`. */
+  void release(int16_t openQuarterMicros);
+
+private:
+  HitecDServo *servo;
+  int16_t contactPower, holdPowerLimit;
+  int16_t stepQuarterMicros, squeezeQuarterMicros;
+
+  bool holding;
+  uint16_t savedPowerLimit;
+};
+
+#endif /* HitecDGripper_h */
@@ -0,0 +1,162 @@
+#include "HitecDHoldOptimizer.h"
+
+#include "HitecDServoInternal.h"
+
+HitecDHoldOptimizer::HitecDHoldOptimizer() :
+  servo(NULL),
+  step(100),
+  stepMillis(250),
+  toleranceAPV(8),
+  fullPowerRaw(0x0FFF),
+  fullPower(HD_POWER_LIMIT_MAX),
+  power(HD_POWER_LIMIT_MAX),
+  floorPower(100),
+  writingPower(false),
+  state(HOLD_IDLE),
+  stateMillis(0),
+  targetAPV(0),
+  lastAPV(0),
+  lastAPVValid(false),
+  settledError(0)
+{ }
+
+int HitecDHoldOptimizer::begin(
+  HitecDServo *_servo,
+  uint8_t stepPercent,
+  uint16_t _stepMillis,
+  int16_t _toleranceAPV
+) {
+  end();
+
+  int res;
+  uint16_t temp;
+  if ((res = _servo->readRawRegister(HD_REG_POWER_LIMIT, &temp)) != HITECD_OK) {
+    return res;
+  }
+
+  servo = _servo;
+  step = max((int16_t)stepPercent * (HD_POWER_LIMIT_MAX / 100), 1);
+  stepMillis = _stepMillis;
+  toleranceAPV = _toleranceAPV;
+  fullPowerRaw = temp;
+  fullPower = min(temp, (uint16_t)HD_POWER_LIMIT_MAX);
+  power = fullPower;
+  floorPower = step;
+  state = HOLD_IDLE;
+  servo->addListener(this);
+  return HITECD_OK;
+}
+
+void HitecDHoldOptimizer::end() {
+  if (servo == NULL) {
+    return;
+  }
+  servo->removeListener(this);
+  restoreFullPower();
+  servo = NULL;
+}
+
+int HitecDHoldOptimizer::poll() {
+  if (servo == NULL || state == HOLD_IDLE) {
+    return HITECD_OK;
+  }
+  uint32_t now = millis();
+  if (now - stateMillis < stepMillis) {
+    return HITECD_OK;
+  }
+  stateMillis = now;
+
+  int16_t apv = servo->readCurrentAPV();
+  if (apv < 0) {
+    return apv;
+  }
+  int16_t error = abs(apv - targetAPV);
+
+  switch (state) {
+  case HOLD_SETTLING:
+    /* Settled once it has stopped moving, wherever that is. (The deadband
+    means it may not be exactly on target.) */
+    if (lastAPVValid && abs(apv - lastAPV) <= toleranceAPV) {
+      settledError = error;
+      state = HOLD_STEPPING;
+    }
+    lastAPV = apv;
+    lastAPVValid = true;
+    break;
+
+  case HOLD_STEPPING:
+    if (error > settledError + toleranceAPV) {
+      setPower(min(power + step, fullPower));
+      state = HOLD_HOLDING;
+    } else if (power - step >= floorPower) {
+      setPower(power - step);
+    } else {
+      state = HOLD_HOLDING;
+    }
+    break;
+
+  case HOLD_HOLDING:
+    if (error > settledError + 2 * toleranceAPV) {
+      /* The load has grown. Don't go this low again for this target. */
+      floorPower = min(power + step, fullPower);
+      restoreFullPower();
+      state = HOLD_SETTLING;
+      lastAPVValid = false;
+    }
+    break;
+
+  case HOLD_IDLE:
+    break;
+  }
+  return HITECD_OK;
+}
+
+bool HitecDHoldOptimizer::isReduced() {
+  return power < fullPower;
+}
+
+int16_t HitecDHoldOptimizer::powerLimit() {
+  return power;
+}
+
+void HitecDHoldOptimizer::onWriteRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  uint16_t val
+) {
+  if (reg == HD_REG_TARGET) {
+    restoreFullPower();
+    targetAPV = servo->quarterMicrosToAPV((int16_t)val + 3000);
+    floorPower = step;
+  } else if (reg == HD_REG_POWER_LIMIT && !writingPower) {
+    /* The sketch set its own power limit. */
+    fullPowerRaw = val;
+    fullPower = min(val, (uint16_t)HD_POWER_LIMIT_MAX);
+    power = fullPower;
+    floorPower = step;
+    if (state == HOLD_IDLE) {
+      return;
+    }
+  } else {
+    return;
+  }
+  state = HOLD_SETTLING;
+  stateMillis = millis();
+  lastAPVValid = false;
+}
+
+void HitecDHoldOptimizer::setPower(int16_t _power) {
+  power = _power;
+  writingPower = true;
+  servo->writeRawRegister(HD_REG_POWER_LIMIT, power);
+  writingPower = false;
+}
+
+void HitecDHoldOptimizer::restoreFullPower() {
+  if (power < fullPower) {
+    power = fullPower;
+    writingPower = true;
+    servo->writeRawRegister(HD_REG_POWER_LIMIT, fullPowerRaw);
+    writingPower = false;
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef HitecDHoldOptimizer_h
+#define HitecDHoldOptimizer_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDHoldOptimizer lowers a servo's power limit while it holds still, to
+save current. For example:
+
+    HitecDHoldOptimizer hold;
+    hold.begin(&servo);
+    servo.writeTargetMicroseconds(1600);
+    while (...) {
+      hold.poll();
+    }
+
+The configured power limit has to cover the worst-case motion, but holding a
+pose usually takes much less. Once the servo has settled after a new target,
+poll() lowers HD_REG_POWER_LIMIT one step at a time, with the same live write
+as HitecDServo::writeLivePowerLimit() (nothing is saved). After each step it
+waits `stepMillis` and compares the position with the target. As soon as the
+error grows by more than `toleranceAPV` over the error at settling, it raises
+the limit back by one step and holds there.
+
+If the load later grows and the error exceeds twice the tolerance, full power is
+restored, and the next descent stops one step above the limit that failed.
+
+It's a listener, so it sees every target the sketch writes, however it's
+written. On a new target it restores full power immediately, about 1ms after the
+target itself. If the sketch writes the power limit itself, that becomes the new
+full power.
+
+poll() does at most one read every `stepMillis`. */
+
+class HitecDHoldOptimizer : public HitecDListener {
+public:
+  HitecDHoldOptimizer();
+
+  /* Starts managing the given servo's power limit. `stepPercent` is the size of
+  each step, as a percentage of max power. Returns HITECD_OK or an error code.
+  */
+  int begin(
+    HitecDServo *servo,
+    uint8_t stepPercent = 5,
+    uint16_t stepMillis = 250,
+    int16_t toleranceAPV = 8);
+
+  /* Restores full power and stops managing the servo. */
+  void end();
+
+  /* Call this periodically from loop(). Returns HITECD_OK or an error code. */
+  int poll();
+
+  /* True if the power limit is currently below full power. */
+  bool isReduced();
+
+  /* The current power limit, in the units of HD_REG_POWER_LIMIT (0 to 2000).
+  */
+  int16_t powerLimit();
+
+  virtual void onWriteRegister(
+    HitecDServo *servo, uint8_t reg, uint16_t val);
+
+private:
+  enum State {
+    /* No target has been written yet */
+    HOLD_IDLE,
+    /* At full power, waiting for the servo to stop moving */
+    HOLD_SETTLING,
+    /* Lowering the power limit */
+    HOLD_STEPPING,
+    /* Holding at the lowest power that kept the position */
+    HOLD_HOLDING
+  };
+
+  void setPower(int16_t power);
+  void restoreFullPower();
+
+  HitecDServo *servo;
+  int16_t step;
+  uint16_t stepMillis;
+  int16_t toleranceAPV;
+
+  /* As read from the servo, so it can be put back exactly */
+  uint16_t fullPowerRaw;
+  int16_t fullPower;
+  int16_t power;
+  /* Lowest power that the next descent may try */
+  int16_t floorPower;
+  bool writingPower;
+
+  State state;
+  uint32_t stateMillis;
+  int16_t targetAPV;
+  int16_t lastAPV;
+  bool lastAPVValid;
+  int16_t settledError;
+};
+
+#endif /* HitecDHoldOptimizer_h */
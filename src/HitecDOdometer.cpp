@@ -0,0 +1,272 @@
+#include "HitecDOdometer.h"
+
+#include <avr/eeprom.h>
+
+#include "HitecDServoInternal.h"
+
+HitecDOdometer::HitecDOdometer() : servo(NULL) {
+  memset(&counters, 0, sizeof(counters));
+}
+
+int HitecDOdometer::begin(
+  HitecDServo *_servo,
+  int _eepromAddress,
+  uint8_t _numRecords
+) {
+  end();
+
+  int model = _servo->readModelNumber();
+  if (model < 0) {
+    return model;
+  }
+  int res;
+  uint16_t temp;
+  if ((res = _servo->readRawRegister(HD_REG_DATE_CODE, &temp)) != HITECD_OK) {
+    return res;
+  }
+
+  servo = _servo;
+  eepromAddress = _eepromAddress;
+  numRecords = _numRecords;
+  modelNumber = model;
+  dateCode = temp;
+
+  /* Load the most recent record for this servo, if there is one. */
+  memset(&counters, 0, sizeof(counters));
+  bool found = false;
+  uint16_t bestSequence = 0;
+  for (uint8_t i = 0; i < numRecords; ++i) {
+    Record record;
+    if (!readRecord(i, &record) ||
+        record.modelNumber != modelNumber ||
+        record.dateCode != dateCode) {
+      continue;
+    }
+    if (!found || (int16_t)(record.sequence - bestSequence) > 0) {
+      counters = record.counters;
+      bestSequence = record.sequence;
+      found = true;
+    }
+  }
+
+  dirty = false;
+  lastSaveMillis = millis();
+  lastAPVValid = false;
+  lastPowerStalled = false;
+  effectivePowerLimit = HD_POWER_LIMIT_MAX;
+  effectivePowerLimitValid = false;
+  rebootWritten = false;
+
+  servo->addListener(this);
+  return HITECD_OK;
+}
+
+void HitecDOdometer::end() {
+  if (servo == NULL) {
+    return;
+  }
+  if (dirty) {
+    save();
+  }
+  servo->removeListener(this);
+  servo = NULL;
+}
+
+void HitecDOdometer::update(uint32_t saveIntervalMillis) {
+  if (servo != NULL && dirty && millis() - lastSaveMillis >= saveIntervalMillis) {
+    save();
+  }
+}
+
+uint8_t HitecDOdometer::checksum(const Record &record) {
+  const uint8_t *bytes = (const uint8_t *)&record;
+  uint8_t sum = 0x5A;
+  for (uint8_t i = 0; i < offsetof(Record, checksum); ++i) {
+    sum += bytes[i];
+  }
+  return sum;
+}
+
+bool HitecDOdometer::readRecord(uint8_t index, Record *recordOut) {
+  eeprom_read_block(
+    recordOut,
+    (const void *)(eepromAddress + index * sizeof(Record)),
+    sizeof(Record));
+  /* Erased EEPROM reads as 0xFF */
+  return recordOut->modelNumber != 0xFFFF &&
+    recordOut->checksum == checksum(*recordOut);
+}
+
+/* Returns true if `record` (stored at `index`) holds the most recent counters
+for its servo, i.e. overwriting it would lose data. */
+bool HitecDOdometer::isLatestRecord(uint8_t index, const Record &record) {
+  for (uint8_t i = 0; i < numRecords; ++i) {
+    Record other;
+    if (i == index || !readRecord(i, &other)) {
+      continue;
+    }
+    if (other.modelNumber == record.modelNumber &&
+        other.dateCode == record.dateCode &&
+        (int16_t)(other.sequence - record.sequence) > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool HitecDOdometer::save() {
+  if (servo == NULL) {
+    return false;
+  }
+
+  /* Find the most recently written record, from any servo. We'll write to the
+  record just after it, so that writes cycle through the whole area. */
+  int newestIndex = -1;
+  uint16_t newestSequence = 0;
+  for (uint8_t i = 0; i < numRecords; ++i) {
+    Record record;
+    if (!readRecord(i, &record)) {
+      continue;
+    }
+    if (newestIndex == -1 ||
+        (int16_t)(record.sequence - newestSequence) > 0) {
+      newestIndex = i;
+      newestSequence = record.sequence;
+    }
+  }
+
+  for (uint8_t k = 1; k <= numRecords; ++k) {
+    uint8_t index = (newestIndex + k) % numRecords;
+
+    /* Don't overwrite another servo's latest counters. */
+    Record existing;
+    if (readRecord(index, &existing) &&
+        (existing.modelNumber != modelNumber ||
+          existing.dateCode != dateCode) &&
+        isLatestRecord(index, existing)) {
+      continue;
+    }
+
+    Record record;
+    record.modelNumber = modelNumber;
+    record.dateCode = dateCode;
+    record.sequence = newestSequence + 1;
+    record.counters = counters;
+    record.checksum = checksum(record);
+    eeprom_update_block(
+      &record,
+      (void *)(eepromAddress + index * sizeof(Record)),
+      sizeof(Record));
+
+    dirty = false;
+    lastSaveMillis = millis();
+    return true;
+  }
+
+  return false;
+}
+
+void HitecDOdometer::print(Print &out) {
+  out.print(F("Servo D"));
+  out.print(modelNumber);
+  out.print(F(", date code "));
+  out.println(dateCode);
+  out.print(F("Travel (APV): "));
+  out.println(counters.travelAPV);
+  out.print(F("Time stalled (s): "));
+  out.println(counters.stallMillis / 1000);
+  out.print(F("Overload events: "));
+  out.println(counters.overloadEvents);
+  out.print(F("Reboots: "));
+  out.println(counters.reboots);
+  out.print(F("EEPROM saves: "));
+  out.println(counters.eepromSaves);
+}
+
+void HitecDOdometer::onReadRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  int res,
+  uint16_t val
+) {
+  if (res == HITECD_ERR_BOOTING_OR_NO_PULLUP) {
+    /* Count unexpected reboots (e.g. brown-outs) too. But if the sketch wrote
+    REBOOT recently, we already counted this one. */
+    if (!rebootWritten || millis() - rebootWrittenMillis > 2000) {
+      ++counters.reboots;
+      dirty = true;
+      rebootWritten = true;
+      rebootWrittenMillis = millis();
+    }
+    lastAPVValid = false;
+    return;
+  }
+  if (res != HITECD_OK) {
+    return;
+  }
+
+  switch (reg) {
+  case HD_REG_CURRENT_APV:
+    if (lastAPVValid && (int16_t)val != lastAPV) {
+      counters.travelAPV += abs((int16_t)val - lastAPV);
+      dirty = true;
+    }
+    lastAPV = val;
+    lastAPVValid = true;
+    break;
+
+  case HD_REG_MOTOR_POWER: {
+    /* Allow a little slack below the limit, so noise doesn't stop us from
+    detecting a stall. */
+    bool stalled = effectivePowerLimit > 0 &&
+      abs((int16_t)val) >= effectivePowerLimit - effectivePowerLimit / 32;
+    uint32_t now = millis();
+    if (stalled && lastPowerStalled) {
+      /* If the sketch hasn't checked in a while, we don't really know how long
+      the servo was stalled for; cap it so long gaps don't inflate the count. */
+      counters.stallMillis += min(now - lastPowerMillis, (uint32_t)1000);
+      dirty = true;
+    }
+    lastPowerStalled = stalled;
+    lastPowerMillis = now;
+    break;
+  }
+
+  case HD_REG_EFFECTIVE_POWER_LIMIT:
+    if (effectivePowerLimitValid && (int16_t)val < effectivePowerLimit) {
+      ++counters.overloadEvents;
+      dirty = true;
+    }
+    effectivePowerLimit = val;
+    effectivePowerLimitValid = true;
+    break;
+  }
+}
+
+void HitecDOdometer::onWriteRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  uint16_t val
+) {
+  switch (reg) {
+  case HD_REG_REBOOT:
+    ++counters.reboots;
+    dirty = true;
+    rebootWritten = true;
+    rebootWrittenMillis = millis();
+    lastAPVValid = false;
+    break;
+
+  case HD_REG_SAVE:
+    ++counters.eepromSaves;
+    dirty = true;
+    break;
+
+  case HD_REG_POWER_LIMIT:
+    /* The effective power limit is expected to change now, so the next change
+    doesn't indicate an overload. */
+    effectivePowerLimit = min(val, (uint16_t)HD_POWER_LIMIT_MAX);
+    effectivePowerLimitValid = false;
+    break;
+  }
+}
@@ -0,0 +1,112 @@
+#ifndef HitecDOdometer_h
+#define HitecDOdometer_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDOdometer keeps lifetime usage counters for a servo, for predictive
+maintenance. Like HitecDRecorder, it only listens in on reads and writes that
+the sketch is already doing:
+- Travel is accumulated from readCurrentAPV().
+- Stall time is accumulated from readMotorPower(): the servo is considered
+  stalled while its motor power is at the effective power limit.
+- Overload events are counted when a read of HD_REG_EFFECTIVE_POWER_LIMIT shows
+  that overload protection has kicked in.
+- Reboots and EEPROM saves are counted when the sketch writes the REBOOT or SAVE
+  registers (e.g. via writeSettings()), or when the servo unexpectedly reboots.
+
+The counters are stored in the Arduino's EEPROM, keyed by the servo's
+fingerprint (model number plus the per-unit date code in register 0x06), so they
+follow the servo if it's moved to a different pin. Several odometers can share
+the same EEPROM area. Each save goes to the next record in the area, so that
+writes are spread evenly over all the records. */
+
+/* Default number of records in the EEPROM area. This must be comfortably more
+than the number of servos sharing the area. */
+#define HITECD_ODOMETER_RECORDS 16
+
+struct HitecDOdometerCounters {
+  /* Total distance traveled, in APV units. */
+  uint32_t travelAPV;
+
+  /* Total time spent stalled. */
+  uint32_t stallMillis;
+
+  uint16_t overloadEvents;
+  uint16_t reboots;
+  uint16_t eepromSaves;
+};
+
+class HitecDOdometer : public HitecDListener {
+public:
+  HitecDOdometer();
+
+  /* Starts tracking the given servo, and loads its counters from EEPROM. The
+  EEPROM area starts at `eepromAddress` and holds `numRecords` records of
+  HitecDOdometer::eepromRecordSize bytes each. This reads the servo's date code,
+  so it may return an error code. */
+  int begin(
+    HitecDServo *servo,
+    int eepromAddress = 0,
+    uint8_t numRecords = HITECD_ODOMETER_RECORDS);
+
+  /* Saves the counters and stops tracking the servo. */
+  void end();
+
+  /* Call this periodically from loop(). If the counters have changed, and at
+  least `saveIntervalMillis` has passed since they were last saved, saves them
+  to EEPROM. */
+  void update(uint32_t saveIntervalMillis = 600000UL);
+
+  /* Saves the counters to EEPROM now. Returns false if there was no room, i.e.
+  every record holds the latest counters of some other servo. */
+  bool save();
+
+  /* Prints the counters in human-readable form. */
+  void print(Print &out);
+
+  HitecDOdometerCounters counters;
+
+  virtual void onReadRegister(
+    HitecDServo *servo, uint8_t reg, int res, uint16_t val);
+  virtual void onWriteRegister(
+    HitecDServo *servo, uint8_t reg, uint16_t val);
+
+private:
+  struct Record {
+    uint16_t modelNumber;
+    uint16_t dateCode;
+    uint16_t sequence;
+    HitecDOdometerCounters counters;
+    uint8_t checksum;
+  };
+
+public:
+  static const int eepromRecordSize = sizeof(Record);
+
+private:
+  static uint8_t checksum(const Record &record);
+  bool readRecord(uint8_t index, Record *recordOut);
+  bool isLatestRecord(uint8_t index, const Record &record);
+
+  HitecDServo *servo;
+  int eepromAddress;
+  uint8_t numRecords;
+  uint16_t modelNumber;
+  uint16_t dateCode;
+
+  bool dirty;
+  uint32_t lastSaveMillis;
+
+  int16_t lastAPV;
+  bool lastAPVValid;
+  uint32_t lastPowerMillis;
+  bool lastPowerStalled;
+  int16_t effectivePowerLimit;
+  bool effectivePowerLimitValid;
+  uint32_t rebootWrittenMillis;
+  bool rebootWritten;
+};
+
+#endif /* HitecDOdometer_h */
@@ -0,0 +1,58 @@
+#include "HitecDPackedSettings.h"
+
+#include <string.h>
+
+bool HitecDPackedSettings::operator==(const HitecDPackedSettings &other) const {
+  return memcmp(this, &other, sizeof(HitecDPackedSettings)) == 0;
+}
+
+uint16_t HitecDPackedSettings::diff(const HitecDPackedSettings &other) const {
+  if (*this == other) {
+    return 0;
+  }
+
+  uint16_t mask = 0;
+  if (id != other.id) {
+    mask |= HITECD_FIELD_ID;
+  }
+  if (counterclockwise != other.counterclockwise) {
+    mask |= HITECD_FIELD_COUNTERCLOCKWISE;
+  }
+  if (speedCode != other.speedCode) {
+    mask |= HITECD_FIELD_SPEED;
+  }
+  if (deadbandCode != other.deadbandCode) {
+    mask |= HITECD_FIELD_DEADBAND;
+  }
+  if (softStartCode != other.softStartCode) {
+    mask |= HITECD_FIELD_SOFT_START;
+  }
+  if (rangeLeftCode != other.rangeLeftCode) {
+    mask |= HITECD_FIELD_RANGE_LEFT_APV;
+  }
+  if (rangeRightCode != other.rangeRightCode) {
+    mask |= HITECD_FIELD_RANGE_RIGHT_APV;
+  }
+  if (rangeCenterCode != other.rangeCenterCode) {
+    mask |= HITECD_FIELD_RANGE_CENTER_APV;
+  }
+  if (failSafeCode != other.failSafeCode) {
+    mask |= HITECD_FIELD_FAIL_SAFE;
+  }
+  if (failSafeLimp != other.failSafeLimp) {
+    mask |= HITECD_FIELD_FAIL_SAFE_LIMP;
+  }
+  if (powerLimit != other.powerLimit) {
+    mask |= HITECD_FIELD_POWER_LIMIT;
+  }
+  if (overloadProtectionCode != other.overloadProtectionCode) {
+    mask |= HITECD_FIELD_OVERLOAD_PROTECTION;
+  }
+  if (smartSense != other.smartSense) {
+    mask |= HITECD_FIELD_SMART_SENSE;
+  }
+  if (sensitivityRatio != other.sensitivityRatio) {
+    mask |= HITECD_FIELD_SENSITIVITY_RATIO;
+  }
+  return mask;
+}
@@ -0,0 +1,140 @@
+#ifndef HitecDPackedSettings_h
+#define HitecDPackedSettings_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDPackedSettings stores a HitecDSettings in 14 bytes instead of 20, for
+sketches that keep settings for many servos in SRAM or EEPROM. Most settings
+only have a handful of legal values, so each one is stored as a small code:
+
+    Field               Code                              Bits
+    id                  id                                8
+    counterclockwise    counterclockwise                  1
+    speed               speed / 10 - 1                    4
+    deadband            deadband - 1                      4
+    softStart           softStart / 20 - 1                3
+    range*APV           APV + 1 (so -1 is stored as 0)    15 each
+    failSafe            0, or failSafe - 849              11
+    failSafeLimp        failSafeLimp                      1
+    powerLimit          powerLimit                        7
+    overloadProtection  0 for 100, else value / 10        3
+    smartSense          smartSense                        1
+    sensitivityRatio    sensitivityRatio                  12
+
+Only legal settings (as documented in HitecDSettings.h) can be packed; anything
+else comes back garbled. Settings returned by readSettings() are always legal.
+
+Every bit of the struct is initialized, with no padding, so two packed settings
+can be compared as plain bytes. Packing and unpacking are constexpr, so a table
+of packed settings can be built at compile time, e.g.:
+
+    const HitecDPackedSettings armSettings[] PROGMEM = {
+      HitecDPackedSettings(HitecDSettings().withId(1).withSpeed(50)),
+      HitecDPackedSettings(HitecDSettings().withId(2).withSpeed(50)),
+    };
+*/
+struct HitecDPackedSettings {
+  /* Packs the factory-default settings. */
+  constexpr HitecDPackedSettings() :
+    HitecDPackedSettings(HitecDSettings())
+  { }
+
+  constexpr explicit HitecDPackedSettings(const HitecDSettings &s) :
+    id(s.id),
+    counterclockwise(s.counterclockwise),
+    speedCode(s.speed / 10 - 1),
+    softStartCode(s.softStart / 20 - 1),
+    rangeLeftCode(s.rangeLeftAPV + 1),
+    smartSense(s.smartSense),
+    rangeRightCode(s.rangeRightAPV + 1),
+    failSafeLimp(s.failSafeLimp),
+    rangeCenterCode(s.rangeCenterAPV + 1),
+    reserved1(0),
+    failSafeCode((s.failSafe == 0) ? 0 : s.failSafe - 849),
+    deadbandCode(s.deadband - 1),
+    reserved2(0),
+    sensitivityRatio(s.sensitivityRatio),
+    overloadProtectionCode(
+      (s.overloadProtection == 100) ? 0 : s.overloadProtection / 10),
+    reserved3(0),
+    powerLimit(s.powerLimit),
+    reserved4(0)
+  { }
+
+  constexpr HitecDSettings unpack() const {
+    return HitecDSettings(
+      id,
+      counterclockwise,
+      (speedCode + 1) * 10,
+      deadbandCode + 1,
+      (softStartCode + 1) * 20,
+      (int16_t)rangeLeftCode - 1,
+      (int16_t)rangeRightCode - 1,
+      (int16_t)rangeCenterCode - 1,
+      (failSafeCode == 0) ? 0 : failSafeCode + 849,
+      failSafeLimp,
+      powerLimit,
+      (overloadProtectionCode == 0) ? 100 : overloadProtectionCode * 10,
+      smartSense,
+      sensitivityRatio);
+  }
+
+  bool operator==(const HitecDPackedSettings &other) const;
+  bool operator!=(const HitecDPackedSettings &other) const {
+    return !(*this == other);
+  }
+
+  /* Returns a mask of HITECD_FIELD_* bits, with a bit set for each setting
+  that differs between `*this` and `other`. Returns 0 if they're equal. */
+  uint16_t diff(const HitecDPackedSettings &other) const;
+
+  /* The fields are grouped into 16-bit units, so that the layout is the same
+  on every compiler, including the host-side tools. */
+  uint16_t id : 8;
+  uint16_t counterclockwise : 1;
+  uint16_t speedCode : 4;
+  uint16_t softStartCode : 3;
+
+  uint16_t rangeLeftCode : 15;
+  uint16_t smartSense : 1;
+
+  uint16_t rangeRightCode : 15;
+  uint16_t failSafeLimp : 1;
+
+  uint16_t rangeCenterCode : 15;
+  uint16_t reserved1 : 1;
+
+  uint16_t failSafeCode : 11;
+  uint16_t deadbandCode : 4;
+  uint16_t reserved2 : 1;
+
+  uint16_t sensitivityRatio : 12;
+  uint16_t overloadProtectionCode : 3;
+  uint16_t reserved3 : 1;
+
+  uint16_t powerLimit : 7;
+  uint16_t reserved4 : 9;
+};
+
+static_assert(sizeof(HitecDPackedSettings) == 14,
+  "HitecDPackedSettings should have no padding");
+
+/* Bits returned by HitecDPackedSettings::diff(). */
+#define HITECD_FIELD_ID 0x0001
+#define HITECD_FIELD_COUNTERCLOCKWISE 0x0002
+#define HITECD_FIELD_SPEED 0x0004
+#define HITECD_FIELD_DEADBAND 0x0008
+#define HITECD_FIELD_SOFT_START 0x0010
+#define HITECD_FIELD_RANGE_LEFT_APV 0x0020
+#define HITECD_FIELD_RANGE_RIGHT_APV 0x0040
+#define HITECD_FIELD_RANGE_CENTER_APV 0x0080
+#define HITECD_FIELD_FAIL_SAFE 0x0100
+#define HITECD_FIELD_FAIL_SAFE_LIMP 0x0200
+#define HITECD_FIELD_POWER_LIMIT 0x0400
+#define HITECD_FIELD_OVERLOAD_PROTECTION 0x0800
+#define HITECD_FIELD_SMART_SENSE 0x1000
+#define HITECD_FIELD_SENSITIVITY_RATIO 0x2000
+
+#endif /* HitecDPackedSettings_h */
@@ -0,0 +1,245 @@
+#include "HitecDPositionTrigger.h"
+
+#include "HitecDServoInternal.h"
+
+/* Threshold flags, in addition to HITECD_TRIGGER_RISING/FALLING. A threshold
+is armed in a direction once the servo is clearly on the near side of it. */
+#define ARMED_RISING 0x04
+#define ARMED_FALLING 0x08
+/* Set until the threshold has seen its first sample. */
+#define NEEDS_ARMING 0x10
+
+/* For the first couple of samples after a new target is written, the measured
+speed doesn't reflect the new move yet. */
+#define SAMPLES_TO_MEASURE_SPEED 2
+
+HitecDPositionTrigger::HitecDPositionTrigger() :
+  servo(NULL),
+  maxLatenessMillis(20),
+  idleMillis(250),
+  haveSample(false),
+  lastAPV(0),
+  lastSampleMillis(0),
+  velocity(0),
+  haveTarget(false),
+  targetAPV(0),
+  samplesSinceTarget(0),
+  nextPollMillis(0),
+  polls(0)
+{
+  for (int i = 0; i < HITECD_TRIGGER_MAX_THRESHOLDS; ++i) {
+    thresholds[i].flags = 0;
+  }
+}
+
+void HitecDPositionTrigger::begin(
+  HitecDServo *_servo,
+  uint16_t _maxLatenessMillis,
+  uint16_t _idleMillis
+) {
+  end();
+  servo = _servo;
+  maxLatenessMillis = _maxLatenessMillis;
+  idleMillis = _idleMillis;
+  haveSample = false;
+  velocity = 0;
+  haveTarget = false;
+  samplesSinceTarget = 0;
+  nextPollMillis = millis();
+  polls = 0;
+  servo->addListener(this);
+}
+
+void HitecDPositionTrigger::end() {
+  if (servo != NULL) {
+    servo->removeListener(this);
+    servo = NULL;
+  }
+}
+
+int HitecDPositionTrigger::addThreshold(
+  int16_t apv,
+  uint8_t directions,
+  HitecDTriggerCallback callback
+) {
+  for (int i = 0; i < HITECD_TRIGGER_MAX_THRESHOLDS; ++i) {
+    Threshold *t = &thresholds[i];
+    if ((t->flags & HITECD_TRIGGER_EITHER) != 0) {
+      continue;
+    }
+    t->apv = apv;
+    t->flags = (directions & HITECD_TRIGGER_EITHER) | NEEDS_ARMING;
+    t->callback = callback;
+    if (haveSample) {
+      arm(t, true);
+    }
+    /* The new threshold might be close, so reconsider when to poll. */
+    nextPollMillis = millis();
+    return i;
+  }
+  return -1;
+}
+
+void HitecDPositionTrigger::removeThreshold(int threshold) {
+  thresholds[threshold].flags = 0;
+}
+
+void HitecDPositionTrigger::poll() {
+  if (servo == NULL) {
+    return;
+  }
+  if ((int32_t)(millis() - nextPollMillis) < 0) {
+    return;
+  }
+  ++polls;
+  /* The sample is recorded by onReadRegister(). If the read fails, try again
+  after the usual interval rather than immediately. */
+  nextPollMillis = millis() + maxLatenessMillis;
+  servo->readCurrentAPV();
+}
+
+void HitecDPositionTrigger::onReadRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  int res,
+  uint16_t val
+) {
+  if (reg == HD_REG_CURRENT_APV && res == HITECD_OK) {
+    recordSample(val);
+  }
+}
+
+void HitecDPositionTrigger::onWriteRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  uint16_t val
+) {
+  if (reg != HD_REG_TARGET) {
+    return;
+  }
+  int16_t newTargetAPV = servo->quarterMicrosToAPV(val + 3000);
+  if (haveTarget && newTargetAPV == targetAPV) {
+    return;
+  }
+  haveTarget = true;
+  targetAPV = newTargetAPV;
+  samplesSinceTarget = 0;
+
+  /* The servo may now head for a threshold, so poll sooner if necessary; but
+  don't postpone a poll that's already due. */
+  uint32_t pollMillis = millis() + millisUntilNextPoll();
+  if ((int32_t)(pollMillis - nextPollMillis) < 0) {
+    nextPollMillis = pollMillis;
+  }
+}
+
+void HitecDPositionTrigger::arm(Threshold *t, bool initial) {
+  /* At first, arm on whichever side the servo is; after that, require it to
+  clear the hysteresis band. */
+  int16_t margin = initial ? 1 : HITECD_TRIGGER_HYSTERESIS_APV;
+  if (lastAPV <= t->apv - margin) {
+    t->flags |= ARMED_RISING;
+  }
+  if (lastAPV >= t->apv + margin) {
+    t->flags |= ARMED_FALLING;
+  }
+  t->flags &= ~NEEDS_ARMING;
+}
+
+void HitecDPositionTrigger::recordSample(int16_t apv) {
+  uint32_t nowMillis = millis();
+  uint32_t dt = nowMillis - lastSampleMillis;
+
+  if (haveSample && dt > 0) {
+    velocity = (int32_t)(apv - lastAPV) * 1000 / (int32_t)dt;
+  }
+  if (samplesSinceTarget < SAMPLES_TO_MEASURE_SPEED) {
+    ++samplesSinceTarget;
+  }
+
+  for (int i = 0; i < HITECD_TRIGGER_MAX_THRESHOLDS; ++i) {
+    Threshold *t = &thresholds[i];
+    if ((t->flags & HITECD_TRIGGER_EITHER) == 0 ||
+        (t->flags & NEEDS_ARMING) != 0) {
+      continue;
+    }
+
+    bool rising;
+    if ((t->flags & ARMED_RISING) && apv >= t->apv) {
+      rising = true;
+      t->flags &= ~ARMED_RISING;
+    } else if ((t->flags & ARMED_FALLING) && apv <= t->apv) {
+      rising = false;
+      t->flags &= ~ARMED_FALLING;
+    } else {
+      continue;
+    }
+    if ((t->flags & (rising ? HITECD_TRIGGER_RISING : HITECD_TRIGGER_FALLING))
+        == 0) {
+      continue;
+    }
+
+    /* Armed means the previous sample was on the other side, so this doesn't
+    divide by zero. */
+    uint32_t crossingMillis = lastSampleMillis +
+      (int32_t)(t->apv - lastAPV) * (int32_t)dt / (apv - lastAPV);
+    t->callback(this, i, rising, nowMillis - crossingMillis);
+  }
+
+  haveSample = true;
+  lastAPV = apv;
+  lastSampleMillis = nowMillis;
+  for (int i = 0; i < HITECD_TRIGGER_MAX_THRESHOLDS; ++i) {
+    if ((thresholds[i].flags & HITECD_TRIGGER_EITHER) != 0) {
+      arm(&thresholds[i], (thresholds[i].flags & NEEDS_ARMING) != 0);
+    }
+  }
+
+  nextPollMillis = nowMillis + millisUntilNextPoll();
+}
+
+uint16_t HitecDPositionTrigger::millisUntilNextPoll() {
+  if (!haveSample) {
+    return 0;
+  }
+
+  /* Which way could the servo be going? */
+  bool up, down;
+  if (haveTarget) {
+    up = targetAPV > lastAPV + HITECD_TRIGGER_HYSTERESIS_APV;
+    down = targetAPV < lastAPV - HITECD_TRIGGER_HYSTERESIS_APV;
+  } else {
+    up = velocity > 0;
+    down = velocity < 0;
+  }
+
+  int32_t speed = HITECD_TRIGGER_MAX_SPEED;
+  if (samplesSinceTarget >= SAMPLES_TO_MEASURE_SPEED) {
+    speed = min(abs(velocity) + HITECD_TRIGGER_SPEED_SLACK, speed);
+  }
+
+  /* Find the soonest that any armed threshold could be crossed. */
+  uint32_t soonestMillis = 0xFFFFFFFF;
+  for (int i = 0; i < HITECD_TRIGGER_MAX_THRESHOLDS; ++i) {
+    const Threshold *t = &thresholds[i];
+    int32_t distance;
+    if (up && (t->flags & ARMED_RISING) && (t->flags & HITECD_TRIGGER_RISING) &&
+        (!haveTarget || t->apv <= targetAPV + HITECD_TRIGGER_HYSTERESIS_APV)) {
+      distance = t->apv - lastAPV;
+    } else if (down && (t->flags & ARMED_FALLING) &&
+        (t->flags & HITECD_TRIGGER_FALLING) &&
+        (!haveTarget || t->apv >= targetAPV - HITECD_TRIGGER_HYSTERESIS_APV)) {
+      distance = lastAPV - t->apv;
+    } else {
+      continue;
+    }
+    uint32_t crossingMillis = distance * 1000 / speed;
+    soonestMillis = min(soonestMillis, crossingMillis);
+  }
+
+  if (soonestMillis == 0xFFFFFFFF) {
+    return idleMillis;
+  }
+  uint32_t waitMillis = max(soonestMillis / 2, (uint32_t)maxLatenessMillis);
+  return min(waitMillis, (uint32_t)idleMillis);
+}
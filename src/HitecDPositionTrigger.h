@@ -0,0 +1,147 @@
+#ifndef HitecDPositionTrigger_h
+#define HitecDPositionTrigger_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDPositionTrigger calls a function when the servo passes a given
+position, e.g. to fire a camera or start a second axis. For example:
+
+    HitecDPositionTrigger trigger;
+
+    void onHalfway(HitecDPositionTrigger *trigger, int threshold, bool rising,
+        uint16_t latenessMillis) {
+      digitalWrite(cameraPin, HIGH);
+    }
+
+    void setup() {
+      ...
+      trigger.begin(&servo);
+      trigger.addThreshold(8000, HITECD_TRIGGER_RISING, onHalfway);
+    }
+
+    void loop() {
+      trigger.poll();
+      ...
+    }
+
+Instead of reading the position continuously, poll() predicts when the next
+threshold will be crossed, and only reads the position often when that time is
+near. The prediction uses the servo's recent speed, and the target from the
+latest writeTargetMicroseconds() or writeTargetQuarterMicros(). If the target
+doesn't lie beyond any threshold, the trigger only checks in every `idleMillis`,
+in case something else moves the servo.
+
+Each poll halves the remaining time until the earliest the threshold could be
+reached, until it's within `maxLatenessMillis`; from then on, the servo is
+polled every `maxLatenessMillis`. The earliest time is estimated by assuming
+that the servo might speed up by HITECD_TRIGGER_SPEED_SLACK, or move at
+HITECD_TRIGGER_MAX_SPEED just after a new target is written. As long as the
+servo doesn't move faster than that, each callback comes at most
+`maxLatenessMillis` plus one register read (about 18ms) after the crossing. The
+callback is told how late it is, estimated by interpolating between the
+samples on either side of the crossing.
+
+Like HitecDRecorder, the trigger listens in on the sketch's own calls to
+readCurrentAPV(), and counts those as samples too. The servo's range settings
+must be up to date (see HitecDServo::quarterMicrosToAPV()). */
+
+/* Maximum number of thresholds per trigger. */
+#define HITECD_TRIGGER_MAX_THRESHOLDS 4
+
+/* Directions for addThreshold(). "Rising" means increasing APV. */
+#define HITECD_TRIGGER_RISING 0x01
+#define HITECD_TRIGGER_FALLING 0x02
+#define HITECD_TRIGGER_EITHER \
+  (HITECD_TRIGGER_RISING | HITECD_TRIGGER_FALLING)
+
+/* After a threshold fires in one direction, the servo must go back past the
+threshold by this many APV before it can fire in that direction again. This
+keeps noise from firing the threshold repeatedly while the servo sits on it. */
+#define HITECD_TRIGGER_HYSTERESIS_APV 16
+
+/* Assumed top speed, in APV per second, before the servo's actual speed is
+known. This is faster than any D-series servo at 100% speed. */
+#define HITECD_TRIGGER_MAX_SPEED 30000
+
+/* How much faster than its last measured speed the servo is assumed to
+possibly be moving, in APV per second. */
+#define HITECD_TRIGGER_SPEED_SLACK 2000
+
+class HitecDPositionTrigger;
+
+typedef void (*HitecDTriggerCallback)(
+  HitecDPositionTrigger *trigger,
+  int threshold,
+  bool rising,
+  uint16_t latenessMillis);
+
+class HitecDPositionTrigger : public HitecDListener {
+public:
+  HitecDPositionTrigger();
+
+  /* Starts watching the given servo. */
+  void begin(
+    HitecDServo *servo,
+    uint16_t maxLatenessMillis = 20,
+    uint16_t idleMillis = 250);
+
+  /* Stops watching, and detaches from the servo. */
+  void end();
+
+  /* Calls `callback` whenever the servo passes `apv` in the given direction(s).
+  Returns an index that identifies the threshold, or -1 if there are already
+  HITECD_TRIGGER_MAX_THRESHOLDS thresholds. */
+  int addThreshold(int16_t apv, uint8_t directions,
+    HitecDTriggerCallback callback);
+
+  void removeThreshold(int threshold);
+
+  /* Reads the servo's position if it's time to. Call this as often as possible
+  from loop(). Callbacks are called from inside poll() (or from inside the
+  sketch's own readCurrentAPV() calls), so they shouldn't talk to this servo
+  themselves. */
+  void poll();
+
+  /* Number of times poll() has read the servo's position. */
+  uint32_t numPolls() { return polls; }
+
+  virtual void onReadRegister(
+    HitecDServo *servo, uint8_t reg, int res, uint16_t val);
+  virtual void onWriteRegister(
+    HitecDServo *servo, uint8_t reg, uint16_t val);
+
+private:
+  struct Threshold {
+    int16_t apv;
+    /* HITECD_TRIGGER_RISING/FALLING, plus the ARMED_* flags in the .cpp */
+    uint8_t flags;
+    HitecDTriggerCallback callback;
+  };
+
+  void recordSample(int16_t apv);
+  void arm(Threshold *threshold, bool initial);
+  uint16_t millisUntilNextPoll();
+
+  HitecDServo *servo;
+  uint16_t maxLatenessMillis, idleMillis;
+  Threshold thresholds[HITECD_TRIGGER_MAX_THRESHOLDS];
+
+  bool haveSample;
+  int16_t lastAPV;
+  uint32_t lastSampleMillis;
+  /* In APV per second */
+  int32_t velocity;
+
+  bool haveTarget;
+  int16_t targetAPV;
+
+  /* Number of samples since the target last changed. */
+  uint8_t samplesSinceTarget;
+
+  uint32_t nextPollMillis;
+  uint32_t polls;
+};
+
+#endif /* HitecDPositionTrigger_h */
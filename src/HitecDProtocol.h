@@ -0,0 +1,132 @@
+#ifndef HitecDProtocol_h
+#define HitecDProtocol_h
+
+#include <stdint.h>
+
+/* Error codes, frame encoding, and timing that are shared between the Arduino
+library and the host-side library in extras/host. Nothing in here depends on
+Arduino, so it can be compiled anywhere. See HitecDServoInternal.h for a
+description of the frames themselves. */
+
+/* Many of the functions in this library return error codes. The possible error
+codes are as follows: */
+
+/* OK (no error occurred) */
+#define HITECD_OK 1
+
+/* attach() was not called, or the call to attach() failed. */
+#define HITECD_ERR_NOT_ATTACHED (-101)
+
+/* No servo detected. */
+#define HITECD_ERR_NO_SERVO (-102)
+
+/* Either the servo is still booting, which takes 1000ms; or the pullup resistor
+is missing. With a 5V microcontroller, use a 2k pullup resistor to +5V. With a
+3.3V microcontroller, use a 1k pullup resistor to +3.3V. */
+#define HITECD_ERR_BOOTING_OR_NO_PULLUP (-103)
+
+/* Corrupt response from servo. */
+#define HITECD_ERR_CORRUPT (-104)
+
+/* Unsupported model of servo. (Only D485HW is fully supported.) */
+#define HITECD_ERR_UNSUPPORTED_MODEL (-105)
+
+/* Confusing response from servo. */
+#define HITECD_ERR_CONFUSED (-106)
+
+/* The following are more specific versions of HITECD_ERR_BOOTING_OR_NO_PULLUP,
+reported by attach() (through its `diagnosisOut` parameter) and diagnoseLine()
+when they can tell which it is. */
+
+/* The servo is still booting, which takes 1000ms. */
+#define HITECD_ERR_BOOTING (-107)
+
+/* The pullup resistor is missing. With a 5V microcontroller, use a 2k pullup
+resistor to +5V. With a 3.3V microcontroller, use a 1k pullup resistor to +3.3V.
+*/
+#define HITECD_ERR_NO_PULLUP (-108)
+
+/* The pullup resistor is too weak (too many ohms), so the line is close to the
+logic threshold or rises too slowly. This causes intermittent
+HITECD_ERR_CORRUPT errors. */
+#define HITECD_ERR_WEAK_PULLUP (-109)
+
+/* The pullup resistor is too strong (too few ohms), so the servo can't pull the
+line low enough. */
+#define HITECD_ERR_STRONG_PULLUP (-110)
+
+/* Frame lengths, in bytes. */
+#define HD_READ_COMMAND_LENGTH 5
+#define HD_WRITE_COMMAND_LENGTH 7
+#define HD_RESPONSE_LENGTH 7
+
+/* First byte of every frame sent to the servo, and of every response. */
+#define HD_COMMAND_SYNC 0x96
+#define HD_RESPONSE_SYNC 0x69
+
+/* How long each transaction ties up the line. (The library bit-bangs the
+protocol synchronously, so this is also how long it ties up the CPU.) These are
+derived from the notes in HitecDServoInternal.h plus the delays in
+HitecDServo.cpp, rounded up slightly. */
+
+/* Each byte is a start bit, 8 data bits, and a stop bit at 115200 baud. */
+#define HD_BYTE_MICROS 87
+
+/* The servo starts its response 15.2ms after the end of the programmer's
+transmission. */
+#define HD_TURNAROUND_MICROS 15200
+
+/* A write is 7 bytes, followed by a 1ms delay. */
+#define HD_WRITE_MICROS (7 * HD_BYTE_MICROS + 1000)
+
+/* A read is 5 bytes out, the turnaround, 7 bytes back, and then 2ms of delays
+while the line settles. */
+#define HD_READ_MICROS \
+  (5 * HD_BYTE_MICROS + HD_TURNAROUND_MICROS + 7 * HD_BYTE_MICROS + 2000)
+
+/* Fills in `out` with the command to read register `reg`. */
+inline void hitecdEncodeReadCommand(uint8_t reg, uint8_t *out) {
+  out[0] = HD_COMMAND_SYNC;
+  out[1] = 0x00;
+  out[2] = reg;
+  out[3] = 0x00;
+  out[4] = (0x00 + reg + 0x00) & 0xFF;
+}
+
+/* Fills in `out` with the command to write `val` to register `reg`. */
+inline void hitecdEncodeWriteCommand(uint8_t reg, uint16_t val, uint8_t *out) {
+  uint8_t low = val & 0xFF;
+  uint8_t high = (val >> 8) & 0xFF;
+  out[0] = HD_COMMAND_SYNC;
+  out[1] = 0x00;
+  out[2] = reg;
+  out[3] = 0x02;
+  out[4] = low;
+  out[5] = high;
+  out[6] = (0x00 + reg + 0x02 + low + high) & 0xFF;
+}
+
+/* Checks the servo's response to a read of register `reg`. The bytes are ints
+so that a byte that was never received can be passed as a negative number.
+Returns HITECD_OK and sets `*valOut`, or returns HITECD_ERR_CORRUPT. */
+inline int hitecdDecodeResponse(
+  uint8_t reg,
+  const int *bytes,
+  uint16_t *valOut
+) {
+  for (int i = 0; i < HD_RESPONSE_LENGTH; ++i) {
+    if (bytes[i] < 0) return HITECD_ERR_CORRUPT;
+  }
+  /* bytes[1] is the "mystery byte"; see HitecDServoInternal.h. */
+  if (bytes[0] != HD_RESPONSE_SYNC) return HITECD_ERR_CORRUPT;
+  if (bytes[2] != reg) return HITECD_ERR_CORRUPT;
+  if (bytes[3] != 0x02) return HITECD_ERR_CORRUPT;
+  if (bytes[6] != ((bytes[1] + bytes[2] + bytes[3] + bytes[4] + bytes[5])
+      & 0xFF)) {
+    return HITECD_ERR_CORRUPT;
+  }
+  *valOut = bytes[4] + (bytes[5] << 8);
+  return HITECD_OK;
+}
+
+#endif /* HitecDProtocol_h */
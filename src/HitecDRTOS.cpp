@@ -0,0 +1,87 @@
+#include "HitecDRTOS.h"
+
+#include "HitecDServo.h"
+
+#ifdef HITECD_RTOS
+
+void hitecdSleepMillis(uint16_t ms) {
+  /* vTaskDelay(n) wakes at the n-th tick from now, which is n-1 to n tick
+  periods away. So sleeping for as many whole periods as fit in `ms` never
+  overshoots; then busy-wait the rest precisely. If no whole period fits, or the
+  scheduler isn't running yet, this is all busy-wait. (We poll micros() rather
+  than calling delay(), since Arduino_FreeRTOS can be configured to turn delay()
+  into vTaskDelay(), which would round the wait down to whole ticks.) */
+  uint32_t startMicros = micros();
+  if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+    TickType_t ticks = ms / portTICK_PERIOD_MS;
+    if (ticks > 0) {
+      vTaskDelay(ticks);
+    }
+  }
+  while (micros() - startMicros < 1000 * (uint32_t)ms) { }
+}
+
+void hitecdYield() {
+  if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+    vTaskDelay(1);
+  }
+}
+
+HitecDJobQueue::HitecDJobQueue() : queue(NULL) { }
+
+bool HitecDJobQueue::begin(
+  UBaseType_t length,
+  UBaseType_t priority,
+  uint16_t stackDepth
+) {
+  queue = xQueueCreate(length, sizeof(HitecDJob *));
+  if (queue == NULL) {
+    return false;
+  }
+  if (xTaskCreate(workerTask, "HitecD", stackDepth, this, priority, NULL)
+      != pdPASS) {
+    vQueueDelete(queue);
+    queue = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool HitecDJobQueue::submit(HitecDJob *job, TickType_t timeout) {
+  job->notifyTask = xTaskGetCurrentTaskHandle();
+  return xQueueSend(queue, &job, timeout) == pdTRUE;
+}
+
+int HitecDJobQueue::waitForCompletion(HitecDJob *job, TickType_t timeout) {
+  if (ulTaskNotifyTake(pdFALSE, timeout) == 0) {
+    return HITECD_ERR_CONFUSED;
+  }
+  return job->result;
+}
+
+void HitecDJobQueue::workerTask(void *param) {
+  HitecDJobQueue *self = (HitecDJobQueue *)param;
+  while (true) {
+    HitecDJob *job;
+    if (xQueueReceive(self->queue, &job, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    if (job->op == HITECD_JOB_READ) {
+      job->result = job->servo->readRawRegister(job->reg, &job->val);
+    } else {
+      job->servo->writeRawRegister(job->reg, job->val);
+      job->result = HITECD_OK;
+    }
+    xTaskNotifyGive(job->notifyTask);
+  }
+}
+
+#else
+
+void hitecdSleepMillis(uint16_t ms) {
+  delay(ms);
+}
+
+void hitecdYield() { }
+
+#endif /* HITECD_RTOS */
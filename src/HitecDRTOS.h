@@ -0,0 +1,127 @@
+#ifndef HitecDRTOS_h
+#define HitecDRTOS_h
+
+#include <Arduino.h>
+
+/* Optional FreeRTOS support.
+
+If the sketch includes <Arduino_FreeRTOS.h>, the library detects it and becomes
+safe to use from several tasks:
+- Each HitecDServo has a lock, so tasks sharing a servo take turns. Multi-step
+  operations like writeSettings() hold the lock throughout, so another task
+  can't sneak a write into the middle. Use lockBus() and unlockBus() to group
+  your own operations in the same way.
+- The long waits inside the protocol (the 14ms wait in the middle of each read)
+  sleep the task for as many whole ticks as fit, so other tasks can run, and
+  then busy-wait the rest of the way. If a tick is longer than the wait, as
+  Arduino_FreeRTOS's default 15ms watchdog tick is, the wait is a plain
+  busy-wait, the same as without FreeRTOS. The locks and HitecDJobQueue work
+  either way. With a tick of 7ms or less, each read sleeps for at least 7ms of
+  its 14ms wait.
+- HitecDJobQueue runs protocol operations on a worker task, and notifies the
+  submitting task when each one completes.
+Interrupts are still disabled while each frame is on the wire (up to about
+0.6ms), because the bit-banged serial timing can't tolerate interruptions.
+
+The servo answers a read exactly 15.2ms after the request, whether or not the
+task is listening. If a higher-priority task is still running at that point, the
+read fails with an error. So give tasks that talk to servos (or the
+HitecDJobQueue worker) a high priority.
+
+To opt out even though FreeRTOS is present, compile the library with
+HITECD_NO_RTOS defined. HitecDServo has the same layout either way, so it's safe
+if only some files see the definition. */
+
+#if !defined(HITECD_NO_RTOS) && defined(__has_include)
+#if __has_include(<Arduino_FreeRTOS.h>)
+#define HITECD_RTOS
+#include <Arduino_FreeRTOS.h>
+#include <queue.h>
+#include <semphr.h>
+#include <task.h>
+#endif
+#endif
+
+/* Waits for the given time. With FreeRTOS, sleeps the task for as much of it
+as possible; otherwise this is the same as delay(). */
+void hitecdSleepMillis(uint16_t ms);
+
+/* Lets other tasks run during a polling loop, by sleeping for one tick. Does
+nothing without FreeRTOS. */
+void hitecdYield();
+
+#ifdef HITECD_RTOS
+
+class HitecDServo;
+
+#define HITECD_JOB_READ 0
+#define HITECD_JOB_WRITE 1
+
+struct HitecDJob {
+  HitecDServo *servo;
+
+  /* HITECD_JOB_READ or HITECD_JOB_WRITE */
+  uint8_t op;
+
+  uint8_t reg;
+
+  /* The value to write; or, for a read, the value that was read. */
+  uint16_t val;
+
+  /* Set when the job completes: the result of readRawRegister(), or HITECD_OK
+  for a write. */
+  int result;
+
+  /* Set by submit(). */
+  TaskHandle_t notifyTask;
+};
+
+/* HitecDJobQueue runs raw register reads and writes on a dedicated worker
+task. For example:
+
+    HitecDJobQueue jobs;    // global
+    ...
+    jobs.begin();           // in setup()
+    ...
+    HitecDJob job;          // in some task
+    job.servo = &servo;
+    job.op = HITECD_JOB_READ;
+    job.reg = HD_REG_CURRENT_APV;
+    jobs.submit(&job);
+    ... do other work ...
+    if (HitecDJobQueue::waitForCompletion(&job) == HITECD_OK) { use job.val }
+
+Jobs run one at a time, in the order they were submitted. To talk to servos on
+different pins in parallel, use one queue per pin. The job must stay valid until
+it completes. */
+class HitecDJobQueue {
+public:
+  HitecDJobQueue();
+
+  /* Creates the queue and its worker task. Returns false if there wasn't
+  enough memory. */
+  bool begin(
+    UBaseType_t length = 8,
+    UBaseType_t priority = tskIDLE_PRIORITY + 2,
+    uint16_t stackDepth = 192);
+
+  /* Queues a job. When it completes, the calling task is sent a task
+  notification. Returns false if the queue stayed full for `timeout` ticks. */
+  bool submit(HitecDJob *job, TickType_t timeout = portMAX_DELAY);
+
+  /* Waits for a job submitted by the calling task to complete, and returns its
+  result. Jobs complete in order, so when waiting for several jobs, wait for
+  them in the order they were submitted. Returns HITECD_ERR_CONFUSED on
+  timeout. */
+  static int waitForCompletion(
+    HitecDJob *job, TickType_t timeout = portMAX_DELAY);
+
+private:
+  static void workerTask(void *param);
+
+  QueueHandle_t queue;
+};
+
+#endif /* HITECD_RTOS */
+
+#endif /* HitecDRTOS_h */
@@ -0,0 +1,232 @@
+#include "HitecDRecorder.h"
+
+#include <avr/eeprom.h>
+
+#include "HitecDServoInternal.h"
+
+/* Marks a valid history in EEPROM. */
+#define RECORDER_MAGIC 0xB7
+
+/* Converts `diff` to units of 2**shift, rounding to nearest, and clamps it so it
+fits in an int8_t. */
+static int8_t encodeDelta(int32_t diff, uint8_t shift) {
+  int32_t d = (diff + (1 << (shift - 1))) >> shift;
+  return constrain(d, -127, 127);
+}
+
+HitecDRecorder::HitecDRecorder() :
+  servo(NULL),
+  decimationMillis(20),
+  eepromAddress(-1),
+  latestTargetQuarterMicros(4 * 1500),
+  latestMotorPower(0),
+  latestEffectivePowerLimit(-1),
+  rebootWrittenMillis(0),
+  rebootWritten(false)
+{
+  clear();
+}
+
+void HitecDRecorder::begin(
+  HitecDServo *_servo,
+  uint16_t _decimationMillis,
+  int _eepromAddress
+) {
+  end();
+  servo = _servo;
+  decimationMillis = _decimationMillis;
+  eepromAddress = _eepromAddress;
+  latestTargetQuarterMicros = 4 * 1500;
+  latestMotorPower = 0;
+  latestEffectivePowerLimit = -1;
+  rebootWritten = false;
+  clear();
+  servo->addListener(this);
+}
+
+void HitecDRecorder::end() {
+  if (servo != NULL) {
+    servo->removeListener(this);
+    servo = NULL;
+  }
+}
+
+void HitecDRecorder::freeze(uint8_t reason) {
+  if (state.frozenReason != HITECD_RECORDER_NOT_FROZEN) {
+    return;
+  }
+  state.frozenReason = reason;
+  if (servo != NULL && eepromAddress != -1) {
+    eeprom_update_block(&state, (void *)eepromAddress, sizeof(state));
+  }
+}
+
+void HitecDRecorder::clear() {
+  state.magic = RECORDER_MAGIC;
+  state.frozenReason = HITECD_RECORDER_NOT_FROZEN;
+  state.numSamples = 0;
+  state.newestIndex = 0;
+}
+
+bool HitecDRecorder::loadFromEEPROM(int _eepromAddress) {
+  State loaded;
+  eeprom_read_block(&loaded, (const void *)_eepromAddress, sizeof(loaded));
+  if (loaded.magic != RECORDER_MAGIC ||
+      loaded.numSamples > HITECD_RECORDER_SAMPLES ||
+      loaded.newestIndex >= HITECD_RECORDER_SAMPLES) {
+    return false;
+  }
+  state = loaded;
+  return true;
+}
+
+void HitecDRecorder::record(int16_t currentAPV) {
+  if (state.frozenReason != HITECD_RECORDER_NOT_FROZEN) {
+    return;
+  }
+
+  uint32_t now = millis();
+  HitecDRecorderSample &newest = state.newest;
+
+  if (state.numSamples == 0) {
+    newest.millis = now;
+    newest.currentAPV = currentAPV;
+    newest.targetQuarterMicros = latestTargetQuarterMicros;
+    newest.motorPower = latestMotorPower;
+    state.newestIndex = 0;
+    state.numSamples = 1;
+    return;
+  }
+
+  if (now - newest.millis < decimationMillis) {
+    return;
+  }
+
+  /* Each delta is computed relative to the reconstructed value, not the true
+  previous value, so any error from clamping is corrected by later samples. */
+  Delta d;
+  d.dt = min((now - newest.millis + 2) / 4, (uint32_t)255);
+  newest.millis += 4 * (uint32_t)d.dt;
+  d.dAPV = encodeDelta(currentAPV - newest.currentAPV, 3);
+  newest.currentAPV += 8 * d.dAPV;
+  d.dTarget = encodeDelta(
+    latestTargetQuarterMicros - newest.targetQuarterMicros, 2);
+  newest.targetQuarterMicros += 4 * d.dTarget;
+  d.dPower = encodeDelta(latestMotorPower - newest.motorPower, 4);
+  newest.motorPower += 16 * d.dPower;
+
+  state.newestIndex = (state.newestIndex + 1) % HITECD_RECORDER_SAMPLES;
+  state.deltas[state.newestIndex] = d;
+  if (state.numSamples < HITECD_RECORDER_SAMPLES) {
+    ++state.numSamples;
+  }
+}
+
+void HitecDRecorder::stepBackwards(
+  uint8_t index,
+  HitecDRecorderSample *sample
+) {
+  const Delta &d = state.deltas[index];
+  sample->millis -= 4 * (uint32_t)d.dt;
+  sample->currentAPV -= 8 * d.dAPV;
+  sample->targetQuarterMicros -= 4 * d.dTarget;
+  sample->motorPower -= 16 * d.dPower;
+}
+
+bool HitecDRecorder::getSample(uint8_t index, HitecDRecorderSample *sampleOut) {
+  if (index >= state.numSamples) {
+    return false;
+  }
+  *sampleOut = state.newest;
+  uint8_t i = state.newestIndex;
+  for (uint8_t age = state.numSamples - 1; age > index; --age) {
+    stepBackwards(i, sampleOut);
+    i = (i + HITECD_RECORDER_SAMPLES - 1) % HITECD_RECORDER_SAMPLES;
+  }
+  return true;
+}
+
+void HitecDRecorder::print(Print &out) {
+  out.println(F("millis,currentAPV,targetQuarterMicros,motorPower"));
+  if (state.numSamples == 0) {
+    return;
+  }
+
+  /* Find the oldest sample, then walk forwards. */
+  HitecDRecorderSample sample;
+  getSample(0, &sample);
+  uint8_t i = (state.newestIndex + HITECD_RECORDER_SAMPLES -
+    (state.numSamples - 1)) % HITECD_RECORDER_SAMPLES;
+  for (uint8_t n = 0; n < state.numSamples; ++n) {
+    if (n != 0) {
+      i = (i + 1) % HITECD_RECORDER_SAMPLES;
+      const Delta &d = state.deltas[i];
+      sample.millis += 4 * (uint32_t)d.dt;
+      sample.currentAPV += 8 * d.dAPV;
+      sample.targetQuarterMicros += 4 * d.dTarget;
+      sample.motorPower += 16 * d.dPower;
+    }
+    out.print(sample.millis);
+    out.print(',');
+    out.print(sample.currentAPV);
+    out.print(',');
+    out.print(sample.targetQuarterMicros);
+    out.print(',');
+    out.println(sample.motorPower);
+  }
+}
+
+void HitecDRecorder::onReadRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  int res,
+  uint16_t val
+) {
+  if (res == HITECD_ERR_BOOTING_OR_NO_PULLUP) {
+    /* If the sketch rebooted the servo on purpose, that's not a fault. */
+    if (!rebootWritten || millis() - rebootWrittenMillis > 2000) {
+      freeze(HITECD_RECORDER_FROZEN_BY_REBOOT);
+    }
+    return;
+  }
+  if (res != HITECD_OK) {
+    return;
+  }
+
+  switch (reg) {
+  case HD_REG_CURRENT_APV:
+    record(val);
+    break;
+  case HD_REG_MOTOR_POWER:
+    latestMotorPower = (int16_t)val;
+    break;
+  case HD_REG_EFFECTIVE_POWER_LIMIT:
+    if (latestEffectivePowerLimit != -1 &&
+        (int16_t)val < latestEffectivePowerLimit) {
+      freeze(HITECD_RECORDER_FROZEN_BY_OVERLOAD);
+    }
+    latestEffectivePowerLimit = val;
+    break;
+  }
+}
+
+void HitecDRecorder::onWriteRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  uint16_t val
+) {
+  switch (reg) {
+  case HD_REG_TARGET:
+    latestTargetQuarterMicros = val + 3000;
+    break;
+  case HD_REG_REBOOT:
+    rebootWritten = true;
+    rebootWrittenMillis = millis();
+    break;
+  case HD_REG_POWER_LIMIT:
+    /* The effective power limit is expected to change now, so that doesn't
+    indicate an overload. */
+    latestEffectivePowerLimit = -1;
+    break;
+  }
+}
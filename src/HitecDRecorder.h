@@ -0,0 +1,144 @@
+#ifndef HitecDRecorder_h
+#define HitecDRecorder_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDRecorder is a "black box" flight recorder for one servo. It keeps a
+short history of the servo's position, commanded target, and motor power. If
+something goes wrong, the history is frozen (and optionally saved to the
+Arduino's EEPROM) so it can be inspected afterwards.
+
+The recorder doesn't talk to the servo itself. It listens in on the reads and
+writes that the sketch is already doing:
+- Every time the sketch calls readCurrentAPV(), a sample is recorded (at most
+  once every `decimationMillis`).
+- The commanded target comes from writeTargetMicroseconds() and
+  writeTargetQuarterMicros().
+- The motor power comes from readMotorPower(). If the sketch never calls it,
+  power will be recorded as 0.
+
+The history is frozen automatically if:
+- A read of HD_REG_EFFECTIVE_POWER_LIMIT shows it has dropped, meaning overload
+  protection kicked in.
+- The servo unexpectedly stops responding because it's rebooting (e.g. due to a
+  brown-out).
+It can also be frozen manually by calling freeze().
+
+To save space, samples are stored as small deltas from the previous sample. If
+the servo moves too fast for a delta to represent, the recorded value lags
+behind for a sample or two and then catches up. */
+
+/* Number of samples kept. Each sample takes 4 bytes of SRAM. */
+#define HITECD_RECORDER_SAMPLES 64
+
+/* Reasons for freezing. */
+#define HITECD_RECORDER_NOT_FROZEN 0
+#define HITECD_RECORDER_FROZEN_BY_USER 1
+#define HITECD_RECORDER_FROZEN_BY_OVERLOAD 2
+#define HITECD_RECORDER_FROZEN_BY_REBOOT 3
+
+struct HitecDRecorderSample {
+  /* Value of millis() when the sample was taken. */
+  uint32_t millis;
+
+  /* As returned by readCurrentAPV(). */
+  int16_t currentAPV;
+
+  /* The most recently commanded target, in quarter-microseconds. */
+  int16_t targetQuarterMicros;
+
+  /* As returned by readMotorPower(). */
+  int16_t motorPower;
+};
+
+class HitecDRecorder : public HitecDListener {
+public:
+  HitecDRecorder();
+
+  /* Starts recording the given servo. If `eepromAddress` is not -1, then when
+  the recorder is frozen, the history is written to the Arduino's EEPROM at that
+  address. This takes HitecDRecorder::eepromSize bytes. */
+  void begin(
+    HitecDServo *servo,
+    uint16_t decimationMillis = 20,
+    int eepromAddress = -1);
+
+  /* Stops recording and detaches from the servo. */
+  void end();
+
+  /* Freezes the history and saves it to EEPROM (if configured). Subsequent
+  samples are ignored until clear() is called. */
+  void freeze(uint8_t reason = HITECD_RECORDER_FROZEN_BY_USER);
+
+  /* Returns one of the HITECD_RECORDER_* constants above. */
+  uint8_t frozenReason() { return state.frozenReason; }
+
+  /* Discards the history and starts recording again. */
+  void clear();
+
+  /* Loads a history previously saved to EEPROM, e.g. after the Arduino was
+  reset. Returns false if there's no valid history at that address. */
+  bool loadFromEEPROM(int eepromAddress);
+
+  /* Number of samples currently in the history. */
+  uint8_t numSamples() { return state.numSamples; }
+
+  /* Retrieves a sample from the history. Index 0 is the oldest sample. Returns
+  false, and leaves `sampleOut` alone, if `index` is not less than
+  numSamples(). */
+  bool getSample(uint8_t index, HitecDRecorderSample *sampleOut);
+
+  /* Prints the history as comma-separated values. */
+  void print(Print &out);
+
+  virtual void onReadRegister(
+    HitecDServo *servo, uint8_t reg, int res, uint16_t val);
+  virtual void onWriteRegister(
+    HitecDServo *servo, uint8_t reg, uint16_t val);
+
+private:
+  struct Delta {
+    /* In units of 4ms */
+    uint8_t dt;
+    /* In units of 8 APV */
+    int8_t dAPV;
+    /* In units of 4 quarter-microseconds */
+    int8_t dTarget;
+    /* In units of 16 power units */
+    int8_t dPower;
+  };
+
+  /* Everything in here gets saved to EEPROM. */
+  struct State {
+    uint8_t magic;
+    uint8_t frozenReason;
+    uint8_t numSamples;
+    uint8_t newestIndex;
+    /* The newest sample, as reconstructed from the deltas. Older samples are
+    found by walking backwards from here. */
+    HitecDRecorderSample newest;
+    Delta deltas[HITECD_RECORDER_SAMPLES];
+  } state;
+
+public:
+  /* Number of bytes of EEPROM used to save the history. */
+  static const int eepromSize = sizeof(State);
+
+private:
+  void record(int16_t currentAPV);
+  void stepBackwards(uint8_t index, HitecDRecorderSample *sample);
+
+  HitecDServo *servo;
+  uint16_t decimationMillis;
+  int eepromAddress;
+
+  int16_t latestTargetQuarterMicros;
+  int16_t latestMotorPower;
+  int16_t latestEffectivePowerLimit;
+  uint32_t rebootWrittenMillis;
+  bool rebootWritten;
+};
+
+#endif /* HitecDRecorder_h */
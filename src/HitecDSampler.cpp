@@ -0,0 +1,186 @@
+#include "HitecDSampler.h"
+
+#include "HitecDServoInternal.h"
+
+#define BURST_MICROS ((int32_t)HITECD_SAMPLER_BURST_READS * HD_READ_MICROS)
+
+HitecDSamplerChannel::HitecDSamplerChannel() :
+  currentAPV(-1),
+  sampleMillis(0),
+  intervalMillis(0),
+  sampler(NULL),
+  targetVal(0),
+  targetMillis(0)
+{ }
+
+void HitecDSamplerChannel::onReadRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  int res,
+  uint16_t val
+) {
+  sampler->chargeBudget(HD_READ_MICROS);
+  if (reg == HD_REG_CURRENT_APV && res == HITECD_OK) {
+    sampler->recordSample(this, val);
+  }
+}
+
+void HitecDSamplerChannel::onWriteRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  uint16_t val
+) {
+  sampler->chargeBudget(HD_WRITE_MICROS);
+  if (reg == HD_REG_TARGET) {
+    sampler->recordTarget(this, val);
+  }
+}
+
+HitecDAdaptiveSampler::HitecDAdaptiveSampler(
+  HitecDServo *_servos,
+  HitecDSamplerChannel *_channels,
+  uint8_t _numServos
+) :
+  reads(0),
+  deferrals(0),
+  servos(_servos),
+  channels(_channels),
+  numServos(_numServos),
+  budgetPercent(50),
+  minIntervalMillis(20),
+  maxIntervalMillis(1000),
+  budgetMicros(0),
+  budgetRefillMicros(0),
+  deferring(false)
+{ }
+
+void HitecDAdaptiveSampler::begin(
+  uint8_t _budgetPercent,
+  uint16_t _minIntervalMillis,
+  uint16_t _maxIntervalMillis
+) {
+  end();
+  budgetPercent = constrain(_budgetPercent, 1, 100);
+  minIntervalMillis = _minIntervalMillis;
+  maxIntervalMillis = max(_maxIntervalMillis, _minIntervalMillis);
+  budgetMicros = BURST_MICROS;
+  budgetRefillMicros = micros();
+  reads = 0;
+  deferrals = 0;
+  deferring = false;
+
+  uint32_t nowMillis = millis();
+  for (int i = 0; i < numServos; ++i) {
+    HitecDSamplerChannel *channel = &channels[i];
+    channel->currentAPV = -1;
+    channel->sampleMillis = nowMillis;
+    channel->intervalMillis = 0;
+    channel->targetVal = 0xFFFF;
+    channel->targetMillis = nowMillis;
+    channel->sampler = this;
+    servos[i].addListener(channel);
+  }
+}
+
+void HitecDAdaptiveSampler::end() {
+  for (int i = 0; i < numServos; ++i) {
+    if (channels[i].sampler != NULL) {
+      servos[i].removeListener(&channels[i]);
+      channels[i].sampler = NULL;
+    }
+  }
+}
+
+int HitecDAdaptiveSampler::poll() {
+  /* Earliest deadline first */
+  uint32_t nowMillis = millis();
+  int next = -1;
+  int32_t mostOverdue = 0;
+  for (int i = 0; i < numServos; ++i) {
+    const HitecDSamplerChannel *channel = &channels[i];
+    if (channel->sampler == NULL) {
+      continue;
+    }
+    int32_t overdue = (int32_t)(nowMillis -
+      (channel->sampleMillis + channel->intervalMillis));
+    if (overdue >= mostOverdue) {
+      mostOverdue = overdue;
+      next = i;
+    }
+  }
+  if (next == -1) {
+    return HITECD_OK;
+  }
+
+  refillBudget();
+  if (budgetMicros < (int32_t)HD_READ_MICROS) {
+    if (!deferring) {
+      deferring = true;
+      ++deferrals;
+    }
+    return HITECD_OK;
+  }
+
+  deferring = false;
+  ++reads;
+  int16_t apv = servos[next].readCurrentAPV();
+  if (apv < 0) {
+    /* Don't retry until the usual interval has passed. */
+    channels[next].sampleMillis = millis();
+    return apv;
+  }
+  return HITECD_OK;
+}
+
+void HitecDAdaptiveSampler::refillBudget() {
+  uint32_t nowMicros = micros();
+  uint32_t elapsed = nowMicros - budgetRefillMicros;
+  budgetRefillMicros = nowMicros;
+
+  /* Avoid overflow if poll() hasn't been called for a long time. */
+  elapsed = min(elapsed, (uint32_t)BURST_MICROS * 100);
+  budgetMicros += elapsed * budgetPercent / 100;
+  budgetMicros = min(budgetMicros, BURST_MICROS);
+}
+
+void HitecDAdaptiveSampler::chargeBudget(uint32_t busMicros) {
+  refillBudget();
+  /* Don't let a burst of the sketch's own traffic starve the sampler forever;
+  it can only push the budget one burst into debt. */
+  budgetMicros = max(budgetMicros - (int32_t)busMicros, -BURST_MICROS);
+}
+
+void HitecDAdaptiveSampler::recordSample(
+  HitecDSamplerChannel *channel,
+  int16_t apv
+) {
+  uint32_t nowMillis = millis();
+  bool still = channel->currentAPV != -1 &&
+    abs(apv - channel->currentAPV) <= HITECD_SAMPLER_STILL_APV;
+  bool recentTarget =
+    nowMillis - channel->targetMillis < HITECD_SAMPLER_TARGET_HOLD_MILLIS;
+
+  if (still && !recentTarget) {
+    uint32_t interval = max((uint32_t)channel->intervalMillis * 2,
+      (uint32_t)minIntervalMillis);
+    channel->intervalMillis = min(interval, (uint32_t)maxIntervalMillis);
+  } else {
+    channel->intervalMillis = minIntervalMillis;
+  }
+  channel->currentAPV = apv;
+  channel->sampleMillis = nowMillis;
+}
+
+void HitecDAdaptiveSampler::recordTarget(
+  HitecDSamplerChannel *channel,
+  uint16_t val
+) {
+  /* Sketches often rewrite the same target periodically, like a PWM signal;
+  that doesn't mean the servo is about to move. */
+  if (val == channel->targetVal) {
+    return;
+  }
+  channel->targetVal = val;
+  channel->targetMillis = millis();
+  channel->intervalMillis = minIntervalMillis;
+}
@@ -0,0 +1,133 @@
+#ifndef HitecDSampler_h
+#define HitecDSampler_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDAdaptiveSampler keeps track of the positions of several servos, reading
+each one often while it's moving and rarely while it's sitting still. For
+example:
+
+    HitecDServo servos[3];
+    HitecDSamplerChannel channels[3];
+    HitecDAdaptiveSampler sampler(servos, channels, 3);
+
+    void setup() {
+      ... attach the servos ...
+      sampler.begin();
+    }
+
+    void loop() {
+      sampler.poll();
+      ... use channels[i].currentAPV ...
+    }
+
+Each servo's sampling interval starts at `minIntervalMillis`. Each time a
+sample shows that the servo hasn't moved by more than HITECD_SAMPLER_STILL_APV,
+the interval doubles, up to `maxIntervalMillis`. As soon as the servo moves, or
+the sketch writes a new target, the interval drops back to `minIntervalMillis`.
+After a new target, it stays there for HITECD_SAMPLER_TARGET_HOLD_MILLIS, in
+case the servo is slow to start moving.
+
+Motion is detected from the change in position between samples, rather than by
+reading register 0x0E or 0xEC (see HitecDServoInternal.h): each of those would
+cost a read of its own, and tells us nothing the position doesn't.
+
+Every read or write blocks the sketch, so the sampler also keeps the total bus
+time under `budgetPercent` of wall-clock time. This covers all the traffic to
+these servos, including the sketch's own target writes and reads. When the
+budget runs short, the servo whose sample is most overdue goes first, and the
+others wait. Like HitecDRecorder, the channels listen in on the sketch's own
+readCurrentAPV() calls, and count those as samples too. */
+
+/* A sample that moved less than this (in APV) counts as "still". Slightly more
+than the noise in the readings of a stationary servo. */
+#define HITECD_SAMPLER_STILL_APV 4
+
+/* How long to keep sampling quickly after a new target is written. */
+#define HITECD_SAMPLER_TARGET_HOLD_MILLIS 200
+
+/* How many reads' worth of bus time the budget can save up while the servos
+are idle, and then spend back-to-back. */
+#define HITECD_SAMPLER_BURST_READS 4
+
+class HitecDAdaptiveSampler;
+
+/* The per-servo state of a HitecDAdaptiveSampler. */
+class HitecDSamplerChannel : public HitecDListener {
+public:
+  HitecDSamplerChannel();
+
+  /* The latest position, or -1 if the servo hasn't been read yet. */
+  int16_t currentAPV;
+
+  /* Value of millis() when `currentAPV` was read. */
+  uint32_t sampleMillis;
+
+  /* How long until the next sample is due. */
+  uint16_t intervalMillis;
+
+  virtual void onReadRegister(
+    HitecDServo *servo, uint8_t reg, int res, uint16_t val);
+  virtual void onWriteRegister(
+    HitecDServo *servo, uint8_t reg, uint16_t val);
+
+private:
+  friend class HitecDAdaptiveSampler;
+  HitecDAdaptiveSampler *sampler;
+  uint16_t targetVal;
+  uint32_t targetMillis;
+};
+
+class HitecDAdaptiveSampler {
+public:
+  /* `servos` and `channels` are arrays of `numServos` entries each. */
+  HitecDAdaptiveSampler(
+    HitecDServo *servos,
+    HitecDSamplerChannel *channels,
+    uint8_t numServos);
+
+  /* Starts sampling. Every servo is sampled right away. */
+  void begin(
+    uint8_t budgetPercent = 50,
+    uint16_t minIntervalMillis = 20,
+    uint16_t maxIntervalMillis = 1000);
+
+  /* Stops sampling, and detaches the channels from the servos. */
+  void end();
+
+  /* Reads the position of the servo whose sample is most overdue, if the
+  budget allows. Call this as often as possible from loop(). Returns HITECD_OK
+  if nothing went wrong, or an error code if the read failed. */
+  int poll();
+
+  /* Number of reads performed by poll(). */
+  uint32_t reads;
+
+  /* Number of times a sample was due, but had to wait because the bus-time
+  budget was used up. */
+  uint32_t deferrals;
+
+private:
+  friend class HitecDSamplerChannel;
+  void refillBudget();
+  void chargeBudget(uint32_t busMicros);
+  void recordSample(HitecDSamplerChannel *channel, int16_t apv);
+  void recordTarget(HitecDSamplerChannel *channel, uint16_t val);
+
+  HitecDServo *servos;
+  HitecDSamplerChannel *channels;
+  uint8_t numServos;
+
+  uint8_t budgetPercent;
+  uint16_t minIntervalMillis, maxIntervalMillis;
+
+  /* Bus time we're allowed to spend right now. Goes negative if the sketch's
+  own traffic overspends it. */
+  int32_t budgetMicros;
+  uint32_t budgetRefillMicros;
+  bool deferring;
+};
+
+#endif /* HitecDSampler_h */
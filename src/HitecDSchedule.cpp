@@ -0,0 +1,72 @@
+#include "HitecDSchedule.h"
+
+HitecDCyclicExecutive::HitecDCyclicExecutive(
+  HitecDServo *_servos,
+  const HitecDSlot *_slots,
+  uint8_t _numSlots,
+  uint32_t _frameMicros,
+  int16_t *_targetQuarterMicros,
+  int16_t *_currentAPV
+) :
+  maxLatenessMicros(0),
+  frameOverruns(0),
+  servos(_servos),
+  slots(_slots),
+  numSlots(_numSlots),
+  frameMicros(_frameMicros),
+  targetQuarterMicros(_targetQuarterMicros),
+  currentAPV(_currentAPV),
+  started(false),
+  nextSlot(0),
+  frameStartMicros(0)
+{ }
+
+void HitecDCyclicExecutive::start() {
+  started = true;
+  nextSlot = 0;
+  frameStartMicros = micros();
+}
+
+int HitecDCyclicExecutive::poll() {
+  if (!started || numSlots == 0) {
+    return HITECD_OK;
+  }
+
+  const HitecDSlot &slot = slots[nextSlot];
+  uint32_t now = micros();
+  uint32_t lateness = now - (frameStartMicros + slot.offsetMicros);
+  if ((int32_t)lateness < 0) {
+    /* Not due yet */
+    return HITECD_OK;
+  }
+  if (lateness > maxLatenessMicros) {
+    maxLatenessMicros = lateness;
+  }
+
+  int res = HITECD_OK;
+  HitecDServo &servo = servos[slot.servo];
+  if (slot.op == HITECD_SLOT_WRITE_TARGET) {
+    servo.writeTargetQuarterMicros(targetQuarterMicros[slot.servo]);
+  } else {
+    int16_t apv = servo.readCurrentAPV();
+    if (apv < 0) {
+      res = apv;
+    } else {
+      currentAPV[slot.servo] = apv;
+    }
+  }
+
+  if (++nextSlot == numSlots) {
+    nextSlot = 0;
+    frameStartMicros += frameMicros;
+
+    /* If we've fallen more than a whole frame behind, don't try to catch up by
+    executing the missed frames back-to-back; just start over from now. */
+    if ((int32_t)(micros() - frameStartMicros) > (int32_t)frameMicros) {
+      frameStartMicros = micros();
+      ++frameOverruns;
+    }
+  }
+
+  return res;
+}
@@ -0,0 +1,147 @@
+#ifndef HitecDSchedule_h
+#define HitecDSchedule_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* A cyclic schedule for robots with a fixed set of servos. Instead of deciding
+at runtime which servo to talk to next, the sketch declares a table of slots.
+Each slot says "at this offset into the frame, do this operation on this
+servo". The table is repeated every `frameMicros` microseconds.
+
+Declare the executive with HITECD_CYCLIC_EXECUTIVE(), which checks the table at
+compile time: if two slots would overlap on the wire, the last slot would run
+past the end of the frame, or a slot names a servo that isn't in the `servos`
+array, the build fails. For example:
+
+    HitecDServo servos[2];
+    int16_t targetQuarterMicros[2];
+    int16_t currentAPV[2];
+
+    constexpr HitecDSlot schedule[] = {
+      {0, HITECD_SLOT_WRITE_TARGET, 0},
+      {1, HITECD_SLOT_WRITE_TARGET, 2000},
+      {1, HITECD_SLOT_READ_APV, 4000},
+    };
+    HITECD_CYCLIC_EXECUTIVE(executive, servos, schedule, 25000,
+      targetQuarterMicros, currentAPV);
+
+The slots must be listed in order of increasing offset. */
+
+/* Write `targetQuarterMicros[servo]` to the servo's TARGET register. */
+#define HITECD_SLOT_WRITE_TARGET 0
+
+/* Read the servo's current position into `currentAPV[servo]`. */
+#define HITECD_SLOT_READ_APV 1
+
+struct HitecDSlot {
+  /* Index into the `servos` array passed to HitecDCyclicExecutive. */
+  uint8_t servo;
+
+  /* One of the HITECD_SLOT_* constants above. */
+  uint8_t op;
+
+  /* When the slot starts, in microseconds after the start of the frame. */
+  uint32_t offsetMicros;
+};
+
+/* How long the given slot operation occupies the wire. */
+constexpr uint32_t hitecdSlotMicros(uint8_t op) {
+  return (op == HITECD_SLOT_READ_APV) ? HD_READ_MICROS : HD_WRITE_MICROS;
+}
+
+/* True if the slots don't overlap each other and all fit within the frame.
+(This is written recursively so it can be evaluated at compile time.) */
+constexpr bool hitecdScheduleFeasible(
+  const HitecDSlot *slots, size_t numSlots, uint32_t frameMicros
+) {
+  return (numSlots == 0) ? true :
+    (numSlots == 1) ?
+      slots[0].offsetMicros + hitecdSlotMicros(slots[0].op) <= frameMicros :
+    (slots[0].offsetMicros + hitecdSlotMicros(slots[0].op) <=
+        slots[1].offsetMicros) &&
+      hitecdScheduleFeasible(slots + 1, numSlots - 1, frameMicros);
+}
+
+/* True if every slot's servo index is less than `numServos`. */
+constexpr bool hitecdScheduleServosInRange(
+  const HitecDSlot *slots, size_t numSlots, size_t numServos
+) {
+  return (numSlots == 0) ? true :
+    slots[0].servo < numServos &&
+      hitecdScheduleServosInRange(slots + 1, numSlots - 1, numServos);
+}
+
+/* Declares a HitecDCyclicExecutive called `name` that runs `slots` every
+`frameMicros` microseconds on `servos`, after checking the schedule at compile
+time. `servos`, `slots`, `targetQuarterMicros`, and `currentAPV` must be arrays
+(not pointers), so their lengths are known. */
+#define HITECD_CYCLIC_EXECUTIVE( \
+    name, servos, slots, frameMicros, targetQuarterMicros, currentAPV) \
+  static_assert( \
+    hitecdScheduleFeasible(slots, sizeof(slots) / sizeof(slots[0]), \
+      frameMicros), \
+    "HitecD schedule is infeasible: slots overlap or overrun the frame"); \
+  static_assert( \
+    hitecdScheduleServosInRange(slots, sizeof(slots) / sizeof(slots[0]), \
+      sizeof(servos) / sizeof(servos[0])), \
+    "HitecD schedule refers to a servo past the end of the servos array"); \
+  static_assert( \
+    sizeof(targetQuarterMicros) / sizeof(targetQuarterMicros[0]) == \
+      sizeof(servos) / sizeof(servos[0]) && \
+    sizeof(currentAPV) / sizeof(currentAPV[0]) == \
+      sizeof(servos) / sizeof(servos[0]), \
+    "HitecD schedule needs one target and one APV entry per servo"); \
+  HitecDCyclicExecutive name( \
+    servos, slots, sizeof(slots) / sizeof(slots[0]), frameMicros, \
+    targetQuarterMicros, currentAPV)
+
+/* Runs a schedule declared as above. (The constructor can be called directly,
+but then nothing checks the schedule.) Call poll() as often as possible from
+loop(); it executes each slot once its offset is reached.
+
+Note, poll() blocks for the duration of the slot it executes (up to
+HD_READ_MICROS for a read), so it shouldn't be called from an interrupt
+handler. */
+class HitecDCyclicExecutive {
+public:
+  /* `targetQuarterMicros` and `currentAPV` are arrays with one entry per servo,
+  indexed the same way as `servos`. The sketch updates `targetQuarterMicros`
+  whenever it likes; the executive updates `currentAPV`. */
+  HitecDCyclicExecutive(
+    HitecDServo *servos,
+    const HitecDSlot *slots,
+    uint8_t numSlots,
+    uint32_t frameMicros,
+    int16_t *targetQuarterMicros,
+    int16_t *currentAPV);
+
+  /* Starts the first frame now. */
+  void start();
+
+  /* If the next slot is due, executes it. Returns HITECD_OK if nothing went
+  wrong, or an error code if a read failed. */
+  int poll();
+
+  /* How late the most-late slot started, in microseconds. */
+  uint32_t maxLatenessMicros;
+
+  /* How many times a whole frame was skipped because poll() wasn't called
+  often enough. */
+  uint16_t frameOverruns;
+
+private:
+  HitecDServo *servos;
+  const HitecDSlot *slots;
+  uint8_t numSlots;
+  uint32_t frameMicros;
+  int16_t *targetQuarterMicros;
+  int16_t *currentAPV;
+
+  bool started;
+  uint8_t nextSlot;
+  uint32_t frameStartMicros;
+};
+
+#endif /* HitecDSchedule_h */
@@ -1,10 +1,30 @@
 #include "HitecDServo.h"
 
 #include "HitecDServoInternal.h"
+#include "HitecDSettingsProgram.h"
 
-HitecDServo::HitecDServo() : pin(-1) { }
+/* Holds a servo's bus lock until it goes out of scope. */
+class HitecDBusLock {
+public:
+  HitecDBusLock(HitecDServo *_servo) : servo(_servo) {
+    servo->lockBus();
+  }
+  ~HitecDBusLock() {
+    servo->unlockBus();
+  }
+private:
+  HitecDServo *servo;
+};
+
+HitecDServo::HitecDServo() : pin(-1), listeners(NULL), busMutex(NULL) {
+#ifdef HITECD_RTOS
+  busMutex = (void *)xSemaphoreCreateRecursiveMutex();
+#endif
+}
+
+int HitecDServo::attach(int _pin, int *diagnosisOut) {
+  HitecDBusLock lock(this);
 
-int HitecDServo::attach(int _pin) {
   if (attached()) {
     detachAndReset();
   }
@@ -18,29 +38,45 @@ int HitecDServo::attach(int _pin) {
   pinInputRegister = portInputRegister(port);
   pinOutputRegister = portOutputRegister(port);
 
+  int res = readAttachRegisters();
+  if (diagnosisOut != NULL) {
+    *diagnosisOut = res;
+    if (res == HITECD_ERR_BOOTING_OR_NO_PULLUP && isAnalogPin()) {
+      /* Find out which it is, so the user knows what to fix. */
+      HitecDLineDiagnostics diagnostics;
+      int diagnosis = diagnoseLine(&diagnostics);
+      if (diagnosis == HITECD_ERR_BOOTING ||
+          diagnosis == HITECD_ERR_NO_PULLUP) {
+        *diagnosisOut = diagnosis;
+      }
+    }
+  }
+  if (res != HITECD_OK) {
+    detachAndReset();
+  }
+  return res;
+}
+
+int HitecDServo::readAttachRegisters() {
   int res;
   uint16_t temp;
 
   if ((res = readRawRegister(HD_REG_MODEL_NUMBER, &temp)) != HITECD_OK) {
-    detachAndReset();
     return res;
   }
   modelNumber = temp;
 
   if ((res = readRawRegister(HD_REG_RANGE_LEFT_APV, &temp)) != HITECD_OK) {
-    detachAndReset();
     return res;
   }
   rangeLeftAPV = temp;
 
   if ((res = readRawRegister(HD_REG_RANGE_RIGHT_APV, &temp)) != HITECD_OK) {
-    detachAndReset();
     return res;
   }
   rangeRightAPV = temp;
 
   if ((res = readRawRegister(HD_REG_RANGE_CENTER_APV, &temp)) != HITECD_OK) {
-    detachAndReset();
     return res;
   }
   rangeCenterAPV = temp;
@@ -83,11 +119,7 @@ int16_t HitecDServo::readCurrentQuarterMicros() {
   if (currentAPV < 0) {
     return currentAPV;
   }
-  if (currentAPV < rangeCenterAPV) {
-    return map(currentAPV, rangeLeftAPV, rangeCenterAPV, 4*850, 4*1500);
-  } else {
-    return map(currentAPV, rangeCenterAPV, rangeRightAPV, 4*1500, 4*2150);
-  }
+  return apvToQuarterMicros(currentAPV);
 }
 
 int16_t HitecDServo::readCurrentAPV() {
@@ -102,6 +134,43 @@ int16_t HitecDServo::readCurrentAPV() {
   return currentAPV;
 }
 
+void HitecDServo::writeLivePowerLimit(int16_t powerLimit) {
+  if (!attached()) {
+    return;
+  }
+  powerLimit = constrain(powerLimit, 0, 100);
+  writeRawRegister(HD_REG_POWER_LIMIT, hitecdEncodePowerLimit(powerLimit));
+}
+
+int16_t HitecDServo::apvToQuarterMicros(int16_t apv) {
+  if (apv < rangeCenterAPV) {
+    return map(apv, rangeLeftAPV, rangeCenterAPV, 4*850, 4*1500);
+  } else {
+    return map(apv, rangeCenterAPV, rangeRightAPV, 4*1500, 4*2150);
+  }
+}
+
+int16_t HitecDServo::quarterMicrosToAPV(int16_t quarterMicros) {
+  if (quarterMicros < 4*1500) {
+    return map(quarterMicros, 4*850, 4*1500, rangeLeftAPV, rangeCenterAPV);
+  } else {
+    return map(quarterMicros, 4*1500, 4*2150, rangeCenterAPV, rangeRightAPV);
+  }
+}
+
+int HitecDServo::readMotorPower(int16_t *powerOut) {
+  if (!attached()) {
+    return HITECD_ERR_NOT_ATTACHED;
+  }
+  int res;
+  uint16_t temp;
+  if ((res = readRawRegister(HD_REG_MOTOR_POWER, &temp)) != HITECD_OK) {
+    return res;
+  }
+  *powerOut = (int16_t)temp;
+  return HITECD_OK;
+}
+
 int HitecDServo::readModelNumber() {
   if (!attached()) {
     return HITECD_ERR_NOT_ATTACHED;
@@ -120,6 +189,8 @@ bool HitecDServo::isModelSupported() {
 }
 
 int HitecDServo::readSettings(HitecDSettings *settingsOut) {
+  HitecDBusLock lock(this);
+
   if (!attached()) {
     return HITECD_ERR_NOT_ATTACHED;
   }
@@ -131,37 +202,28 @@ int HitecDServo::readSettings(HitecDSettings *settingsOut) {
   if ((res = readRawRegister(HD_REG_ID, &temp)) != HITECD_OK) {
     return res;
   }
-  if (temp > 255) {
-    return HITECD_ERR_CONFUSED;
+  if ((res = hitecdDecodeId(temp, &settingsOut->id)) != HITECD_OK) {
+    return res;
   }
-  settingsOut->id = temp;
 
   /* Read counterclockwise */
   if ((res = readRawRegister(HD_REG_DIRECTION, &temp)) != HITECD_OK) {
     return res;
   }
-  if (temp == HD_DIRECTION_CLOCKWISE) {
-    settingsOut->counterclockwise = false;
-  } else if (temp == HD_DIRECTION_COUNTERCLOCKWISE) {
-    settingsOut->counterclockwise = true;
-  } else {
-    return HITECD_ERR_CONFUSED;
+  if ((res = hitecdDecodeDirection(temp, &settingsOut->counterclockwise)) !=
+      HITECD_OK) {
+    return res;
   }
 
   /* Read speed */
   if ((res = readRawRegister(HD_REG_SPEED, &temp)) != HITECD_OK) {
     return res;
   }
-  if (temp == 0x0FFF) {
-    settingsOut->speed = 100;
-  } else if (temp < 20) {
-    settingsOut->speed = temp*5;
-  } else {
-    return HITECD_ERR_CONFUSED;
+  if ((res = hitecdDecodeSpeed(temp, &settingsOut->speed)) != HITECD_OK) {
+    return res;
   }
 
-  /* Read deadband. There are three deadband-related registers; their values are
-  expected to be consistent with each other. */
+  /* Read deadband, which takes three registers */
   uint16_t deadband_1, deadband_2, deadband_3;
   if ((res = readRawRegister(HD_REG_DEADBAND_1, &deadband_1)) != HITECD_OK) {
     return res;
@@ -172,31 +234,18 @@ int HitecDServo::readSettings(HitecDSettings *settingsOut) {
   if ((res = readRawRegister(HD_REG_DEADBAND_3, &deadband_3)) != HITECD_OK) {
     return res;
   }
-  if (deadband_1 == 1 && deadband_2 == 5 && deadband_3 == 11) {
-    settingsOut->deadband = 1;
-  } else if (deadband_1 >= 4 && deadband_1 <= 36 && deadband_1 % 4 == 0 &&
-      deadband_2 == deadband_1 + 4 && deadband_3 == deadband_1 + 10) {
-    settingsOut->deadband = deadband_1 / 4 + 1;
-  } else {
-    return HITECD_ERR_CONFUSED;
+  if ((res = hitecdDecodeDeadband(deadband_1, deadband_2, deadband_3,
+      &settingsOut->deadband)) != HITECD_OK) {
+    return res;
   }
 
   /* Read softStart */
   if ((res = readRawRegister(HD_REG_SOFT_START, &temp)) != HITECD_OK) {
     return res;
   }
-  if (temp == HD_SOFT_START_20) {
-    settingsOut->softStart = 20;
-  } else if (temp == HD_SOFT_START_40) {
-    settingsOut->softStart = 40;
-  } else if (temp == HD_SOFT_START_60) {
-    settingsOut->softStart = 60;
-  } else if (temp == HD_SOFT_START_80) {
-    settingsOut->softStart = 80;
-  } else if (temp == HD_SOFT_START_100) {
-    settingsOut->softStart = 100;
-  } else {
-    return HITECD_ERR_CONFUSED;
+  if ((res = hitecdDecodeSoftStart(temp, &settingsOut->softStart)) !=
+      HITECD_OK) {
+    return res;
   }
 
   /* Read rangeLeftAPV, rangeRightAPV, rangeCenterAPV */
@@ -219,29 +268,16 @@ int HitecDServo::readSettings(HitecDSettings *settingsOut) {
   if ((res = readRawRegister(HD_REG_FAIL_SAFE, &temp)) != HITECD_OK) {
     return res;
   }
-  if (temp >= 850 && temp <= 2150) {
-    settingsOut->failSafe = temp;
-    settingsOut->failSafeLimp = false;
-  } else if (temp == 0) {
-    settingsOut->failSafe = 0;
-    settingsOut->failSafeLimp = true;
-  } else if (temp == 1) {
-    settingsOut->failSafe = 0;
-    settingsOut->failSafeLimp = false;
-  } else {
-    return HITECD_ERR_CONFUSED;
+  if ((res = hitecdDecodeFailSafe(temp, &settingsOut->failSafe,
+      &settingsOut->failSafeLimp)) != HITECD_OK) {
+    return res;
   }
 
   /* Read powerLimit */
   if ((res = readRawRegister(HD_REG_POWER_LIMIT, &temp)) != HITECD_OK) {
     return res;
   }
-  if (temp == 0x0FFF) {
-    settingsOut->powerLimit = 100;
-  } else {
-    /* Divide rounding up, so nonzero values stay nonzero */
-    settingsOut->powerLimit = (temp + 19) / 20;
-  }
+  hitecdDecodePowerLimit(temp, &settingsOut->powerLimit);
 
   /* Read overloadProtection */
   if ((res = readRawRegister(HD_REG_OVERLOAD_PROTECTION, &temp)) != HITECD_OK) {
@@ -249,12 +285,8 @@ int HitecDServo::readSettings(HitecDSettings *settingsOut) {
   }
   settingsOut->overloadProtection = temp;
 
-  /* Read smartSense. smartSense is controlled by two registers, 0x6C and 0x44.
-  If smartSense is enabled, these should be set to values read from two
-  read-only registers, 0xD4 and 0xD6. If smartSense is disabled, these should be
-  set to values read from two other read-only registers, 0x8A and 0x8C. So we
-  read all six registers and confirm the values follow one of the two expected
-  patterns. */
+  /* Read smartSense. The two SMART_SENSE registers are compared against four
+  read-only registers; see hitecdDecodeSmartSense(). */
   uint16_t ss_1, ss_2, ss_enable_1, ss_enable_2, ss_disable_1, ss_disable_2;
   if ((res = readRawRegister(HD_REG_SMART_SENSE_1, &ss_1)) != HITECD_OK) {
     return res;
@@ -274,22 +306,18 @@ int HitecDServo::readSettings(HitecDSettings *settingsOut) {
   if ((res = readRawRegister(HD_REG_SS_DISABLE_2, &ss_disable_2)) != HITECD_OK) {
     return res;
   }
-  if (ss_1 == ss_enable_1 && ss_2 == ss_enable_2) {
-    settingsOut->smartSense = true;
-  } else if (ss_1 == ss_disable_1 && ss_2 == ss_disable_2) {
-    settingsOut->smartSense = false;
-  } else {
-    return HITECD_ERR_CONFUSED;
+  if ((res = hitecdDecodeSmartSense(ss_1, ss_2, ss_enable_1, ss_enable_2,
+      ss_disable_1, ss_disable_2, &settingsOut->smartSense)) != HITECD_OK) {
+    return res;
   }
 
   /* Read sensitivityRatio */
   if ((res = readRawRegister(HD_REG_SENSITIVITY_RATIO, &temp)) != HITECD_OK) {
     return res;
   }
-  if (temp >= HD_SENSITIVITY_RATIO_MIN && temp <= HD_SENSITIVITY_RATIO_MAX) {
-    settingsOut->sensitivityRatio = temp;
-  } else {
-    return HITECD_ERR_CONFUSED;
+  if ((res = hitecdDecodeSensitivityRatio(temp,
+      &settingsOut->sensitivityRatio)) != HITECD_OK) {
+    return res;
   }
 
   return HITECD_OK;
@@ -303,6 +331,8 @@ int HitecDServo::writeSettingsUnsupportedModelThisMightDamageTheServo(
   const HitecDSettings &settings,
   bool allowUnsupportedModel
 ) {
+  HitecDBusLock lock(this);
+
   int res;
   uint16_t temp;
 
@@ -336,7 +366,7 @@ int HitecDServo::writeSettingsUnsupportedModelThisMightDamageTheServo(
 
   /* Write speed */
   if (settings.speed != HitecDSettings::defaultSpeed) {
-    writeRawRegister(HD_REG_SPEED, settings.speed / 5);
+    writeRawRegister(HD_REG_SPEED, hitecdEncodeSpeed(settings.speed));
   }
 
   /* Write deadband */
@@ -344,26 +374,19 @@ int HitecDServo::writeSettingsUnsupportedModelThisMightDamageTheServo(
     /* The DPC-11 always writes this register to the this constant whenever it
     changes the deadband. I'm not sure why, but we do the same to be safe. */
     writeRawRegister(HD_REG_MYSTERY_DB, HD_MYSTERY_DB_CONST);
- 
-    /* Note, these formulas are wrong if deadband=1, but deadband=1 is the
-    factory default, so that's OK. */
-    writeRawRegister(HD_REG_DEADBAND_1, 4 * settings.deadband - 4);
-    writeRawRegister(HD_REG_DEADBAND_2, 4 * settings.deadband);
-    writeRawRegister(HD_REG_DEADBAND_3, 4 * settings.deadband + 6);
+
+    writeRawRegister(HD_REG_DEADBAND_1,
+      hitecdEncodeDeadband1(settings.deadband));
+    writeRawRegister(HD_REG_DEADBAND_2,
+      hitecdEncodeDeadband2(settings.deadband));
+    writeRawRegister(HD_REG_DEADBAND_3,
+      hitecdEncodeDeadband3(settings.deadband));
   }
 
   /* Write softStart */
   if (settings.softStart != HitecDSettings::defaultSoftStart) {
-    /* Note, we omit the softStart=20 case because it's the factory default. */
-    if (settings.softStart == 40) {
-      writeRawRegister(HD_REG_SOFT_START, HD_SOFT_START_40);
-    } else if (settings.softStart == 60) {
-      writeRawRegister(HD_REG_SOFT_START, HD_SOFT_START_60);
-    } else if (settings.softStart == 80) {
-      writeRawRegister(HD_REG_SOFT_START, HD_SOFT_START_80);
-    } else if (settings.softStart == 100) {
-      writeRawRegister(HD_REG_SOFT_START, HD_SOFT_START_100);
-    }
+    writeRawRegister(HD_REG_SOFT_START,
+      hitecdEncodeSoftStart(settings.softStart));
   }
 
   /* Write rangeLeftAPV, rangeRightAPV, and rangeCenterAPV. Also, update the
@@ -407,15 +430,15 @@ int HitecDServo::writeSettingsUnsupportedModelThisMightDamageTheServo(
   }
 
   /* Write failSafe and failSafeLimp (controlled by same register) */
-  if (settings.failSafe != 0) {
-    writeRawRegister(HD_REG_FAIL_SAFE, settings.failSafe);
-  } else if (settings.failSafeLimp) {
-    writeRawRegister(HD_REG_FAIL_SAFE, HD_FAIL_SAFE_LIMP);
+  if (settings.failSafe != 0 || settings.failSafeLimp) {
+    writeRawRegister(HD_REG_FAIL_SAFE,
+      hitecdEncodeFailSafe(settings.failSafe, settings.failSafeLimp));
   }
 
   /* Write powerLimit */
   if (settings.powerLimit != HitecDSettings::defaultPowerLimit) {
-    writeRawRegister(HD_REG_POWER_LIMIT, settings.powerLimit * 20);
+    writeRawRegister(HD_REG_POWER_LIMIT,
+      hitecdEncodePowerLimit(settings.powerLimit));
   }
 
   /* Write overloadProtection */
@@ -467,21 +490,397 @@ int HitecDServo::writeSettingsUnsupportedModelThisMightDamageTheServo(
   return HITECD_OK;
 }
 
+int HitecDServo::writeSettingsProgramPGM(
+  const HitecDRegisterWrite *programPGM,
+  int length
+) {
+  HitecDBusLock lock(this);
+
+  int res;
+  uint16_t temp;
+
+  if (!attached()) {
+    return HITECD_ERR_NOT_ATTACHED;
+  }
+
+  /* The program has the D485HW's smart-sense magic numbers baked in, so we
+  can't allow unsupported models here. */
+  if (!isModelSupported()) {
+    return HITECD_ERR_UNSUPPORTED_MODEL;
+  }
+
+  /* The program starts with a factory reset, so we just stream it out. */
+  for (int i = 0; i < length; ++i) {
+    uint8_t reg = pgm_read_byte(&programPGM[i].reg);
+    uint16_t val = pgm_read_word(&programPGM[i].val);
+    if (reg != HITECD_SKIP_REG) {
+      writeRawRegister(reg, val);
+    }
+  }
+
+  /* Read back the range registers, so the instance variables that we
+  initialized in attach() match what we just wrote (or the factory defaults,
+  for any that were skipped). */
+  if ((res = readRawRegister(HD_REG_RANGE_LEFT_APV, &temp)) != HITECD_OK) {
+    return res;
+  }
+  rangeLeftAPV = temp;
+  if ((res = readRawRegister(HD_REG_RANGE_RIGHT_APV, &temp)) != HITECD_OK) {
+    return res;
+  }
+  rangeRightAPV = temp;
+  if ((res = readRawRegister(HD_REG_RANGE_CENTER_APV, &temp)) != HITECD_OK) {
+    return res;
+  }
+  rangeCenterAPV = temp;
+
+  /* Save new settings to EEPROM, and reboot so they take effect. The caller is
+  responsible for waiting 1000ms before trying to issue any commands. */
+  writeRawRegister(HD_REG_SAVE, HD_SAVE_CONST);
+  writeRawRegister(HD_REG_REBOOT, HD_REBOOT_CONST);
+
+  return HITECD_OK;
+}
+
+/* How long waitUntilBooted() watches for the servo to start booting. */
+#define BOOT_START_MILLIS 20
+
+int HitecDServo::waitUntilBooted(unsigned long timeoutMillis) {
+  HitecDBusLock lock(this);
+
+  if (!attached()) {
+    return HITECD_ERR_NOT_ATTACHED;
+  }
+
+  /* While booting, the servo drives the line low. Once it's done, it releases
+  the line, and the pullup resistor pulls it high. If we were called right after
+  writing REBOOT, the servo may take a moment to start driving the line low, so
+  first watch for that for a while. If it never happens, the servo wasn't
+  booting after all. */
+  unsigned long startMillis = millis();
+  pinMode(pin, INPUT_PULLUP);
+  while (digitalRead(pin) == HIGH &&
+      millis() - startMillis < BOOT_START_MILLIS) {
+    hitecdYield();
+  }
+
+  /* Then wait for the line to go high, and make sure the servo is really
+  listening. If it isn't yet, keep trying until the timeout. */
+  int res;
+  while (true) {
+    pinMode(pin, INPUT_PULLUP);
+    if (digitalRead(pin) == HIGH) {
+      pinMode(pin, OUTPUT);
+      digitalWrite(pin, LOW);
+      hitecdSleepMillis(1);
+      uint16_t temp;
+      if ((res = readRawRegister(HD_REG_MODEL_NUMBER, &temp)) == HITECD_OK) {
+        return HITECD_OK;
+      }
+    } else {
+      res = HITECD_ERR_BOOTING_OR_NO_PULLUP;
+    }
+    if (millis() - startMillis > timeoutMillis) {
+      pinMode(pin, OUTPUT);
+      digitalWrite(pin, LOW);
+      return res;
+    }
+    hitecdYield();
+  }
+}
+
+/* Thresholds for diagnoseLine(), as raw ADC readings. */
+
+/* If the line reads above this when released, nothing is pulling it down, so
+there's no servo. */
+#define LINE_NO_SERVO_LEVEL 1000
+
+/* If the line reads below this when released, the pullup is missing or the
+servo is holding the line low. (This corresponds to a pullup of about 27k.) */
+#define LINE_STUCK_LOW_LEVEL 100
+
+/* With only the microcontroller's internal pullup (20k-50k) against the servo's
+3k pulldown, the line reads about 60-130. A booting servo actively drives the
+line low, so it reads much lower. */
+#define LINE_DRIVEN_LOW_LEVEL 25
+
+/* The AVR's logic-high threshold is 60% of the supply voltage. Below 55%, reads
+work only on some boards. (This corresponds to a pullup of about 2.4k.) */
+#define LINE_WEAK_PULLUP_LEVEL 563
+
+/* The AVR's logic-low threshold is 30% of the supply voltage. Above 20%, the
+servo's transmissions might not be seen reliably. */
+#define LINE_STRONG_PULLUP_LEVEL 205
+
+/* Bits are 8680ns long; if the line takes more than a quarter of that to rise,
+bits start getting misread. */
+#define LINE_MAX_RISE_NANOS 2000
+
+/* The rise-time loop gives up after this many iterations, so interrupts aren't
+disabled for too long. This is about 1ms on a 16MHz AVR. */
+#define RISE_LOOP_MAX 2000
+
+/* Counts loop iterations until the pin reads high, up to RISE_LOOP_MAX. This
+is kept out of line so that diagnoseLine() can time it with micros(), and be
+sure the timed run executes exactly the same code as the real one. */
+static uint16_t __attribute__((noinline)) countRiseLoop(
+  volatile uint8_t *inputRegister,
+  uint8_t bitMask
+) {
+  uint16_t count = 0;
+  while (!(*inputRegister & bitMask) && count != RISE_LOOP_MAX) {
+    ++count;
+  }
+  return count;
+}
+
+bool HitecDServo::isAnalogPin() {
+#if defined(PIN_A0) && defined(NUM_ANALOG_INPUTS)
+  return pin >= PIN_A0 && pin < PIN_A0 + NUM_ANALOG_INPUTS;
+#else
+  return false;
+#endif
+}
+
+int HitecDServo::diagnoseLine(HitecDLineDiagnostics *diagnosticsOut) {
+  HitecDBusLock lock(this);
+
+  if (!attached()) {
+    return HITECD_ERR_NOT_ATTACHED;
+  }
+
+  diagnosticsOut->releasedLevel = -1;
+  diagnosticsOut->servoLowLevel = -1;
+  diagnosticsOut->pullupOhms = -1;
+  diagnosticsOut->riseNanos = -1;
+
+  bool analog = isAnalogPin();
+
+  /* Release the line, and see where it settles. Unlike a read, this gives an
+  answer right away, even if the servo is booting. */
+  pinMode(pin, INPUT);
+  delayMicroseconds(100);
+  if (analog) {
+    int level = analogRead(pin);
+    diagnosticsOut->releasedLevel = level;
+    if (level > LINE_NO_SERVO_LEVEL) {
+      pinMode(pin, OUTPUT);
+      digitalWrite(pin, LOW);
+      return HITECD_ERR_NO_SERVO;
+    }
+    if (level < LINE_STUCK_LOW_LEVEL) {
+      /* Either the servo is driving the line low, or there's no pullup. The
+      internal pullup is too weak to overcome a driven line, but can overcome
+      the 3k pulldown a little. */
+      pinMode(pin, INPUT_PULLUP);
+      delayMicroseconds(100);
+      int pulledLevel = analogRead(pin);
+      pinMode(pin, OUTPUT);
+      digitalWrite(pin, LOW);
+      return (pulledLevel < LINE_DRIVEN_LOW_LEVEL) ?
+        HITECD_ERR_BOOTING : HITECD_ERR_NO_PULLUP;
+    }
+    /* The pullup and the 3k pulldown form a voltage divider. */
+    diagnosticsOut->pullupOhms = 3000L * (1023 - level) / level;
+  } else if (digitalRead(pin) != HIGH) {
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    return HITECD_ERR_BOOTING_OR_NO_PULLUP;
+  }
+
+  /* Calibrate the rise-time loop: with a mask that never matches, it runs all
+  RISE_LOOP_MAX iterations, and micros() tells us how long one takes. (micros()
+  only counts in steps of 4us, so over about 1ms this is good to within 1%.) */
+  uint8_t neverHigh = 0;
+  uint32_t loopMicros = micros();
+  countRiseLoop(&neverHigh, 0xFF);
+  loopMicros = micros() - loopMicros;
+  uint32_t nanosPerIteration = loopMicros * 1000 / RISE_LOOP_MAX;
+
+  /* Measure the rise time: drive the line low, then release it, and count how
+  long it takes to read high. We use the port registers directly, since
+  pinMode() is slow compared to the rise time of a healthy line. */
+  volatile uint8_t *pinModeRegister = portModeRegister(digitalPinToPort(pin));
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  delayMicroseconds(100);
+  uint8_t oldSREG = SREG;
+  cli();
+  *pinModeRegister &= ~pinBitMask;
+  uint16_t count = countRiseLoop(pinInputRegister, pinBitMask);
+  SREG = oldSREG;
+  if (count != RISE_LOOP_MAX) {
+    diagnosticsOut->riseNanos = (int32_t)count * nanosPerIteration;
+  }
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  hitecdSleepMillis(1);
+
+  /* Start a read, and sample the line partway through the turnaround, while
+  the servo is holding it low. Then let the servo's response go by. */
+  if (analog) {
+    writeReadCommand(HD_REG_MODEL_NUMBER);
+    hitecdSleepMillis(14);
+    pinMode(pin, INPUT);
+    diagnosticsOut->servoLowLevel = analogRead(pin);
+    hitecdSleepMillis(4);
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    hitecdSleepMillis(1);
+  }
+
+  if (diagnosticsOut->servoLowLevel > LINE_STRONG_PULLUP_LEVEL) {
+    return HITECD_ERR_STRONG_PULLUP;
+  }
+  if (diagnosticsOut->riseNanos == -1 ||
+      diagnosticsOut->riseNanos > LINE_MAX_RISE_NANOS ||
+      (analog && diagnosticsOut->releasedLevel < LINE_WEAK_PULLUP_LEVEL)) {
+    return HITECD_ERR_WEAK_PULLUP;
+  }
+  return HITECD_OK;
+}
+
+int HitecDServo::readRegisterImage(HitecDRegisterImage *imageOut) {
+  HitecDBusLock lock(this);
+
+  if (!attached()) {
+    return HITECD_ERR_NOT_ATTACHED;
+  }
+
+  int res;
+  for (int i = 0; i < 128; ++i) {
+    if ((res = readRawRegister(2 * i, &imageOut->values[i])) != HITECD_OK) {
+      return res;
+    }
+  }
+  return HITECD_OK;
+}
+
+/* The registers written by the DPC-11's "OPEN" button, in the order it writes
+them. (The DPC-11 writes DEADBAND_3 twice; we only write it once.) */
+static const uint8_t registerImageRestoreOrder[] PROGMEM = {
+  HD_REG_MYSTERY_DB, HD_REG_ID, 0x34, 0x38, 0x3A, HD_REG_FAIL_SAFE,
+  HD_REG_DEADBAND_1, 0x50, 0x52, HD_REG_SPEED, HD_REG_POWER_LIMIT, 0x58, 0x5A,
+  0x5C, HD_REG_DIRECTION, HD_REG_SOFT_START, 0x62, 0x78, 0x7A, 0x7C, 0x7E,
+  0x80, 0x82, 0x84, 0x86, 0x88, HD_REG_SS_DISABLE_2, HD_REG_SS_DISABLE_1,
+  0x8E, 0x90, 0x92, 0x94, 0x96, HD_REG_MYSTERY_OP1, HD_REG_MYSTERY_OP2,
+  HD_REG_OVERLOAD_PROTECTION, 0x9E, 0xA0, 0xA2, 0xA4, 0xA6, 0xA8, 0xAA, 0xAC,
+  0xAE, HD_REG_RANGE_RIGHT_APV, HD_REG_RANGE_LEFT_APV, HD_REG_RANGE_CENTER_APV,
+  0xC4, 0xC0, 0xB4, 0xB6, 0xB8, 0xBA, 0x3C, 0x3E, 0x40, 0x42,
+  HD_REG_SMART_SENSE_1, HD_REG_SENSITIVITY_RATIO, HD_REG_DEADBAND_2,
+  HD_REG_DEADBAND_3, 0x6A, HD_REG_SMART_SENSE_2, 0xCE, 0xD0, 0xD2,
+  HD_REG_SS_ENABLE_2, HD_REG_SS_ENABLE_1
+};
+
+int HitecDServo::writeRegisterImage(
+  const HitecDRegisterImage &image,
+  const HitecDRegisterImage *currentImage
+) {
+  HitecDBusLock lock(this);
+
+  if (!attached()) {
+    return HITECD_ERR_NOT_ATTACHED;
+  }
+
+  /* Refuse to restore an image from a different model. */
+  if (image.get(HD_REG_MODEL_NUMBER) != modelNumber) {
+    return HITECD_ERR_CONFUSED;
+  }
+
+  for (int i = 0; i < (int)sizeof(registerImageRestoreOrder); ++i) {
+    uint8_t reg = pgm_read_byte(&registerImageRestoreOrder[i]);
+    if (reg == HD_REG_MYSTERY_DB) {
+      /* Reading back MYSTERY_DB always returns 0, so the image doesn't tell us
+      what to write. The DPC-11 always writes this constant. */
+      writeRawRegister(HD_REG_MYSTERY_DB, HD_MYSTERY_DB_CONST);
+      continue;
+    }
+    uint16_t val = image.get(reg);
+    if (currentImage != NULL && currentImage->get(reg) == val) {
+      continue;
+    }
+    writeRawRegister(reg, val);
+  }
+
+  writeRawRegister(HD_REG_SAVE, HD_SAVE_CONST);
+  writeRawRegister(HD_REG_REBOOT, HD_REBOOT_CONST);
+
+  int res;
+  if ((res = waitUntilBooted()) != HITECD_OK) {
+    return res;
+  }
+
+  rangeLeftAPV = image.get(HD_REG_RANGE_LEFT_APV);
+  rangeRightAPV = image.get(HD_REG_RANGE_RIGHT_APV);
+  rangeCenterAPV = image.get(HD_REG_RANGE_CENTER_APV);
+
+  return HITECD_OK;
+}
+
+void HitecDServo::addListener(HitecDListener *listener) {
+  listener->nextListener = listeners;
+  listeners = listener;
+}
+
+void HitecDServo::removeListener(HitecDListener *listener) {
+  for (HitecDListener **p = &listeners; *p != NULL; p = &(*p)->nextListener) {
+    if (*p == listener) {
+      *p = listener->nextListener;
+      listener->nextListener = NULL;
+      return;
+    }
+  }
+}
+
+void HitecDServo::lockBus() {
+#ifdef HITECD_RTOS
+  if (busMutex != NULL &&
+      xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+    xSemaphoreTakeRecursive((SemaphoreHandle_t)busMutex, portMAX_DELAY);
+  }
+#endif
+}
+
+void HitecDServo::unlockBus() {
+#ifdef HITECD_RTOS
+  if (busMutex != NULL &&
+      xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+    xSemaphoreGiveRecursive((SemaphoreHandle_t)busMutex);
+  }
+#endif
+}
+
 int HitecDServo::readRawRegister(uint8_t reg, uint16_t *valOut) {
+  HitecDBusLock lock(this);
+  for (HitecDListener *l = listeners; l != NULL; l = l->nextListener) {
+    l->onBeforeRegister(this, reg);
+  }
+  int res = readRawRegisterNoListeners(reg, valOut);
+  for (HitecDListener *l = listeners; l != NULL; l = l->nextListener) {
+    l->onReadRegister(this, reg, res, (res == HITECD_OK) ? *valOut : 0);
+  }
+  return res;
+}
+
+void HitecDServo::writeReadCommand(uint8_t reg) {
+  uint8_t command[HD_READ_COMMAND_LENGTH];
+  hitecdEncodeReadCommand(reg, command);
+
   uint8_t oldSREG = SREG;
   cli();
 
-  writeByte((uint8_t)0x96);
-  writeByte((uint8_t)0x00);
-  writeByte(reg);
-  writeByte((uint8_t)0x00);
-  uint8_t checksum = (0x00 + reg + 0x00) & 0xFF;
-  writeByte(checksum);
+  for (int i = 0; i < HD_READ_COMMAND_LENGTH; ++i) {
+    writeByte(command[i]);
+  }
   digitalWrite(pin, LOW);
 
   SREG = oldSREG;
+}
 
-  delay(14);
+int HitecDServo::readRawRegisterNoListeners(uint8_t reg, uint16_t *valOut) {
+  writeReadCommand(reg);
+
+  hitecdSleepMillis(14);
 
   /* Note, most of the pull-up current must actually provided by an external
   resistor; the microcontroller pullup by itself is nowhere near strong enough.
@@ -492,25 +891,22 @@ int HitecDServo::readRawRegister(uint8_t reg, uint16_t *valOut) {
   /* At this point, the servo should be pulling the pin low. If the pin goes
   high when we release the line, then no servo is connected. */
   if (digitalRead(pin) != LOW) {
-    delay(2);
+    hitecdSleepMillis(2);
     pinMode(pin, OUTPUT);
     return HITECD_ERR_NO_SERVO;
   }
 
-  oldSREG = SREG;
+  uint8_t oldSREG = SREG;
   cli();
 
-  int const0x69 = readByte();
-  int mystery = readByte(); /* I don't know what this byte is for... */
-  int reg2 = readByte();
-  int const0x02 = readByte();
-  int low = readByte();
-  int high = readByte();
-  int checksum2 = readByte();
+  int response[HD_RESPONSE_LENGTH];
+  for (int i = 0; i < HD_RESPONSE_LENGTH; ++i) {
+    response[i] = readByte();
+  }
 
   SREG = oldSREG;
   
-  delay(1);
+  hitecdSleepMillis(1);
 
   /* At this point, the servo should have released the line, allowing the
   pullup resistor to pull it high. If the pin is not high, there are two
@@ -527,7 +923,7 @@ int HitecDServo::readRawRegister(uint8_t reg, uint16_t *valOut) {
 
   pinMode(pin, OUTPUT);
   digitalWrite(pin, LOW);
-  delay(1);
+  hitecdSleepMillis(1);
 
   /* Note, readByte() can return HITECD_ERR_NO_SERVO if it times out. But, we
   know the servo is present, or else we'd have hit either HITECD_ERR_NO_SERVO or
@@ -535,39 +931,32 @@ int HitecDServo::readRawRegister(uint8_t reg, uint16_t *valOut) {
   something's horribly wrong. So for simplicity, we just round this off to
   HITECD_ERR_CORRUPT. */
 
-  if (const0x69 != 0x69) return HITECD_ERR_CORRUPT;
-  if (mystery < 0) return HITECD_ERR_CORRUPT;
-  if (reg2 != reg) return HITECD_ERR_CORRUPT;
-  if (const0x02 != 0x02) return HITECD_ERR_CORRUPT;
-  if (low < 0) return HITECD_ERR_CORRUPT;
-  if (high < 0) return HITECD_ERR_CORRUPT;
-  if (checksum2 != ((mystery + reg2 + const0x02 + low + high) & 0xFF)) {
-    return HITECD_ERR_CORRUPT;
-  }
-
-  *valOut = low + (high << 8);
-  return HITECD_OK;
+  return hitecdDecodeResponse(reg, response, valOut);
 }
 
 void HitecDServo::writeRawRegister(uint8_t reg, uint16_t val) {
+  HitecDBusLock lock(this);
+  for (HitecDListener *l = listeners; l != NULL; l = l->nextListener) {
+    l->onBeforeRegister(this, reg);
+  }
+  uint8_t command[HD_WRITE_COMMAND_LENGTH];
+  hitecdEncodeWriteCommand(reg, val, command);
+
   uint8_t oldSREG = SREG;
   cli();
 
-  writeByte((uint8_t)0x96);
-  writeByte((uint8_t)0x00);
-  writeByte(reg);
-  writeByte((uint8_t)0x02);
-  uint8_t low = val & 0xFF;
-  writeByte(low);
-  uint8_t high = (val >> 8) & 0xFF;
-  writeByte(high);
-  uint8_t checksum = (0x00 + reg + 0x02 + low + high) & 0xFF;
-  writeByte(checksum);
+  for (int i = 0; i < HD_WRITE_COMMAND_LENGTH; ++i) {
+    writeByte(command[i]);
+  }
 
   SREG = oldSREG;
 
   digitalWrite(pin, LOW);
-  delay(1);
+  hitecdSleepMillis(1);
+
+  for (HitecDListener *l = listeners; l != NULL; l = l->nextListener) {
+    l->onWriteRegister(this, reg, val);
+  }
 }
 
 #ifdef ARDUINO_ARCH_AVR
@@ -634,70 +1023,22 @@ void HitecDServo::writeByte(uint8_t val) {
   DELAY_US_COMPENSATED(8.68, 25);
 }
 
-#else
-#error "HitecDServo library only works on AVR processors."
-#endif
-
-HitecDSettings::HitecDSettings() :
-  id(defaultId),
-  counterclockwise(defaultCounterclockwise),
-  speed(defaultSpeed),
-  deadband(defaultDeadband),
-  softStart(defaultSoftStart),
-  rangeLeftAPV(-1),
-  rangeRightAPV(-1),
-  rangeCenterAPV(-1),
-  failSafe(defaultFailSafe),
-  failSafeLimp(defaultFailSafeLimp),
-  powerLimit(defaultPowerLimit),
-  overloadProtection(defaultOverloadProtection),
-  smartSense(defaultSmartSense),
-  sensitivityRatio(defaultSensitivityRatio)
-{ }
-
-int16_t HitecDSettings::defaultRangeLeftAPV(int modelNumber) {
-  switch (modelNumber) {
-    case 485: return 3381;
-    default: return -1;
-  }
-}
-
-int16_t HitecDSettings::defaultRangeRightAPV(int modelNumber) {
-  switch (modelNumber) {
-    case 485: return 13002;
-    default: return -1;
-  }
-}
+#elif defined(HITECD_HOST_SIM)
 
-int16_t HitecDSettings::defaultRangeCenterAPV(int modelNumber) {
-  switch (modelNumber) {
-    case 485: return 8192;
-    default: return -1;
-  }
-}
+/* On a PC, extras/host/sim stands in for the pin, and passes each byte to a
+simulated servo. */
 
-int16_t HitecDSettings::widestRangeLeftAPV(int modelNumber) {
-  switch (modelNumber) {
-    /* I measured 731, and added +50 as a margin of error */
-    case 485: return 731 + 50;
-    default: return -1;
-  }
+int HitecDServo::readByte() {
+  return hitecdSimReadByte(pin);
 }
 
-int16_t HitecDSettings::widestRangeRightAPV(int modelNumber) {
-  int16_t min = widestRangeLeftAPV(modelNumber);
-  if (min == -1) {
-    return -1;
-  }
-  return 0x3FFF - min;
+void HitecDServo::writeByte(uint8_t val) {
+  hitecdSimWriteByte(pin, val);
 }
 
-int16_t HitecDSettings::widestRangeCenterAPV(int modelNumber) {
-  if (widestRangeLeftAPV(modelNumber) == -1) {
-    return -1;
-  }
-  return 8192;
-}
+#else
+#error "HitecDServo library only works on AVR processors."
+#endif
 
 const __FlashStringHelper *hitecdErrToString(int err) {
   if (err >= 0) {
@@ -719,6 +1060,18 @@ const __FlashStringHelper *hitecdErrToString(int err) {
       return F("Unsupported model of servo.");
     case HITECD_ERR_CONFUSED:
       return F("Confusing response from servo.");
+    case HITECD_ERR_BOOTING:
+      return F("The servo is still booting, which takes 1000ms.");
+    case HITECD_ERR_NO_PULLUP:
+      return F("The pullup resistor is missing. With a 5V microcontroller, use "
+        "a 2k pullup resistor to +5V. With a 3.3V microcontroller, use a 1k "
+        "pullup resistor to +3.3V.");
+    case HITECD_ERR_WEAK_PULLUP:
+      return F("The pullup resistor is too weak, so the line rises too slowly "
+        "or not high enough. Use a smaller resistor, and check the wiring.");
+    case HITECD_ERR_STRONG_PULLUP:
+      return F("The pullup resistor is too strong, so the servo can't pull the "
+        "line low. Use a larger resistor.");
     default:
       return F("Unknown error.");
   }
@@ -3,7 +3,14 @@
 
 #include <Arduino.h>
 
-class HitecDSettings;
+#include "HitecDProtocol.h"
+#include "HitecDRTOS.h"
+#include "HitecDSettings.h"
+
+class HitecDListener;
+struct HitecDRegisterWrite;
+struct HitecDRegisterImage;
+struct HitecDLineDiagnostics;
 
 class HitecDServo {
 public:
@@ -11,8 +18,16 @@ public:
 
   /* Attach the HitecDServo to the given pin. Any digital pin works, even if
   it's not PWM-capable. If it successfully communicates with the servo, returns
-  HITECD_OK; if it fails, returns an error code (see below). */
-  int attach(int pin);
+  HITECD_OK; if it fails, returns an error code (see below).
+
+  If `diagnosisOut` is non-NULL, it's set to a more specific version of the
+  error, for the user to see. If attach() fails with
+  HITECD_ERR_BOOTING_OR_NO_PULLUP and the pin is analog-capable, attach() runs
+  diagnoseLine() to tell which it is, and sets `*diagnosisOut` to
+  HITECD_ERR_BOOTING or HITECD_ERR_NO_PULLUP. Otherwise, `*diagnosisOut` is
+  the same as the return value. (The return value itself stays
+  HITECD_ERR_BOOTING_OR_NO_PULLUP, so code that retries on it still works.) */
+  int attach(int pin, int *diagnosisOut = NULL);
 
   /* True if currently attached, false if not. */
   bool attached();
@@ -38,6 +53,24 @@ public:
   int16_t readCurrentQuarterMicros();
   int16_t readCurrentAPV();
 
+  /* Convert between APVs and quarter-microseconds of PWM width, using the
+  servo's range settings as of the last attach() or readSettings(). */
+  int16_t apvToQuarterMicros(int16_t apv);
+  int16_t quarterMicrosToAPV(int16_t quarterMicros);
+
+  /* Reads how hard the motor is currently working, in the same units as the
+  servo's internal power limit (0 to 2000, where 2000 is max power). The sign
+  indicates which direction the motor is pushing. If the motor is stalled, the
+  magnitude is equal to the effective power limit. */
+  int readMotorPower(int16_t *powerOut);
+
+  /* Changes the servo's power limit immediately, without saving it or
+  rebooting the servo. `powerLimit` is a percentage, as in HitecDSettings. The
+  change is lost when the servo reboots (e.g. after writeSettings()). This is
+  meant for changing the limit on the fly, e.g. to hold an object gently after
+  gripping it; for a permanent change, use writeSettings(). */
+  void writeLivePowerLimit(int16_t powerLimit);
+
   /* Returns the servo's model number, e.g. 485 for a D485HW model. */
   int readModelNumber();
 
@@ -65,13 +98,85 @@ public:
     const HitecDSettings &settings,
     bool allowUnsupportedModel);
 
+  /* Like writeSettings(), but uploads a list of register writes that was
+  prepared at compile time by HITECD_SETTINGS_PROGRAM() (see
+  HitecDSettingsProgram.h) instead of encoding the settings at runtime. Pass
+  the array itself; its length is taken from its type. The list must be stored
+  in PROGMEM. As with writeSettings(), wait 1000ms afterwards for the servo to
+  reboot.
+
+  Note: Right now, this only works for the D485HW model. Other models
+  will return an error. */
+  template<int length>
+  int writeSettingsProgram(const HitecDRegisterWrite (&programPGM)[length]) {
+    return writeSettingsProgramPGM(programPGM, length);
+  }
+
+  /* Waits for the servo to finish booting (e.g. after writeSettings()), by
+  watching for the servo to release the line. This is usually much faster than
+  waiting the full 1000ms. Returns HITECD_OK once the servo responds to
+  commands, or an error code if it still hasn't after `timeoutMillis`. If the
+  servo isn't booting, this takes about 40ms. */
+  int waitUntilBooted(unsigned long timeoutMillis = 2000);
+
+  /* Checks the electrical health of the line, and fills in `diagnosticsOut`.
+  Returns HITECD_OK if the line looks healthy, or one of HITECD_ERR_NO_SERVO,
+  HITECD_ERR_BOOTING, HITECD_ERR_NO_PULLUP, HITECD_ERR_WEAK_PULLUP, or
+  HITECD_ERR_STRONG_PULLUP. This works best if the pin is analog-capable (e.g.
+  A0-A5 on an Arduino Uno), because then the line voltage can be measured with
+  the ADC. On other pins, only the rise time is measured, and booting can't be
+  told apart from a missing pullup. Takes about 20ms. */
+  int diagnoseLine(HitecDLineDiagnostics *diagnosticsOut);
+
+  /* readRegisterImage() reads every even-numbered register into `imageOut`.
+  This captures the complete state of the servo, including many registers that
+  HitecDSettings doesn't cover. It takes a couple of seconds. */
+  int readRegisterImage(HitecDRegisterImage *imageOut);
+
+  /* writeRegisterImage() restores an image captured by readRegisterImage(). It
+  writes the same registers, in the same order, as the DPC-11's "OPEN" button
+  (see extras/DPC11Notes.md); then saves, reboots, and waits for the servo to
+  finish booting. Registers outside that list, such as the model number and the
+  current position, are left alone. The list does include the registers that
+  switch smart sense on and off (HD_REG_SS_ENABLE_* and HD_REG_SS_DISABLE_*), so
+  those are restored from the image too.
+
+  If `currentImage` is non-NULL, it should be a snapshot of the servo's current
+  state from readRegisterImage(); then registers that already have the right
+  value aren't written. The servo is never read register by register to check,
+  because a read takes more than ten times as long as the write it would save.
+
+  Warning: Many of these registers are undocumented. Restoring an image from a
+  different model of servo might damage it. */
+  int writeRegisterImage(
+    const HitecDRegisterImage &image,
+    const HitecDRegisterImage *currentImage = NULL);
+
   /* Directly read/write registers on the servo. Don't use this unless you know
   what you're doing. (The only reason these methods are declared public is so
   that examples/Programmer can access them for diagnostics and such.) */
   int readRawRegister(uint8_t reg, uint16_t *valOut);
   void writeRawRegister(uint8_t reg, uint16_t val);
 
+  /* Registers a listener to be told about every register read and write on
+  this servo. See HitecDListener below. */
+  void addListener(HitecDListener *listener);
+  void removeListener(HitecDListener *listener);
+
+  /* With FreeRTOS (see HitecDRTOS.h), these take and release this servo's
+  lock, so a task can perform several operations without other tasks getting
+  in between. Calls can be nested. Without FreeRTOS, they do nothing. */
+  void lockBus();
+  void unlockBus();
+
 private:
+  int readAttachRegisters();
+  int writeSettingsProgramPGM(
+    const HitecDRegisterWrite *programPGM,
+    int length);
+  int readRawRegisterNoListeners(uint8_t reg, uint16_t *valOut);
+  void writeReadCommand(uint8_t reg);
+  bool isAnalogPin();
   void writeByte(uint8_t value);
   int readByte();
 
@@ -81,176 +186,75 @@ private:
 
   int modelNumber;
   int16_t rangeLeftAPV, rangeRightAPV, rangeCenterAPV;
-};
 
-struct HitecDSettings {
-  /* The default constructor initializes the settings to factory-default values.
-  `rangeLeftAPV`, `rangeCenterAPV`, and `rangeRightAPV` will be set to -1;
-  this isn't the factory-default value, but it will cause `writeSettings()` to
-  keep the factory-default value. */
-  HitecDSettings();
-
-  /* `id` is an arbitrary number from 0 to 254. Intended for keeping track of
-  multiple servos. No effect on servo behavior. */
-  uint8_t id;
-  static const uint8_t defaultId = 0;
-
-  /* `counterclockwise=false` if increasing pulse widths make the servo turn
-  clockwise. `counterclockwise=true` if increasing pulse widths make the servo
-  turn counterclockwise.
-  
-  Note: Switching the servo direction will invert the meaning of the
-  `rangeLeftAPV`, `rangeRightAPV`, and `rangeCenterAPV` settings. If
-  you've changed those settings to non-default values, you can use the following
-  formulas to convert between the clockwise values and equivalent
-  counterclockwise values:
-    settings.rangeLeftAPV = HITECD_APV_MAX - prevRangeRightAPV;
-    settings.rangeCenterAPV = HITECD_APV_MAX - prevRangeCenterAPV;
-    settings.rangeRightAPV = HITECD_APV_MAX - prevRangeLeftAPV;
-  */
-  bool counterclockwise;
-  static const bool defaultCounterclockwise = false;
-
-  /* `speed` defines how fast the servo moves to a new position, as a percentage
-  of maximum speed. Legal values are 10, 20, 30, 40, 50, 60, 70, 80, 90, 100. */
-  int8_t speed;
-  static const int8_t defaultSpeed = 100;
-
-  /* `deadband` defines the servo deadband width. Small values make the servo
-  more precise, but it may jitter; or if multiple servos are physically
-  connected in parallel, they may fight each other. Larger values make the servo
-  more stable, but it will not react to small adjustments. Legal values are
-  1 (most precise), 2, 3, 4, 5, 6, 7, 8, 9, 10 (least jitter). */
-  int8_t deadband;
-  static const int8_t defaultDeadband = 1;
-
-  /* `softStart` limits how fast the servo moves when power is first applied.
-  If the servo is at the wrong position when power is first applied, soft start
-  can help prevent damage. This has no effect on how fast the servo moves during
-  normal operation. Legal values are 20, 40, 60, 80, 100. Setting
-  `softStart=100` means the servo starts at full power immediately. */
-  int8_t softStart;
-  static const int8_t defaultSoftStart = 20;
-
-  /* `rangeLeftAPV`, `rangeRightAPV` and `rangeCenterAPV` define the servo's
-  physical range of motion and its neutral point.
-  
-  What is "APV"? Internally, the D-series servos measure the physical servo
-  angle using a potentiometer. The angle potentiometer's values are represented
-  as numbers from 0 to HITECD_APV_MAX (=2**14-1). In this library, the
-  abbreviation "APV" stands for "Angle Potentiometer Value".
-
-  PWM pulse widths are related to APVs as follows:
-  - If the servo receives a 850us pulse, it will move to `rangeLeftAPV`.
-  - If the servo receives a 1500us pulse, it will move to `rangeCenterAPV`.
-  - If the servo receives a 2150us pulse, it will move to `rangeRightAPV`.
-  - In between, the servo will interpolate.
-
-  Note that APVs depend on the servo's direction. If `counterclockwise=false`,
-  higher APVs are clockwise. But if `counterclockwise=true`, higher APVs are
-  counterclockwise. This means `rangeLeftAPV < rangeCenterAPV < rangeRightAPV`
-  regardless of the servo's direction. But when `counterclockwise=true`, this
-  means that the `rangeLeftAPV` is actually the clockwise-most end of the range,
-  and `rangeRightAPV` is the counterclockwise-most end of the range.
-
-  If you call `writeSettings()` with `rangeLeftAPV`, `rangeRightAPV`, or
-  `rangeCenterAPV` set to -1, then the factory-default value will be used. */
-  int16_t rangeLeftAPV, rangeRightAPV, rangeCenterAPV;
+  HitecDListener *listeners;
 
-  /* Convenience functions to return the factory-default range APVs for the
-  given servo model. Right now this only works for the D485HW; other models will
-  return -1. */
-  static int16_t defaultRangeLeftAPV(int modelNumber);
-  static int16_t defaultRangeRightAPV(int modelNumber);
-  static int16_t defaultRangeCenterAPV(int modelNumber);
-
-  /* Convenience functions to return the min/max APVs that the servo can be
-  safely driven to without hitting physical stops. This may vary slightly from
-  servo to servo; these are conservative values. Right now this only works for
-  the D485HW; other models will return -1. */
-  static int16_t widestRangeLeftAPV(int modelNumber);
-  static int16_t widestRangeRightAPV(int modelNumber);
-  static int16_t widestRangeCenterAPV(int modelNumber);
-
-  /* If the servo isn't receiving a signal, it will move to a default position
-  defined by a pulse width of `failSafe` microseconds. If `failSafeLimp=true`,
-  then instead the servo will go limp. If `failSafe=0` and `failSafeLimp=false`,
-  the servo will hold its previous position (this behavior is the default). */
-  int16_t failSafe;
-  bool failSafeLimp;
-  static const int16_t defaultFailSafe = 0;
-  static const bool defaultFailSafeLimp = false;
-
-  /* `powerLimit` sets the maximum power that the servo can use. It ranges from
-  0 to 100 (the default). If set to less than about 10, the servo won't be
-  strong enough to overcome the friction of its own gearbox. If set to 0, the
-  servo will gently resist being moved, but won't attempt to return to the
-  target point.
-
-  Warning: Power limit is an undocumented setting, not supported by Hitec's
-  official programmer software. Use at your own risk. */
-  int16_t powerLimit;
-  static const int16_t defaultPowerLimit = 100;
-
-  /* If the servo is overloaded or stalled for more than about 3 seconds, then
-  it will automatically reduce power to `overloadProtection` percent to prevent
-  damage. Legal values are:
-  - 100 (no overload protection; the default)
-  - 10 (reduce power to 10% of max power)
-  - 20 (reduce power to 20% of max power)
-  - 30 (reduce power to 30% of max power)
-  - 40 (reduce power to 40% of max power)
-  - 50 (reduce power to 50% of max power)
-
-  This is multiplicative with `powerLimit`; for example, if `powerLimit=50` and
-  `overloadProtection=50`, then if overload protection kicks in, the servo will
-  use 25% of the maximum possible power.
-
-  (Note, the DPC-11 manual claims that the X% setting will reduce power _by_ X%.
-  I think this is an error; in my tests, the X% setting appears to reduce power
-  _to_ X%.) */
-  int8_t overloadProtection;
-  static const int8_t defaultOverloadProtection = 100;
-
-  /* `smartSense` is a Hitec proprietary feature that "allows the servo to
-  analyse operational feed back and automatically make on the fly parameter
-  adjustments to optimize performance", according to the Hitec manual. */
-  bool smartSense;
-  static const bool defaultSmartSense = true;
-
-  /* `sensitivityRatio` ranges from 819 to 4095. Higher values will make the
-  servo react faster to changes in input, but it may jitter more. Lower values
-  will make the servo more stable, but it may feel sluggish. If
-  `smartSense=true`, then `sensitivityRatio` is ignored. */
-  int16_t sensitivityRatio;
-  static const int16_t defaultSensitivityRatio = 4095;
+  /* With FreeRTOS, a recursive mutex (a SemaphoreHandle_t); otherwise NULL.
+  It's always declared, so the class has the same layout in every file, whether
+  or not that file was compiled with FreeRTOS support. */
+  void *busMutex;
 };
 
-/* Many of the functions in this library return error codes. The possible error
-codes are as follows: */
+/* A HitecDListener observes the register traffic of a HitecDServo. This lets
+diagnostic tools (e.g. HitecDRecorder) piggyback on reads and writes that the
+sketch is performing anyway, without adding any extra traffic. Subclass it and
+override whichever methods you need. */
+class HitecDListener {
+public:
+  HitecDListener() : nextListener(NULL) { }
+
+  /* Called just before every register read or write, e.g. to time it. */
+  virtual void onBeforeRegister(
+    HitecDServo * /* servo */, uint8_t /* reg */) { }
 
-/* OK (no error occurred) */
-#define HITECD_OK 1
+  /* Called after every register read. `res` is the result of the read; if it's
+  HITECD_OK then `val` is the value that was read. */
+  virtual void onReadRegister(
+    HitecDServo * /* servo */,
+    uint8_t /* reg */,
+    int /* res */,
+    uint16_t /* val */) { }
 
-/* attach() was not called, or the call to attach() failed. */
-#define HITECD_ERR_NOT_ATTACHED (-101)
+  /* Called after every register write. */
+  virtual void onWriteRegister(
+    HitecDServo * /* servo */, uint8_t /* reg */, uint16_t /* val */) { }
 
-/* No servo detected. */
-#define HITECD_ERR_NO_SERVO (-102)
+private:
+  friend class HitecDServo;
+  HitecDListener *nextListener;
+};
 
-/* Either the servo is still booting, which takes 1000ms; or the pullup resistor
-is missing. With a 5V microcontroller, use a 2k pullup resistor to +5V. With a
-3.3V microcontroller, use a 1k pullup resistor to +3.3V. */
-#define HITECD_ERR_BOOTING_OR_NO_PULLUP (-103)
+/* A snapshot of every even-numbered register on the servo. Uses 256 bytes of
+SRAM. */
+struct HitecDRegisterImage {
+  /* values[reg / 2] holds the value of register `reg`. */
+  uint16_t values[128];
 
-/* Corrupt response from servo. */
-#define HITECD_ERR_CORRUPT (-104)
+  uint16_t get(uint8_t reg) const { return values[reg / 2]; }
+};
 
-/* Unsupported model of servo. (Only D485HW is fully supported.) */
-#define HITECD_ERR_UNSUPPORTED_MODEL (-105)
+/* Results of HitecDServo::diagnoseLine(). Voltages are raw ADC readings (0 to
+1023, as a fraction of the supply voltage). Any value that couldn't be measured
+is -1. */
+struct HitecDLineDiagnostics {
+  /* Voltage when nobody is driving the line, so that the pullup resistor is
+  pulling it up against the servo's 3k pulldown resistor. */
+  int16_t releasedLevel;
+
+  /* Voltage while the servo is holding the line low, during the turnaround of a
+  register read. If the pullup is too strong, the servo can't pull the line low
+  enough. */
+  int16_t servoLowLevel;
+
+  /* Estimated pullup resistance, in ohms, computed from releasedLevel. */
+  int32_t pullupOhms;
+
+  /* Time for the line to rise to a logic high after the Arduino stops driving
+  it low, in nanoseconds. At 115200 baud, each bit is only 8680ns long. */
+  int32_t riseNanos;
+};
 
-/* Confusing response from servo. */
-#define HITECD_ERR_CONFUSED (-106)
+/* The error codes returned by this library are defined in HitecDProtocol.h. */
 
 /* `hitecdErrToString()` returns a string description of the given error code.
 You can print this with Serial for debugging purposes. For example:
@@ -263,10 +267,4 @@ You can print this with Serial for debugging purposes. For example:
 macro. This saves SRAM by allowing the error messages to be stored in flash.) */
 const __FlashStringHelper *hitecdErrToString(int err);
 
-/* The theoretical range of APVs is from 0 to HITECD_APV_MAX.
-Warning: The servo can't physically move to the extreme ends of the range, and
-trying to do so might damage it. For actual safe min/max values, see
-widestRangeLeftAPV() and widestRangeRightAPV(). */
-#define HITECD_APV_MAX 16383 /* = 2**14 - 1 */
-
 #endif /* HitecDServo_h */
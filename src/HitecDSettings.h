@@ -0,0 +1,295 @@
+#ifndef HitecDSettings_h
+#define HitecDSettings_h
+
+#include <stdint.h>
+
+/* The servo's settings, as read by HitecDServo::readSettings() and written by
+HitecDServo::writeSettings(). Like HitecDProtocol.h, this doesn't depend on
+Arduino, so host-side code (extras/host) uses the same struct. */
+
+/* The theoretical range of APVs is from 0 to HITECD_APV_MAX.
+Warning: The servo can't physically move to the extreme ends of the range, and
+trying to do so might damage it. For actual safe min/max values, see
+widestRangeLeftAPV() and widestRangeRightAPV(). */
+#define HITECD_APV_MAX 16383 /* = 2**14 - 1 */
+
+struct HitecDSettings {
+  /* The default constructor initializes the settings to factory-default values.
+  `rangeLeftAPV`, `rangeCenterAPV`, and `rangeRightAPV` will be set to -1;
+  this isn't the factory-default value, but it will cause `writeSettings()` to
+  keep the factory-default value. */
+  constexpr HitecDSettings() :
+    HitecDSettings(
+      defaultId,
+      defaultCounterclockwise,
+      defaultSpeed,
+      defaultDeadband,
+      defaultSoftStart,
+      -1,
+      -1,
+      -1,
+      defaultFailSafe,
+      defaultFailSafeLimp,
+      defaultPowerLimit,
+      defaultOverloadProtection,
+      defaultSmartSense,
+      defaultSensitivityRatio)
+  { }
+
+  /* Initializes every field explicitly, in the order they're declared below.
+  Mostly useful for building settings at compile time; the with*() methods are
+  usually more convenient. */
+  constexpr HitecDSettings(
+    uint8_t _id,
+    bool _counterclockwise,
+    int8_t _speed,
+    int8_t _deadband,
+    int8_t _softStart,
+    int16_t _rangeLeftAPV,
+    int16_t _rangeRightAPV,
+    int16_t _rangeCenterAPV,
+    int16_t _failSafe,
+    bool _failSafeLimp,
+    int16_t _powerLimit,
+    int8_t _overloadProtection,
+    bool _smartSense,
+    int16_t _sensitivityRatio
+  ) :
+    id(_id),
+    counterclockwise(_counterclockwise),
+    speed(_speed),
+    deadband(_deadband),
+    softStart(_softStart),
+    rangeLeftAPV(_rangeLeftAPV),
+    rangeRightAPV(_rangeRightAPV),
+    rangeCenterAPV(_rangeCenterAPV),
+    failSafe(_failSafe),
+    failSafeLimp(_failSafeLimp),
+    powerLimit(_powerLimit),
+    overloadProtection(_overloadProtection),
+    smartSense(_smartSense),
+    sensitivityRatio(_sensitivityRatio)
+  { }
+
+  /* Each with*() method returns a copy of the settings with one field changed.
+  These can be chained to declare settings at compile time, e.g.:
+      constexpr HitecDSettings armSettings =
+        HitecDSettings().withSpeed(50).withCounterclockwise(true);
+  */
+  constexpr HitecDSettings withId(uint8_t _id) const {
+    return HitecDSettings(_id, counterclockwise, speed, deadband, softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, failSafe, failSafeLimp,
+      powerLimit, overloadProtection, smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withCounterclockwise(bool _counterclockwise) const {
+    return HitecDSettings(id, _counterclockwise, speed, deadband, softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, failSafe, failSafeLimp,
+      powerLimit, overloadProtection, smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withSpeed(int8_t _speed) const {
+    return HitecDSettings(id, counterclockwise, _speed, deadband, softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, failSafe, failSafeLimp,
+      powerLimit, overloadProtection, smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withDeadband(int8_t _deadband) const {
+    return HitecDSettings(id, counterclockwise, speed, _deadband, softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, failSafe, failSafeLimp,
+      powerLimit, overloadProtection, smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withSoftStart(int8_t _softStart) const {
+    return HitecDSettings(id, counterclockwise, speed, deadband, _softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, failSafe, failSafeLimp,
+      powerLimit, overloadProtection, smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withRangeAPV(
+    int16_t _rangeLeftAPV, int16_t _rangeRightAPV, int16_t _rangeCenterAPV
+  ) const {
+    return HitecDSettings(id, counterclockwise, speed, deadband, softStart,
+      _rangeLeftAPV, _rangeRightAPV, _rangeCenterAPV, failSafe, failSafeLimp,
+      powerLimit, overloadProtection, smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withFailSafe(
+    int16_t _failSafe, bool _failSafeLimp
+  ) const {
+    return HitecDSettings(id, counterclockwise, speed, deadband, softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, _failSafe, _failSafeLimp,
+      powerLimit, overloadProtection, smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withPowerLimit(int16_t _powerLimit) const {
+    return HitecDSettings(id, counterclockwise, speed, deadband, softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, failSafe, failSafeLimp,
+      _powerLimit, overloadProtection, smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withOverloadProtection(
+    int8_t _overloadProtection
+  ) const {
+    return HitecDSettings(id, counterclockwise, speed, deadband, softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, failSafe, failSafeLimp,
+      powerLimit, _overloadProtection, smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withSmartSense(bool _smartSense) const {
+    return HitecDSettings(id, counterclockwise, speed, deadband, softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, failSafe, failSafeLimp,
+      powerLimit, overloadProtection, _smartSense, sensitivityRatio);
+  }
+  constexpr HitecDSettings withSensitivityRatio(
+    int16_t _sensitivityRatio
+  ) const {
+    return HitecDSettings(id, counterclockwise, speed, deadband, softStart,
+      rangeLeftAPV, rangeRightAPV, rangeCenterAPV, failSafe, failSafeLimp,
+      powerLimit, overloadProtection, smartSense, _sensitivityRatio);
+  }
+
+  /* `id` is an arbitrary number from 0 to 254. Intended for keeping track of
+  multiple servos. No effect on servo behavior. */
+  uint8_t id;
+  static const uint8_t defaultId = 0;
+
+  /* `counterclockwise=false` if increasing pulse widths make the servo turn
+  clockwise. `counterclockwise=true` if increasing pulse widths make the servo
+  turn counterclockwise.
+  
+  Note: Switching the servo direction will invert the meaning of the
+  `rangeLeftAPV`, `rangeRightAPV`, and `rangeCenterAPV` settings. If
+  you've changed those settings to non-default values, you can use the following
+  formulas to convert between the clockwise values and equivalent
+  counterclockwise values:
+    settings.rangeLeftAPV = HITECD_APV_MAX - prevRangeRightAPV;
+    settings.rangeCenterAPV = HITECD_APV_MAX - prevRangeCenterAPV;
+    settings.rangeRightAPV = HITECD_APV_MAX - prevRangeLeftAPV;
+  */
+  bool counterclockwise;
+  static const bool defaultCounterclockwise = false;
+
+  /* `speed` defines how fast the servo moves to a new position, as a percentage
+  of maximum speed. Legal values are 10, 20, 30, 40, 50, 60, 70, 80, 90, 100. */
+  int8_t speed;
+  static const int8_t defaultSpeed = 100;
+
+  /* `deadband` defines the servo deadband width. Small values make the servo
+  more precise, but it may jitter; or if multiple servos are physically
+  connected in parallel, they may fight each other. (For a pair of servos on
+  one joint, HitecDGangedPair avoids this without widening the deadband.)
+  Larger values make the servo more stable, but it will not react to small
+  adjustments. Legal values are 1 (most precise), 2, 3, 4, 5, 6, 7, 8, 9, 10
+  (least jitter). */
+  int8_t deadband;
+  static const int8_t defaultDeadband = 1;
+
+  /* `softStart` limits how fast the servo moves when power is first applied.
+  If the servo is at the wrong position when power is first applied, soft start
+  can help prevent damage. This has no effect on how fast the servo moves during
+  normal operation. Legal values are 20, 40, 60, 80, 100. Setting
+  `softStart=100` means the servo starts at full power immediately. */
+  int8_t softStart;
+  static const int8_t defaultSoftStart = 20;
+
+  /* `rangeLeftAPV`, `rangeRightAPV` and `rangeCenterAPV` define the servo's
+  physical range of motion and its neutral point.
+  
+  What is "APV"? Internally, the D-series servos measure the physical servo
+  angle using a potentiometer. The angle potentiometer's values are represented
+  as numbers from 0 to HITECD_APV_MAX (=2**14-1). In this library, the
+  abbreviation "APV" stands for "Angle Potentiometer Value".
+
+  PWM pulse widths are related to APVs as follows:
+  - If the servo receives a 850us pulse, it will move to `rangeLeftAPV`.
+  - If the servo receives a 1500us pulse, it will move to `rangeCenterAPV`.
+  - If the servo receives a 2150us pulse, it will move to `rangeRightAPV`.
+  - In between, the servo will interpolate.
+
+  Note that APVs depend on the servo's direction. If `counterclockwise=false`,
+  higher APVs are clockwise. But if `counterclockwise=true`, higher APVs are
+  counterclockwise. This means `rangeLeftAPV < rangeCenterAPV < rangeRightAPV`
+  regardless of the servo's direction. But when `counterclockwise=true`, this
+  means that the `rangeLeftAPV` is actually the clockwise-most end of the range,
+  and `rangeRightAPV` is the counterclockwise-most end of the range.
+
+  If you call `writeSettings()` with `rangeLeftAPV`, `rangeRightAPV`, or
+  `rangeCenterAPV` set to -1, then the factory-default value will be used. */
+  int16_t rangeLeftAPV, rangeRightAPV, rangeCenterAPV;
+
+  /* Convenience functions to return the factory-default range APVs for the
+  given servo model. Right now this only works for the D485HW; other models will
+  return -1. */
+  static constexpr int16_t defaultRangeLeftAPV(int modelNumber) {
+    return (modelNumber == 485) ? 3381 : -1;
+  }
+  static constexpr int16_t defaultRangeRightAPV(int modelNumber) {
+    return (modelNumber == 485) ? 13002 : -1;
+  }
+  static constexpr int16_t defaultRangeCenterAPV(int modelNumber) {
+    return (modelNumber == 485) ? 8192 : -1;
+  }
+
+  /* Convenience functions to return the min/max APVs that the servo can be
+  safely driven to without hitting physical stops. This may vary slightly from
+  servo to servo; these are conservative values. Right now this only works for
+  the D485HW; other models will return -1. */
+  static constexpr int16_t widestRangeLeftAPV(int modelNumber) {
+    /* I measured 731 on the D485HW, and added +50 as a margin of error */
+    return (modelNumber == 485) ? 731 + 50 : -1;
+  }
+  static constexpr int16_t widestRangeRightAPV(int modelNumber) {
+    return (widestRangeLeftAPV(modelNumber) == -1) ? -1 :
+      0x3FFF - widestRangeLeftAPV(modelNumber);
+  }
+  static constexpr int16_t widestRangeCenterAPV(int modelNumber) {
+    return (widestRangeLeftAPV(modelNumber) == -1) ? -1 : 8192;
+  }
+
+  /* If the servo isn't receiving a signal, it will move to a default position
+  defined by a pulse width of `failSafe` microseconds. If `failSafeLimp=true`,
+  then instead the servo will go limp. If `failSafe=0` and `failSafeLimp=false`,
+  the servo will hold its previous position (this behavior is the default). */
+  int16_t failSafe;
+  bool failSafeLimp;
+  static const int16_t defaultFailSafe = 0;
+  static const bool defaultFailSafeLimp = false;
+
+  /* `powerLimit` sets the maximum power that the servo can use. It ranges from
+  0 to 100 (the default). If set to less than about 10, the servo won't be
+  strong enough to overcome the friction of its own gearbox. If set to 0, the
+  servo will gently resist being moved, but won't attempt to return to the
+  target point.
+
+  Warning: Power limit is an undocumented setting, not supported by Hitec's
+  official programmer software. Use at your own risk. */
+  int16_t powerLimit;
+  static const int16_t defaultPowerLimit = 100;
+
+  /* If the servo is overloaded or stalled for more than about 3 seconds, then
+  it will automatically reduce power to `overloadProtection` percent to prevent
+  damage. Legal values are:
+  - 100 (no overload protection; the default)
+  - 10 (reduce power to 10% of max power)
+  - 20 (reduce power to 20% of max power)
+  - 30 (reduce power to 30% of max power)
+  - 40 (reduce power to 40% of max power)
+  - 50 (reduce power to 50% of max power)
+
+  This is multiplicative with `powerLimit`; for example, if `powerLimit=50` and
+  `overloadProtection=50`, then if overload protection kicks in, the servo will
+  use 25% of the maximum possible power.
+
+  (Note, the DPC-11 manual claims that the X% setting will reduce power _by_ X%.
+  I think this is an error; in my tests, the X% setting appears to reduce power
+  _to_ X%.) */
+  int8_t overloadProtection;
+  static const int8_t defaultOverloadProtection = 100;
+
+  /* `smartSense` is a Hitec proprietary feature that "allows the servo to
+  analyse operational feed back and automatically make on the fly parameter
+  adjustments to optimize performance", according to the Hitec manual. */
+  bool smartSense;
+  static const bool defaultSmartSense = true;
+
+  /* `sensitivityRatio` ranges from 819 to 4095. Higher values will make the
+  servo react faster to changes in input, but it may jitter more. Lower values
+  will make the servo more stable, but it may feel sluggish. If
+  `smartSense=true`, then `sensitivityRatio` is ignored. */
+  int16_t sensitivityRatio;
+  static const int16_t defaultSensitivityRatio = 4095;
+};
+
+#endif /* HitecDSettings_h */
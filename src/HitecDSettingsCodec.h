@@ -0,0 +1,255 @@
+#ifndef HitecDSettingsCodec_h
+#define HitecDSettingsCodec_h
+
+#include <stdint.h>
+
+#include "HitecDProtocol.h"
+#include "HitecDSettings.h"
+#include "HitecDSettingsRegisters.h"
+
+/* Converts between HitecDSettings and the values of the settings registers.
+HitecDServo::readSettings() and writeSettings(), HITECD_SETTINGS_PROGRAM(), and
+the host-side HitecDHostLine all go through these functions, so they agree on
+the encoding. Like HitecDProtocol.h, nothing in here depends on Arduino. */
+
+/* The following functions check that each setting has a legal value, as
+documented in HitecDSettings.h. */
+
+constexpr bool hitecdIsLegalId(uint8_t id) {
+  return id <= 254;
+}
+
+constexpr bool hitecdIsLegalSpeed(int8_t speed) {
+  return speed >= 10 && speed <= 100 && speed % 10 == 0;
+}
+
+constexpr bool hitecdIsLegalDeadband(int8_t deadband) {
+  return deadband >= 1 && deadband <= 10;
+}
+
+constexpr bool hitecdIsLegalSoftStart(int8_t softStart) {
+  return softStart >= 20 && softStart <= 100 && softStart % 20 == 0;
+}
+
+constexpr bool hitecdIsLegalRangeAPV(int16_t apv) {
+  return apv == -1 || (apv >= 0 && apv <= HITECD_APV_MAX);
+}
+
+/* If all three range points are given, the center must lie between the
+endpoints. */
+constexpr bool hitecdIsLegalRangeOrder(const HitecDSettings &settings) {
+  return settings.rangeLeftAPV == -1 ||
+    settings.rangeRightAPV == -1 ||
+    settings.rangeCenterAPV == -1 ||
+    (settings.rangeLeftAPV < settings.rangeCenterAPV &&
+      settings.rangeCenterAPV < settings.rangeRightAPV);
+}
+
+constexpr bool hitecdIsLegalFailSafe(int16_t failSafe, bool failSafeLimp) {
+  return (failSafe == 0) ||
+    (!failSafeLimp && failSafe >= 850 && failSafe <= 2150);
+}
+
+constexpr bool hitecdIsLegalPowerLimit(int16_t powerLimit) {
+  return powerLimit >= 0 && powerLimit <= 100;
+}
+
+constexpr bool hitecdIsLegalOverloadProtection(int8_t overloadProtection) {
+  return overloadProtection == 100 ||
+    (overloadProtection >= 10 && overloadProtection <= 50 &&
+      overloadProtection % 10 == 0);
+}
+
+constexpr bool hitecdIsLegalSensitivityRatio(int16_t sensitivityRatio) {
+  return sensitivityRatio >= HD_SENSITIVITY_RATIO_MIN &&
+    sensitivityRatio <= HD_SENSITIVITY_RATIO_MAX;
+}
+
+/* The following functions encode each setting into register values, for
+HITECD_SETTINGS_PROGRAM(), writeSettings(), and HitecDHostLine::writeSettings().
+See HitecDSettingsRegisters.h for the meaning of each register. */
+
+constexpr uint16_t hitecdEncodeDirection(bool counterclockwise) {
+  return counterclockwise ?
+    HD_DIRECTION_COUNTERCLOCKWISE : HD_DIRECTION_CLOCKWISE;
+}
+
+constexpr uint16_t hitecdEncodeSpeed(int8_t speed) {
+  return (speed == 100) ? 0x0FFF : speed / 5;
+}
+
+constexpr uint16_t hitecdEncodeDeadband1(int8_t deadband) {
+  return (deadband == 1) ? 1 : 4 * deadband - 4;
+}
+
+constexpr uint16_t hitecdEncodeDeadband2(int8_t deadband) {
+  return (deadband == 1) ? 5 : 4 * deadband;
+}
+
+constexpr uint16_t hitecdEncodeDeadband3(int8_t deadband) {
+  return (deadband == 1) ? 11 : 4 * deadband + 6;
+}
+
+constexpr uint16_t hitecdEncodeSoftStart(int8_t softStart) {
+  return (softStart == 40) ? HD_SOFT_START_40 :
+    (softStart == 60) ? HD_SOFT_START_60 :
+    (softStart == 80) ? HD_SOFT_START_80 :
+    (softStart == 100) ? HD_SOFT_START_100 :
+    HD_SOFT_START_20;
+}
+
+constexpr uint16_t hitecdEncodeFailSafe(int16_t failSafe, bool failSafeLimp) {
+  return (failSafe != 0) ? failSafe :
+    failSafeLimp ? HD_FAIL_SAFE_LIMP : HD_FAIL_SAFE_OFF;
+}
+
+constexpr uint16_t hitecdEncodePowerLimit(int16_t powerLimit) {
+  return (powerLimit == 100) ? 0x0FFF : powerLimit * (HD_POWER_LIMIT_MAX / 100);
+}
+
+/* writeSettings() reads the smart-sense magic numbers from the servo; these are
+the values observed on the D485HW, for when that isn't possible. */
+constexpr uint16_t hitecdEncodeSmartSense1(bool smartSense) {
+  return smartSense ? HD_SS_ENABLE_1_CONST : HD_SS_DISABLE_1_CONST;
+}
+
+constexpr uint16_t hitecdEncodeSmartSense2(bool smartSense) {
+  return smartSense ? HD_SS_ENABLE_2_CONST : HD_SS_DISABLE_2_CONST;
+}
+
+/* The following functions decode register values back into settings, for
+readSettings(). Each returns HITECD_OK, or HITECD_ERR_CONFUSED if the values
+aren't ones that the encoders above (or the DPC-11) would have written. */
+
+inline int hitecdDecodeId(uint16_t val, uint8_t *idOut) {
+  if (val > 255) {
+    return HITECD_ERR_CONFUSED;
+  }
+  *idOut = val;
+  return HITECD_OK;
+}
+
+inline int hitecdDecodeDirection(uint16_t val, bool *counterclockwiseOut) {
+  if (val == HD_DIRECTION_CLOCKWISE) {
+    *counterclockwiseOut = false;
+  } else if (val == HD_DIRECTION_COUNTERCLOCKWISE) {
+    *counterclockwiseOut = true;
+  } else {
+    return HITECD_ERR_CONFUSED;
+  }
+  return HITECD_OK;
+}
+
+inline int hitecdDecodeSpeed(uint16_t val, int8_t *speedOut) {
+  if (val == 0x0FFF) {
+    *speedOut = 100;
+  } else if (val < 20) {
+    *speedOut = val*5;
+  } else {
+    return HITECD_ERR_CONFUSED;
+  }
+  return HITECD_OK;
+}
+
+/* There are three deadband-related registers; their values are expected to be
+consistent with each other. */
+inline int hitecdDecodeDeadband(
+  uint16_t deadband1,
+  uint16_t deadband2,
+  uint16_t deadband3,
+  int8_t *deadbandOut
+) {
+  if (deadband1 == 1 && deadband2 == 5 && deadband3 == 11) {
+    *deadbandOut = 1;
+  } else if (deadband1 >= 4 && deadband1 <= 36 && deadband1 % 4 == 0 &&
+      deadband2 == deadband1 + 4 && deadband3 == deadband1 + 10) {
+    *deadbandOut = deadband1 / 4 + 1;
+  } else {
+    return HITECD_ERR_CONFUSED;
+  }
+  return HITECD_OK;
+}
+
+inline int hitecdDecodeSoftStart(uint16_t val, int8_t *softStartOut) {
+  if (val == HD_SOFT_START_20) {
+    *softStartOut = 20;
+  } else if (val == HD_SOFT_START_40) {
+    *softStartOut = 40;
+  } else if (val == HD_SOFT_START_60) {
+    *softStartOut = 60;
+  } else if (val == HD_SOFT_START_80) {
+    *softStartOut = 80;
+  } else if (val == HD_SOFT_START_100) {
+    *softStartOut = 100;
+  } else {
+    return HITECD_ERR_CONFUSED;
+  }
+  return HITECD_OK;
+}
+
+/* A single register controls both failSafe and failSafeLimp. */
+inline int hitecdDecodeFailSafe(
+  uint16_t val,
+  int16_t *failSafeOut,
+  bool *failSafeLimpOut
+) {
+  if (val >= 850 && val <= 2150) {
+    *failSafeOut = val;
+    *failSafeLimpOut = false;
+  } else if (val == HD_FAIL_SAFE_LIMP) {
+    *failSafeOut = 0;
+    *failSafeLimpOut = true;
+  } else if (val == HD_FAIL_SAFE_OFF) {
+    *failSafeOut = 0;
+    *failSafeLimpOut = false;
+  } else {
+    return HITECD_ERR_CONFUSED;
+  }
+  return HITECD_OK;
+}
+
+inline int hitecdDecodePowerLimit(uint16_t val, int16_t *powerLimitOut) {
+  if (val == 0x0FFF) {
+    *powerLimitOut = 100;
+  } else {
+    /* Divide rounding up, so nonzero values stay nonzero */
+    *powerLimitOut =
+      (val + HD_POWER_LIMIT_MAX / 100 - 1) / (HD_POWER_LIMIT_MAX / 100);
+  }
+  return HITECD_OK;
+}
+
+/* If smartSense is enabled, the two SMART_SENSE registers hold the values of
+the read-only SS_ENABLE registers; if it's disabled, they hold the values of
+the SS_DISABLE registers. So this takes all six. */
+inline int hitecdDecodeSmartSense(
+  uint16_t smartSense1,
+  uint16_t smartSense2,
+  uint16_t ssEnable1,
+  uint16_t ssEnable2,
+  uint16_t ssDisable1,
+  uint16_t ssDisable2,
+  bool *smartSenseOut
+) {
+  if (smartSense1 == ssEnable1 && smartSense2 == ssEnable2) {
+    *smartSenseOut = true;
+  } else if (smartSense1 == ssDisable1 && smartSense2 == ssDisable2) {
+    *smartSenseOut = false;
+  } else {
+    return HITECD_ERR_CONFUSED;
+  }
+  return HITECD_OK;
+}
+
+inline int hitecdDecodeSensitivityRatio(
+  uint16_t val,
+  int16_t *sensitivityRatioOut
+) {
+  if (val < HD_SENSITIVITY_RATIO_MIN || val > HD_SENSITIVITY_RATIO_MAX) {
+    return HITECD_ERR_CONFUSED;
+  }
+  *sensitivityRatioOut = val;
+  return HITECD_OK;
+}
+
+#endif /* HitecDSettingsCodec_h */
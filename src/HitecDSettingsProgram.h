@@ -0,0 +1,105 @@
+#ifndef HitecDSettingsProgram_h
+#define HitecDSettingsProgram_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+#include "HitecDSettingsCodec.h"
+
+/* If the settings for a servo are fixed when the sketch is compiled, there's no
+need to carry writeSettings()'s encoding logic around at runtime.
+HITECD_SETTINGS_PROGRAM() checks the settings with static_assert and encodes
+them into a PROGMEM table of register writes, which writeSettingsProgram() then
+streams to the servo. For example:
+
+    constexpr HitecDSettings armSettings =
+      HitecDSettings().withSpeed(50).withDeadband(3);
+    HITECD_SETTINGS_PROGRAM(armProgram, armSettings);
+
+    void setup() {
+      servo.attach(2);
+      servo.writeSettingsProgram(armProgram);
+      delay(1000);
+    }
+*/
+
+struct HitecDRegisterWrite {
+  uint8_t reg;
+  uint16_t val;
+};
+
+/* Entries with this register are skipped. (All valid registers are
+even-numbered, so this can't collide with a real register.) This is used for
+range settings that are set to -1, meaning "keep the factory default". */
+#define HITECD_SKIP_REG 0xFF
+
+/* Number of entries in every table produced by HITECD_SETTINGS_PROGRAM(). */
+#define HITECD_SETTINGS_PROGRAM_LENGTH 21
+
+/* The type of those tables. A pointer to one keeps the length, so it can be
+stored in a lookup table and still passed to writeSettingsProgram(). */
+typedef HitecDRegisterWrite
+  HitecDSettingsProgramTable[HITECD_SETTINGS_PROGRAM_LENGTH];
+
+constexpr uint8_t hitecdRangeReg(uint8_t reg, int16_t apv) {
+  return (apv == -1) ? HITECD_SKIP_REG : reg;
+}
+
+/* Declares a PROGMEM array `name` of HITECD_SETTINGS_PROGRAM_LENGTH register
+writes. `settings` must be a constexpr HitecDSettings; compilation fails if any
+setting is out of range. */
+#define HITECD_SETTINGS_PROGRAM(name, settings) \
+  static_assert(hitecdIsLegalId((settings).id), \
+    "id must be from 0 to 254"); \
+  static_assert(hitecdIsLegalSpeed((settings).speed), \
+    "speed must be 10, 20, ... 100"); \
+  static_assert(hitecdIsLegalDeadband((settings).deadband), \
+    "deadband must be from 1 to 10"); \
+  static_assert(hitecdIsLegalSoftStart((settings).softStart), \
+    "softStart must be 20, 40, ... 100"); \
+  static_assert(hitecdIsLegalRangeAPV((settings).rangeLeftAPV) && \
+    hitecdIsLegalRangeAPV((settings).rangeRightAPV) && \
+    hitecdIsLegalRangeAPV((settings).rangeCenterAPV), \
+    "range APVs must be -1 or from 0 to HITECD_APV_MAX"); \
+  static_assert(hitecdIsLegalRangeOrder(settings), \
+    "rangeCenterAPV must be between rangeLeftAPV and rangeRightAPV"); \
+  static_assert(hitecdIsLegalFailSafe( \
+    (settings).failSafe, (settings).failSafeLimp), \
+    "failSafe must be 0 or from 850 to 2150, and 0 if failSafeLimp"); \
+  static_assert(hitecdIsLegalPowerLimit((settings).powerLimit), \
+    "powerLimit must be from 0 to 100"); \
+  static_assert( \
+    hitecdIsLegalOverloadProtection((settings).overloadProtection), \
+    "overloadProtection must be 10, 20, ... 50, or 100"); \
+  static_assert(hitecdIsLegalSensitivityRatio((settings).sensitivityRatio), \
+    "sensitivityRatio must be from 819 to 4095"); \
+  const HitecDSettingsProgramTable name PROGMEM = { \
+    {HD_REG_FACTORY_RESET, HD_FACTORY_RESET_CONST}, \
+    {HD_REG_MYSTERY_OP1, HD_MYSTERY_OP1_CONST}, \
+    {HD_REG_MYSTERY_OP2, HD_MYSTERY_OP2_CONST}, \
+    {HD_REG_ID, (settings).id}, \
+    {HD_REG_DIRECTION, hitecdEncodeDirection((settings).counterclockwise)}, \
+    {HD_REG_SPEED, hitecdEncodeSpeed((settings).speed)}, \
+    {HD_REG_MYSTERY_DB, HD_MYSTERY_DB_CONST}, \
+    {HD_REG_DEADBAND_1, hitecdEncodeDeadband1((settings).deadband)}, \
+    {HD_REG_DEADBAND_2, hitecdEncodeDeadband2((settings).deadband)}, \
+    {HD_REG_DEADBAND_3, hitecdEncodeDeadband3((settings).deadband)}, \
+    {HD_REG_SOFT_START, hitecdEncodeSoftStart((settings).softStart)}, \
+    {hitecdRangeReg(HD_REG_RANGE_LEFT_APV, (settings).rangeLeftAPV), \
+      (uint16_t)(settings).rangeLeftAPV}, \
+    {hitecdRangeReg(HD_REG_RANGE_RIGHT_APV, (settings).rangeRightAPV), \
+      (uint16_t)(settings).rangeRightAPV}, \
+    {hitecdRangeReg(HD_REG_RANGE_CENTER_APV, (settings).rangeCenterAPV), \
+      (uint16_t)(settings).rangeCenterAPV}, \
+    {HD_REG_FAIL_SAFE, \
+      hitecdEncodeFailSafe((settings).failSafe, (settings).failSafeLimp)}, \
+    {HD_REG_POWER_LIMIT, hitecdEncodePowerLimit((settings).powerLimit)}, \
+    {HD_REG_OVERLOAD_PROTECTION, \
+      (uint16_t)(settings).overloadProtection}, \
+    {HD_REG_MYSTERY_DB, HD_MYSTERY_DB_CONST}, \
+    {HD_REG_SMART_SENSE_1, hitecdEncodeSmartSense1((settings).smartSense)}, \
+    {HD_REG_SMART_SENSE_2, hitecdEncodeSmartSense2((settings).smartSense)}, \
+    {HD_REG_SENSITIVITY_RATIO, (uint16_t)(settings).sensitivityRatio}, \
+  }
+
+#endif /* HitecDSettingsProgram_h */
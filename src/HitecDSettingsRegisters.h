@@ -0,0 +1,113 @@
+#ifndef HitecDSettingsRegisters_h
+#define HitecDSettingsRegisters_h
+
+/* The registers that make up the servo's settings, and the magic values that
+the DPC-11 writes along with them. This is the part of HitecDServoInternal.h
+that HITECD_SETTINGS_PROGRAM() needs when the sketch is compiled; see that file
+for the rest of the register map and for notes on the protocol. */
+
+/* ID is an arbitrary user-settable identifier from 0 to 254. */
+#define HD_REG_ID 0x32
+
+/* DIRECTION sets whether longer PWM pulses make the servo move clockwise or
+counterclockwise. */
+#define HD_REG_DIRECTION 0x5E
+#define HD_DIRECTION_CLOCKWISE 0 /* default */
+#define HD_DIRECTION_COUNTERCLOCKWISE 1
+
+/* SPEED sets the servo movement speed.
+- SPEED=2 means 10% of max speed, SPEED=4 means 20% of max speed, and so on.
+- As an exception, max speed (the default) is SPEED=0xFFF instead of SPEED=20.
+- The programmer only allows setting increments of 10%, but in EPA setting mode
+  the programmer sets SPEED=5, which would correspond to 25% speed. */
+#define HD_REG_SPEED 0x54
+
+/* DEADBAND_1, DEADBAND_2, and DEADBAND_3 together control the servo deadband.
+- If deadband == 1, then DEADBAND_1=1; DEADBAND_2=5; and DEADBAND_3=11. This is
+  the default setting.
+- If deadband > 1, then:
+  - DEADBAND_1 = 4*deadband-4
+  - DEADBAND_2 = 4*deadband
+  - DEADBAND_3 = 4*deadband+6 */
+#define HD_REG_DEADBAND_1 0x4E
+#define HD_REG_DEADBAND_2 0x66
+#define HD_REG_DEADBAND_3 0x68
+
+/* SOFT_START defines the servo's soft-start behavior. */
+#define HD_REG_SOFT_START 0x60
+#define HD_SOFT_START_20 1 /* default */
+#define HD_SOFT_START_40 3
+#define HD_SOFT_START_60 6
+#define HD_SOFT_START_80 8
+#define HD_SOFT_START_100 100
+
+/* RANGE_LEFT_APV, RANGE_RIGHT_APV, and RANGE_CENTER_APV define the servo's
+physical range of motion and its neutral point. See HitecDSettings.h for an
+explanation of "APV". */
+#define HD_REG_RANGE_LEFT_APV 0xB2
+#define HD_REG_RANGE_RIGHT_APV 0xB0
+#define HD_REG_RANGE_CENTER_APV 0xC2
+
+/* FAIL_SAFE defines the servo's fail-safe behavior. Its value is the fail-safe
+PWM pulse width in microseconds, or one of the special constants FAIL_SAFE_LIMP
+or FAIL_SAFE_OFF. */
+#define HD_REG_FAIL_SAFE 0x4C
+#define HD_FAIL_SAFE_LIMP 0
+#define HD_FAIL_SAFE_OFF 1
+
+/* POWER_LIMIT defines the maximum motor power that the servo can use. It ranges
+from 0 (no power) to 2000 (max power). The DPC-11 represents max power as
+POWER_LIMIT=0x0FFF; this is treated the same as POWER_LIMIT=2000. The live
+motor power in HD_REG_MOTOR_POWER uses the same scale. */
+#define HD_REG_POWER_LIMIT 0x56
+#define HD_POWER_LIMIT_MAX 2000
+
+/* OVERLOAD_PROTECTION defines what percentage of max power the servo will use
+if it detects an overload condition. It ranges from 0 to 100. */
+#define HD_REG_OVERLOAD_PROTECTION 0x9C
+
+/* SMART_SENSE_1 and SMART_SENSE_2 control whether Smart Sense is enabled:
+- To enable, set SMART_SENSE_1=SS_ENABLE_1 and SMART_SENSE_2=SS_ENABLE_2.
+- To disable, set SMART_SENSE_1=SS_DISABLE_1 and SMART_SENSE_2=SS_DISABLE_2. */
+#define HD_REG_SMART_SENSE_1 0x44
+#define HD_REG_SMART_SENSE_2 0x6C
+
+/* The SS_{ENABLE,DISABLE}_{1,2} registers appear to be read-only. They
+always return the same values. */
+#define HD_REG_SS_ENABLE_1 0xD6
+#define HD_SS_ENABLE_1_CONST 14000
+#define HD_REG_SS_ENABLE_2 0xD4
+#define HD_SS_ENABLE_2_CONST 2000
+#define HD_REG_SS_DISABLE_1 0x8C
+#define HD_SS_DISABLE_1_CONST 28000
+#define HD_REG_SS_DISABLE_2 0x8A
+#define HD_SS_DISABLE_2_CONST 4000
+
+/* SENSITIVITY_RATIO sets the sensitivity ratio. */
+#define HD_REG_SENSITIVITY_RATIO 0x64
+#define HD_SENSITIVITY_RATIO_MIN 0x0333
+#define HD_SENSITIVITY_RATIO_MAX 0x0FFF /* default */
+
+/* Writing FACTORY_RESET=FACTORY_RESET_CONST resets the servo to its factory
+settings. */
+#define HD_REG_FACTORY_RESET 0x6E
+#define HD_FACTORY_RESET_CONST 0x0F0F
+
+/* The DPC-11 always writes MYSTERY_OP1=MYSTERY_OP1_CONST and
+MYSTERY_OP2=MYSTERY_OP2_CONST whenever it changes the OVERLOAD_PROTECTION
+setting or resets the servo. I don't know why; perhaps they configure
+other parameters of the overload-protection system? (I've named them "_OP1" and
+"_OP2" because they seem related to overload-protection somehow.) */
+#define HD_REG_MYSTERY_OP1 0x98
+#define HD_MYSTERY_OP1_CONST 200
+#define HD_REG_MYSTERY_OP2 0x9A
+#define HD_MYSTERY_OP2_CONST 3
+
+/* The DPC-11 always writes MYSTERY_DB=MYSTERY_DB_CONST whenever it changes
+the deadband or smart-sense settings. I have no idea what this does. Reading
+back MYSTERY_DB always returns 0. (I've named it "_DB" because it seems related
+to the deadband somehow.) */
+#define HD_REG_MYSTERY_DB 0x72
+#define HD_MYSTERY_DB_CONST 0x4E54
+
+#endif /* HitecDSettingsRegisters_h */
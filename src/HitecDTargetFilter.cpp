@@ -0,0 +1,85 @@
+#include "HitecDTargetFilter.h"
+
+#include "HitecDServoInternal.h"
+
+HitecDTargetFilter::HitecDTargetFilter() :
+  deadbandQuarterMicros(1),
+  sent(0),
+  suppressed(0),
+  servo(NULL),
+  settleMillis(50),
+  haveSent(false),
+  sentQuarterMicros(0),
+  pending(false),
+  pendingQuarterMicros(0),
+  pendingMillis(0)
+{ }
+
+int HitecDTargetFilter::begin(HitecDServo *_servo, uint16_t _settleMillis) {
+  servo = _servo;
+  settleMillis = _settleMillis;
+  haveSent = false;
+  pending = false;
+
+  int res;
+  uint16_t deadbandAPV;
+  if ((res = servo->readRawRegister(HD_REG_DEADBAND_1, &deadbandAPV))
+      != HITECD_OK) {
+    /* Fall back to only dropping repeated targets. */
+    deadbandQuarterMicros = 1;
+    return res;
+  }
+
+  int16_t centerAPV = servo->quarterMicrosToAPV(4*1500);
+  int16_t left = 4*1500 -
+    servo->apvToQuarterMicros(centerAPV - (int16_t)deadbandAPV);
+  int16_t right =
+    servo->apvToQuarterMicros(centerAPV + (int16_t)deadbandAPV) - 4*1500;
+  deadbandQuarterMicros = max(min(left, right), 1);
+  return HITECD_OK;
+}
+
+void HitecDTargetFilter::writeTargetMicroseconds(int16_t microseconds) {
+  writeTargetQuarterMicros(microseconds * 4);
+}
+
+void HitecDTargetFilter::writeTargetQuarterMicros(int16_t quarterMicros) {
+  /* Same clamping as HitecDServo, so we compare what would really be sent. */
+  quarterMicros = constrain(quarterMicros, 4*850, 4*2150);
+
+  if (haveSent &&
+      abs(quarterMicros - sentQuarterMicros) < deadbandQuarterMicros) {
+    ++suppressed;
+    if (quarterMicros == sentQuarterMicros) {
+      /* The servo already has exactly this target. */
+      pending = false;
+    } else if (!pending || quarterMicros != pendingQuarterMicros) {
+      pending = true;
+      pendingQuarterMicros = quarterMicros;
+      pendingMillis = millis();
+    }
+    return;
+  }
+
+  send(quarterMicros);
+}
+
+void HitecDTargetFilter::poll() {
+  if (pending && millis() - pendingMillis >= settleMillis) {
+    send(pendingQuarterMicros);
+  }
+}
+
+void HitecDTargetFilter::flush() {
+  if (pending) {
+    send(pendingQuarterMicros);
+  }
+}
+
+void HitecDTargetFilter::send(int16_t quarterMicros) {
+  servo->writeTargetQuarterMicros(quarterMicros);
+  ++sent;
+  haveSent = true;
+  sentQuarterMicros = quarterMicros;
+  pending = false;
+}
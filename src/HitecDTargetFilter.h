@@ -0,0 +1,81 @@
+#ifndef HitecDTargetFilter_h
+#define HitecDTargetFilter_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDTargetFilter sits between a motion planner and a servo, and drops
+target writes that are too small for the servo to act on. Each write blocks the
+sketch for about HD_WRITE_MICROS, so a planner that sends every tiny wiggle
+wastes a lot of time. For example:
+
+    HitecDTargetFilter filter;
+
+    void setup() {
+      servo.attach(2);
+      filter.begin(&servo);
+    }
+
+    void loop() {
+      filter.writeTargetQuarterMicros(planner.nextQuarterMicros());
+      filter.poll();
+    }
+
+A write is dropped if it's within the servo's deadband of the last target that
+was actually sent. The comparison is always against the last target sent, not
+the last one requested, so a slow drift still gets through once it adds up.
+
+The deadband is read from the DEADBAND_1 register (the narrowest of the three;
+see HitecDServoInternal.h), which is in APV units, and converted to
+quarter-microseconds using the servo's range settings. Where the two halves of
+the range have different scales, the smaller result is used, so the filter
+errs on the side of sending. Repeated writes of the same target are always
+dropped.
+
+The most recent target is never lost: if it was dropped, poll() sends it once
+the planner has stopped changing it for `settleMillis`, and flush() sends it
+right away. */
+class HitecDTargetFilter {
+public:
+  HitecDTargetFilter();
+
+  /* Reads the servo's deadband. Call this again if the servo's deadband or
+  range settings change. Returns HITECD_OK, or an error code if the read
+  failed. */
+  int begin(HitecDServo *servo, uint16_t settleMillis = 50);
+
+  /* Like the HitecDServo methods, but the write may be postponed or dropped as
+  described above. */
+  void writeTargetMicroseconds(int16_t microseconds);
+  void writeTargetQuarterMicros(int16_t quarterMicros);
+
+  /* Sends the latest target if it was dropped and the planner has stopped
+  changing it. Call this as often as possible from loop(). */
+  void poll();
+
+  /* Sends the latest target now if it was dropped. */
+  void flush();
+
+  /* The deadband, in quarter-microseconds, as found by begin(). */
+  int16_t deadbandQuarterMicros;
+
+  /* Number of writes sent to the servo, and number dropped. */
+  uint32_t sent;
+  uint32_t suppressed;
+
+private:
+  void send(int16_t quarterMicros);
+
+  HitecDServo *servo;
+  uint16_t settleMillis;
+
+  bool haveSent;
+  int16_t sentQuarterMicros;
+
+  bool pending;
+  int16_t pendingQuarterMicros;
+  uint32_t pendingMillis;
+};
+
+#endif /* HitecDTargetFilter_h */
@@ -0,0 +1,235 @@
+#include "HitecDTeach.h"
+
+#include <avr/eeprom.h>
+
+#include "HitecDServoInternal.h"
+
+/* Marks a valid recording in EEPROM. */
+#define TEACH_MAGIC 0x7E
+
+/* Keyframe times are stored as 16-bit deltas, so force a keyframe before the
+delta could overflow. */
+#define TEACH_MAX_KEYFRAME_MILLIS 60000
+
+HitecDTeach::HitecDTeach(HitecDServo *_servos, uint8_t _numServos) :
+  servos(_servos),
+  numServos(min(_numServos, (uint8_t)HITECD_TEACH_MAX_SERVOS)),
+  recording(false),
+  toleranceAPV(30),
+  keyframeMillis(0),
+  prevFrameMillis(0),
+  playbackStartMillis(0),
+  lastPlaybackMillis(0),
+  playbackKeyframe(0),
+  playbackKeyframeMillis(0)
+{
+  state.magic = TEACH_MAGIC;
+  state.numServos = numServos;
+  state.numKeyframes = 0;
+}
+
+int HitecDTeach::beginRecording(int16_t teachPowerLimit, int16_t _toleranceAPV) {
+  int res;
+  toleranceAPV = _toleranceAPV;
+  state.numKeyframes = 0;
+
+  for (int i = 0; i < numServos; ++i) {
+    if ((res = servos[i].readRawRegister(
+        HD_REG_POWER_LIMIT, &savedPowerLimits[i])) != HITECD_OK) {
+      return res;
+    }
+  }
+
+  int16_t apvs[HITECD_TEACH_MAX_SERVOS];
+  uint32_t frameMillis = millis();
+  for (int i = 0; i < numServos; ++i) {
+    if ((apvs[i] = servos[i].readCurrentAPV()) < 0) {
+      return apvs[i];
+    }
+  }
+
+  for (int i = 0; i < numServos; ++i) {
+    servos[i].writeLivePowerLimit(teachPowerLimit);
+  }
+  recording = true;
+
+  addKeyframe(frameMillis, apvs);
+  prevFrameMillis = frameMillis;
+  memcpy(prevFrameAPVs, apvs, sizeof(prevFrameAPVs));
+  restartDoor();
+  return HITECD_OK;
+}
+
+bool HitecDTeach::pollRecording() {
+  if (!recording || state.numKeyframes >= HITECD_TEACH_MAX_KEYFRAMES - 1) {
+    return false;
+  }
+
+  int16_t apvs[HITECD_TEACH_MAX_SERVOS];
+  uint32_t frameMillis = millis();
+  for (int i = 0; i < numServos; ++i) {
+    if ((apvs[i] = servos[i].readCurrentAPV()) < 0) {
+      return false;
+    }
+  }
+
+  /* Narrow each servo's door to the lines from the last keyframe that pass
+  within the tolerance of this frame. If any door closes, no single line fits
+  every frame since the keyframe, so the previous frame becomes a keyframe. */
+  const int16_t *keyframeAPVs = state.apv[state.numKeyframes - 1];
+  /* Each frame takes at least one read, so this is never zero. */
+  int32_t dt = frameMillis - keyframeMillis;
+  bool closed = (dt > TEACH_MAX_KEYFRAME_MILLIS);
+  for (int i = 0; i < numServos && !closed; ++i) {
+    int32_t dv = apvs[i] - keyframeAPVs[i];
+    int32_t upper = (dv + toleranceAPV) * 256 / dt;
+    int32_t lower = (dv - toleranceAPV) * 256 / dt;
+    if (max(lowerSlopes[i], lower) > min(upperSlopes[i], upper)) {
+      closed = true;
+    }
+  }
+  if (closed) {
+    addKeyframe(prevFrameMillis, prevFrameAPVs);
+    restartDoor();
+    keyframeAPVs = state.apv[state.numKeyframes - 1];
+    dt = frameMillis - keyframeMillis;
+  }
+  for (int i = 0; i < numServos; ++i) {
+    int32_t dv = apvs[i] - keyframeAPVs[i];
+    upperSlopes[i] = min(upperSlopes[i], (dv + toleranceAPV) * 256 / dt);
+    lowerSlopes[i] = max(lowerSlopes[i], (dv - toleranceAPV) * 256 / dt);
+  }
+
+  prevFrameMillis = frameMillis;
+  memcpy(prevFrameAPVs, apvs, sizeof(prevFrameAPVs));
+  return state.numKeyframes < HITECD_TEACH_MAX_KEYFRAMES - 1;
+}
+
+int HitecDTeach::endRecording() {
+  if (!recording) {
+    return HITECD_OK;
+  }
+  recording = false;
+
+  int res = HITECD_OK;
+  int16_t apvs[HITECD_TEACH_MAX_SERVOS];
+  uint32_t frameMillis = millis();
+  for (int i = 0; i < numServos; ++i) {
+    if ((apvs[i] = servos[i].readCurrentAPV()) < 0) {
+      res = apvs[i];
+      break;
+    }
+  }
+
+  if (res == HITECD_OK) {
+    /* pollRecording() always leaves room for this one. */
+    addKeyframe(frameMillis, apvs);
+    /* Hold each servo where it was left, so it doesn't spring back to its old
+    target when it gets its power back. */
+    for (int i = 0; i < numServos; ++i) {
+      servos[i].writeTargetQuarterMicros(
+        servos[i].apvToQuarterMicros(apvs[i]));
+    }
+  }
+  for (int i = 0; i < numServos; ++i) {
+    servos[i].writeRawRegister(HD_REG_POWER_LIMIT, savedPowerLimits[i]);
+  }
+  return res;
+}
+
+void HitecDTeach::beginPlayback(uint16_t leadInMillis) {
+  if (state.numKeyframes == 0) {
+    return;
+  }
+  for (int i = 0; i < numServos; ++i) {
+    servos[i].writeTargetQuarterMicros(
+      servos[i].apvToQuarterMicros(state.apv[0][i]));
+  }
+  lastPlaybackMillis = millis();
+  playbackStartMillis = lastPlaybackMillis + leadInMillis;
+  playbackKeyframe = 0;
+  playbackKeyframeMillis = 0;
+}
+
+bool HitecDTeach::pollPlayback() {
+  if (state.numKeyframes == 0) {
+    return false;
+  }
+  uint32_t now = millis();
+  if ((int32_t)(now - playbackStartMillis) < 0 ||
+      now - lastPlaybackMillis < HITECD_TEACH_PLAYBACK_MILLIS) {
+    return true;
+  }
+  lastPlaybackMillis = now;
+
+  uint32_t t = now - playbackStartMillis;
+  while (playbackKeyframe + 1 < state.numKeyframes &&
+      t >= playbackKeyframeMillis + state.dtMillis[playbackKeyframe + 1]) {
+    ++playbackKeyframe;
+    playbackKeyframeMillis += state.dtMillis[playbackKeyframe];
+  }
+
+  const int16_t *from = state.apv[playbackKeyframe];
+  if (playbackKeyframe + 1 == state.numKeyframes) {
+    for (int i = 0; i < numServos; ++i) {
+      servos[i].writeTargetQuarterMicros(
+        servos[i].apvToQuarterMicros(from[i]));
+    }
+    return false;
+  }
+
+  const int16_t *to = state.apv[playbackKeyframe + 1];
+  int32_t dt = state.dtMillis[playbackKeyframe + 1];
+  int32_t elapsed = t - playbackKeyframeMillis;
+  for (int i = 0; i < numServos; ++i) {
+    int16_t apv = from[i] + (int32_t)(to[i] - from[i]) * elapsed / dt;
+    servos[i].writeTargetQuarterMicros(servos[i].apvToQuarterMicros(apv));
+  }
+  return true;
+}
+
+void HitecDTeach::getKeyframe(
+  uint8_t index,
+  uint32_t *millisOut,
+  int16_t *apvsOut
+) {
+  *millisOut = 0;
+  for (uint8_t k = 1; k <= index; ++k) {
+    *millisOut += state.dtMillis[k];
+  }
+  for (int i = 0; i < numServos; ++i) {
+    apvsOut[i] = state.apv[index][i];
+  }
+}
+
+void HitecDTeach::saveToEEPROM(int eepromAddress) {
+  eeprom_update_block(&state, (void *)eepromAddress, sizeof(state));
+}
+
+bool HitecDTeach::loadFromEEPROM(int eepromAddress) {
+  State loaded;
+  eeprom_read_block(&loaded, (const void *)eepromAddress, sizeof(loaded));
+  if (loaded.magic != TEACH_MAGIC ||
+      loaded.numServos != numServos ||
+      loaded.numKeyframes > HITECD_TEACH_MAX_KEYFRAMES) {
+    return false;
+  }
+  state = loaded;
+  return true;
+}
+
+void HitecDTeach::addKeyframe(uint32_t frameMillis, const int16_t *apvs) {
+  uint8_t k = state.numKeyframes++;
+  state.dtMillis[k] = (k == 0) ? 0 : frameMillis - keyframeMillis;
+  for (int i = 0; i < numServos; ++i) {
+    state.apv[k][i] = apvs[i];
+  }
+  keyframeMillis = frameMillis;
+}
+
+void HitecDTeach::restartDoor() {
+  for (int i = 0; i < numServos; ++i) {
+    upperSlopes[i] = 0x7FFFFFFF;
+    lowerSlopes[i] = -0x7FFFFFFF;
+  }
+}
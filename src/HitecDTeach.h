@@ -0,0 +1,124 @@
+#ifndef HitecDTeach_h
+#define HitecDTeach_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDTeach records a motion by moving a group of servos by hand, and then
+plays it back. For example:
+
+    HitecDServo servos[2];
+    HitecDTeach teach(servos, 2);
+
+    teach.beginRecording();
+    while (!buttonPressed() && teach.pollRecording()) { }
+    teach.endRecording();
+    ...
+    teach.beginPlayback();
+    while (teach.pollPlayback()) { }
+
+While recording, the servos' power limits are set to `teachPowerLimit` with
+writeLivePowerLimit(), so they can be moved by hand (see the notes on
+HitecDSettings::powerLimit). Nothing is saved to the servos, and no reboot is
+needed: endRecording() points each servo's target at where it was left, then
+puts the original power limits back.
+
+pollRecording() reads the position of every servo, back to back; this is the
+fastest rate that can be sustained, about one frame every N*18ms for N servos
+(HD_READ_MICROS per read).
+Rather than storing every frame, the recording is simplified on the fly into
+keyframes, using the "swinging door" method: a new keyframe is only stored when
+a straight line from the previous keyframe can no longer pass within
+`toleranceAPV` of every frame since, for every servo. Slow, smooth motions take
+very few keyframes.
+
+Playback interpolates linearly between keyframes, sending new targets every
+HITECD_TEACH_PLAYBACK_MILLIS. */
+
+/* Maximum number of servos in a group. */
+#define HITECD_TEACH_MAX_SERVOS 4
+
+/* Maximum number of keyframes in a recording. Each keyframe takes
+2+2*HITECD_TEACH_MAX_SERVOS bytes of SRAM. */
+#define HITECD_TEACH_MAX_KEYFRAMES 32
+
+#define HITECD_TEACH_PLAYBACK_MILLIS 20
+
+class HitecDTeach {
+public:
+  /* `servos` is an array of `numServos` attached servos. */
+  HitecDTeach(HitecDServo *servos, uint8_t numServos);
+
+  /* Discards any previous recording, lowers the servos' power limits, and
+  records the first keyframe. Returns HITECD_OK or an error code. */
+  int beginRecording(int16_t teachPowerLimit = 0, int16_t toleranceAPV = 30);
+
+  /* Reads one frame. Call this repeatedly until the motion is finished. Returns
+  false once there's no room for more keyframes, or if a read failed. */
+  bool pollRecording();
+
+  /* Stores the final keyframe, and gives the servos their power back without
+  moving them. Returns HITECD_OK or an error code. */
+  int endRecording();
+
+  /* Starts playing back the recording. First each servo is sent to its
+  starting position, and given `leadInMillis` to get there. */
+  void beginPlayback(uint16_t leadInMillis = 1000);
+
+  /* Sends the servos their next targets, if it's time. Call this as often as
+  possible. Returns false once playback has finished. */
+  bool pollPlayback();
+
+  uint8_t numKeyframes() { return state.numKeyframes; }
+
+  /* Retrieves a keyframe: its time since the start of the recording, and the
+  position of each servo. `apvsOut` must have room for `numServos` entries. */
+  void getKeyframe(uint8_t index, uint32_t *millisOut, int16_t *apvsOut);
+
+  /* Saves the recording to the Arduino's EEPROM, or loads it back. This takes
+  HitecDTeach::eepromSize bytes. loadFromEEPROM() returns false if there's no
+  valid recording for this number of servos at that address. */
+  void saveToEEPROM(int eepromAddress);
+  bool loadFromEEPROM(int eepromAddress);
+
+private:
+  /* Everything in here gets saved to EEPROM. */
+  struct State {
+    uint8_t magic;
+    uint8_t numServos;
+    uint8_t numKeyframes;
+    /* Time since the previous keyframe. (0 for the first keyframe.) */
+    uint16_t dtMillis[HITECD_TEACH_MAX_KEYFRAMES];
+    int16_t apv[HITECD_TEACH_MAX_KEYFRAMES][HITECD_TEACH_MAX_SERVOS];
+  } state;
+
+public:
+  static const int eepromSize = sizeof(State);
+
+private:
+  void addKeyframe(uint32_t frameMillis, const int16_t *apvs);
+  void restartDoor();
+
+  HitecDServo *servos;
+  uint8_t numServos;
+
+  /* Recording state */
+  bool recording;
+  int16_t toleranceAPV;
+  uint16_t savedPowerLimits[HITECD_TEACH_MAX_SERVOS];
+  uint32_t keyframeMillis;
+  uint32_t prevFrameMillis;
+  int16_t prevFrameAPVs[HITECD_TEACH_MAX_SERVOS];
+  /* Slopes of the two sides of each servo's "door", in 1/256 APV per ms. */
+  int32_t upperSlopes[HITECD_TEACH_MAX_SERVOS];
+  int32_t lowerSlopes[HITECD_TEACH_MAX_SERVOS];
+
+  /* Playback state */
+  uint32_t playbackStartMillis;
+  uint32_t lastPlaybackMillis;
+  uint8_t playbackKeyframe;
+  uint32_t playbackKeyframeMillis;
+};
+
+#endif /* HitecDTeach_h */
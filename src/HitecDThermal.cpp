@@ -0,0 +1,150 @@
+#include "HitecDThermal.h"
+
+#include "HitecDServoInternal.h"
+
+/* Heat from one millisecond at max power */
+#define FULL_POWER_HEAT (128UL * 128UL)
+
+/* Never let a calibration drop the threshold below this. */
+#define MIN_THRESHOLD (FULL_POWER_HEAT * 100)
+
+HitecDThermal::HitecDThermal() :
+  cutback(false),
+  energyFullPowerMillis(0),
+  servo(NULL),
+  coolingMillis(30000),
+  heat(0),
+  threshold(FULL_POWER_HEAT * 3000),
+  power128(0),
+  havePower(false),
+  lastMillis(0),
+  energyRemainder(0),
+  powerLimit(-1)
+{ }
+
+void HitecDThermal::begin(
+  HitecDServo *_servo,
+  uint16_t cutbackMillis,
+  uint16_t _coolingMillis
+) {
+  end();
+  servo = _servo;
+  coolingMillis = max(_coolingMillis, (uint16_t)1);
+  threshold = max(FULL_POWER_HEAT * cutbackMillis, MIN_THRESHOLD);
+  heat = 0;
+  havePower = false;
+  cutback = false;
+  energyFullPowerMillis = 0;
+  energyRemainder = 0;
+  powerLimit = -1;
+  servo->addListener(this);
+}
+
+void HitecDThermal::end() {
+  if (servo != NULL) {
+    servo->removeListener(this);
+    servo = NULL;
+  }
+}
+
+uint32_t HitecDThermal::millisToCutback() {
+  if (cutback || heat >= threshold) {
+    return 0;
+  }
+  uint32_t rate = heatingRate();
+  if (!havePower || rate == 0) {
+    return HITECD_THERMAL_NEVER;
+  }
+  uint32_t remaining = (threshold - heat) / rate;
+  uint32_t elapsed = millis() - lastMillis;
+  return (remaining > elapsed) ? remaining - elapsed : 0;
+}
+
+uint8_t HitecDThermal::heatPercent() {
+  return min(heat / (threshold / 100), (uint32_t)255);
+}
+
+void HitecDThermal::onReadRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  int res,
+  uint16_t val
+) {
+  if (res != HITECD_OK) {
+    return;
+  }
+
+  switch (reg) {
+  case HD_REG_MOTOR_POWER: {
+    advance(millis());
+    int32_t power = min(abs((int16_t)val), HD_POWER_LIMIT_MAX);
+    power128 = (power * 128 + HD_POWER_LIMIT_MAX / 2) / HD_POWER_LIMIT_MAX;
+    havePower = true;
+    break;
+  }
+
+  case HD_REG_EFFECTIVE_POWER_LIMIT: {
+    if (powerLimit < 0 || (int16_t)val > powerLimit) {
+      powerLimit = min(val, (uint16_t)HD_POWER_LIMIT_MAX);
+    }
+    /* Allow a little slack, as HitecDOdometer does. */
+    bool nowCutback = (int16_t)val < powerLimit - powerLimit / 32;
+    if (nowCutback && !cutback) {
+      /* Overload protection just kicked in, so this is roughly how much heat
+      it takes. */
+      advance(millis());
+      threshold = max(threshold / 2 + heat / 2, MIN_THRESHOLD);
+    }
+    cutback = nowCutback;
+    break;
+  }
+
+  case HD_REG_POWER_LIMIT:
+    powerLimit = min(val, (uint16_t)HD_POWER_LIMIT_MAX);
+    break;
+  }
+}
+
+void HitecDThermal::onWriteRegister(
+  HitecDServo * /* servo */,
+  uint8_t reg,
+  uint16_t val
+) {
+  if (reg == HD_REG_POWER_LIMIT) {
+    powerLimit = min(val, (uint16_t)HD_POWER_LIMIT_MAX);
+  }
+}
+
+void HitecDThermal::advance(uint32_t now) {
+  uint32_t dt = now - lastMillis;
+  lastMillis = now;
+  if (!havePower) {
+    return;
+  }
+
+  uint32_t heatDt = min(dt, (uint32_t)HITECD_THERMAL_MAX_GAP_MILLIS);
+  heat += (uint32_t)power128 * power128 * heatDt;
+  uint32_t energy128 = energyRemainder + (uint32_t)power128 * heatDt;
+  energyFullPowerMillis += energy128 >> 7;
+  energyRemainder = energy128 & 0x7F;
+
+  /* Cool down. For each whole time constant, multiply by e^-1 (~94/256); then
+  a linear step for the rest. */
+  while (dt >= coolingMillis && heat != 0) {
+    heat = (heat >> 8) * 94;
+    dt -= coolingMillis;
+  }
+  if (dt < coolingMillis) {
+    heat -= (heat >> 8) * ((dt << 8) / coolingMillis);
+  }
+
+  /* Keep well clear of overflow. Anything past the threshold means the same
+  thing anyway. */
+  heat = min(heat, 2 * threshold);
+}
+
+uint32_t HitecDThermal::heatingRate() {
+  uint32_t in = (uint32_t)power128 * power128;
+  uint32_t out = heat / coolingMillis;
+  return (in > out) ? in - out : 0;
+}
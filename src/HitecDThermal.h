@@ -0,0 +1,104 @@
+#ifndef HitecDThermal_h
+#define HitecDThermal_h
+
+#include <Arduino.h>
+
+#include "HitecDServo.h"
+
+/* HitecDThermal estimates how close a servo is to its overload protection
+kicking in, so the sketch can ease off before the servo cuts its own power. For
+example:
+
+    HitecDThermal thermal;
+    thermal.begin(&servo);
+    ...
+    servo.readMotorPower(&power);
+    if (thermal.millisToCutback() < 1000) {
+      ... ask less of this servo ...
+    }
+
+Like HitecDOdometer, it only listens in on reads that the sketch is already
+doing, and adds no bus traffic. Every readMotorPower() (register 0x10) feeds an
+"I-squared-t" model: heat builds up with the square of the motor power, and
+leaks away with time constant `coolingMillis`. The power is taken as a fraction
+of max power (2000), and heat is measured in milliseconds at max power. The
+servo is predicted to cut back once the heat reaches `cutbackMillis`, which by
+default is the "about 3 seconds" of stall noted under
+HitecDSettings::overloadProtection. Holding more than
+sqrt(cutbackMillis/coolingMillis) of max power (about 32% by default) will
+eventually reach it.
+
+The servo's real rule isn't known, so the model corrects itself: whenever a read
+of HD_REG_EFFECTIVE_POWER_LIMIT shows that overload protection has just kicked
+in, the cutback threshold is moved halfway towards the heat at that moment.
+Reading that register now and then (e.g. once a second) keeps the prediction
+honest.
+
+The power is assumed to stay at each sample's value until the next sample. Gaps
+longer than HITECD_THERMAL_MAX_GAP_MILLIS only add heat for that long, since the
+sketch can't know what happened in between. */
+
+/* millisToCutback() returns this if the servo isn't heading for a cutback. */
+#define HITECD_THERMAL_NEVER 0xFFFFFFFFUL
+
+#define HITECD_THERMAL_MAX_GAP_MILLIS 1000
+
+class HitecDThermal : public HitecDListener {
+public:
+  HitecDThermal();
+
+  /* Starts listening to the given servo. */
+  void begin(
+    HitecDServo *servo,
+    uint16_t cutbackMillis = 3000,
+    uint16_t coolingMillis = 30000);
+  void end();
+
+  /* Predicted time until the servo cuts back its power, if the motor power
+  stays as it was last sampled; or HITECD_THERMAL_NEVER. This uses the current
+  heating rate, which only slows as the servo heats up, so the real time is
+  never shorter. Returns 0 if the cutback is due now or has happened. */
+  uint32_t millisToCutback();
+
+  /* Estimated heat, as a percentage of the cutback threshold. */
+  uint8_t heatPercent();
+
+  /* True if the last read of HD_REG_EFFECTIVE_POWER_LIMIT showed overload
+  protection in effect. */
+  bool cutback;
+
+  /* Total motor energy since begin(), expressed as milliseconds at max power.
+  */
+  uint32_t energyFullPowerMillis;
+
+  virtual void onReadRegister(
+    HitecDServo *servo, uint8_t reg, int res, uint16_t val);
+  virtual void onWriteRegister(
+    HitecDServo *servo, uint8_t reg, uint16_t val);
+
+private:
+  void advance(uint32_t now);
+  uint32_t heatingRate();
+
+  HitecDServo *servo;
+  uint16_t coolingMillis;
+
+  /* Heat is in units of (fraction of max power, in 1/128ths)^2 * ms, so that
+  the threshold for 65s at max power still fits. */
+  uint32_t heat;
+  uint32_t threshold;
+
+  /* Last motor power, in 1/128ths of max power */
+  uint8_t power128;
+  bool havePower;
+  uint32_t lastMillis;
+  /* Fraction of a millisecond at max power, in 1/128ths, carried between
+  samples */
+  uint8_t energyRemainder;
+
+  /* Configured power limit, for telling when overload protection is active; or
+  -1 if not known yet */
+  int16_t powerLimit;
+};
+
+#endif /* HitecDThermal_h */